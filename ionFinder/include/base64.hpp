@@ -0,0 +1,54 @@
+//
+// base64.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef base64_hpp
+#define base64_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ Base64 decoder for the binary data arrays in mzML and mzXML files.
+ On x86 processors, blocks of text are decoded with AVX2 or SSE4.1 instructions if the processor
+ supports them, which is checked when ionFinder is run. Otherwise, and for blocks which contain
+ white space or padding, each character is decoded separately.
+ */
+namespace base64{
+
+	//!Bytes after the end of the decoded data which decode can overwrite.
+	size_t const DECODE_PADDING = 32;
+
+	//! Maximum number of bytes which decoding \p len characters can produce.
+	inline size_t decodedSize(size_t len){
+		return (len + 3) / 4 * 3;
+	}
+
+	size_t decode(const char* begin, const char* end, char* out);
+	size_t decodeScalar(const char* begin, const char* end, char* out);
+}
+
+#endif /* base64_hpp */
@@ -0,0 +1,135 @@
+//
+// dataFile.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef dataFile_hpp
+#define dataFile_hpp
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+
+#include <config.h>
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <mappedFile.hpp>
+
+namespace ms2 {
+    class DataFile;
+
+    //! Maximum number of decompressed BGZF blocks to keep.
+    size_t const BGZF_BLOCK_CACHE_SIZE = 16;
+
+    /**
+     * Read only data file which can be plain text, gzip or BGZF compressed. <br><br>
+     * Plain files are memory mapped. gzip files are decompressed into memory as they are
+     * read, without writing them to disk. For BGZF files, which are a series of independently
+     * compressed gzip blocks, the compressed file is mapped and an index of the uncompressed offset
+     * of each block is built from the block headers, so a range of the file can be read by only
+     * decompressing the blocks which hold it.
+     */
+    class DataFile {
+    public:
+        enum class Compression {NONE, GZIP, BGZF};
+
+    private:
+        struct Block {
+            //! Offset of block in compressed file.
+            size_t offset;
+            //! Size of compressed block, including header and trailer.
+            size_t size;
+            //! Offset of the first byte of the block in the uncompressed data.
+            size_t dataOffset;
+        };
+        typedef std::shared_ptr<const std::string> BlockPtr;
+
+        Compression _compression;
+        MappedFile _file;
+        //! Uncompressed data of gzip files.
+        std::string _buffer;
+        //! BGZF blocks in file order.
+        std::vector<Block> _blocks;
+        //! Size of uncompressed data.
+        size_t _size;
+
+        //! Recently decompressed BGZF blocks.
+        mutable std::mutex _cacheMutex;
+        mutable std::map<size_t, BlockPtr> _cache;
+        mutable std::deque<size_t> _cacheOrder;
+
+        bool buildBlockIndex();
+        bool decompressGzip();
+        BlockPtr getBlock(size_t blockIndex) const;
+        void decompressBlock(size_t blockIndex, char* out) const;
+
+    public:
+        DataFile() {
+            _compression = Compression::NONE;
+            _size = 0;
+        }
+        DataFile(const DataFile&) = delete;
+        DataFile& operator = (const DataFile&) = delete;
+
+        bool open(const std::string& fname);
+        void close();
+
+        const char* read(size_t offset, size_t len, std::string& buffer) const;
+        void readAll(std::string& buffer) const;
+
+        //! Is the whole file in memory, so begin and end can be used?
+        bool isContiguous() const {
+            return _compression != Compression::BGZF;
+        }
+        const char* begin() const {
+            return _compression == Compression::GZIP ? _buffer.data() : _file.begin();
+        }
+        const char* end() const {
+            return begin() + _size;
+        }
+        //! Size of uncompressed data.
+        size_t size() const {
+            return _size;
+        }
+        Compression getCompression() const {
+            return _compression;
+        }
+        size_t getMemoryUsage() const;
+        void advise(MappedFile::Advice advice) const {
+            _file.advise(advice);
+        }
+    };
+}
+
+#endif //dataFile_hpp
@@ -30,6 +30,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <functional>
 
 #include <paramsBase.hpp>
 #include <scanData.hpp>
@@ -39,15 +40,19 @@ namespace Dtafilter{
 	class Scan;
 	
 	std::string const REVERSE_MATCH = "reverse_";
+
+	//!Called for each scan which passes the reverse and modification filters. Returns false if the scan should be skipped.
+	typedef std::function<bool(Dtafilter::Scan&)> ScanFilterFunction;
 	
 	bool readFilterFile(const std::string& fname, const std::string& sampleName,
 						std::vector<Dtafilter::Scan>& scans,
-						bool skipReverse = false, int modFilter = 1);
+						bool skipReverse = false, int modFilter = 1,
+						const ScanFilterFunction& filter = ScanFilterFunction());
 	
 	class Scan : public scanData::Scan{
 		friend bool readFilterFile(const std::string&, const std::string&,
 								   std::vector<Dtafilter::Scan>&,
-								   bool, int);
+								   bool, int, const ScanFilterFunction&);
 	public:
 		enum class MatchDirection{FORWARD, REVERSE};
 		static MatchDirection strToMatchDirection(std::string);
@@ -60,6 +65,8 @@ namespace Dtafilter{
 		MatchDirection _matchDirection;
 		std::string _sampleName;
 		bool _unique;
+		//! Position of scan in the full input list, before any scans are removed by sharding.
+		size_t _inputIndex;
 		
 		bool parse_matchDir_ID_Protein(const std::string&);
 		
@@ -71,6 +78,7 @@ namespace Dtafilter{
 			_parentDescription = "";
 			_unique = false;
 			_matchDirection = MatchDirection::REVERSE;
+			_inputIndex = 0;
 		}
 		
 		//modifiers
@@ -96,6 +104,9 @@ namespace Dtafilter{
 		void setUnique(bool boo){
 			_unique = boo;
 		}
+		void setInputIndex(size_t i){
+			_inputIndex = i;
+		}
 		
 		//properties
         std::string getFormula() const{
@@ -119,6 +130,9 @@ namespace Dtafilter{
 		bool getUnique() const{
 			return _unique;
 		}
+		size_t getInputIndex() const{
+			return _inputIndex;
+		}
 	};
 }
 
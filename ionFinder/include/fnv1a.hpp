@@ -0,0 +1,62 @@
+//
+// fnv1a.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef fnv1a_hpp
+#define fnv1a_hpp
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ 64 bit FNV-1a hash, used for index file names, checkpoint keys and payloads
+ and --shard assignment. Values are written to disk, so the hash must not change.
+ */
+namespace fnv1a{
+
+	uint64_t const OFFSET = 14695981039346656037ULL;
+	uint64_t const PRIME = 1099511628211ULL;
+
+	/**
+	 Hash \p len bytes of \p data.
+	 \param hash Hash to continue from, so several buffers can be hashed as one.
+	 */
+	inline uint64_t hash(const char* data, size_t len, uint64_t hash = OFFSET)
+	{
+		for(size_t i = 0; i < len; i++){
+			hash ^= uint64_t((unsigned char)data[i]);
+			hash *= PRIME;
+		}
+		return hash;
+	}
+
+	inline uint64_t hash(const std::string& str, uint64_t hash = OFFSET){
+		return fnv1a::hash(str.data(), str.size(), hash);
+	}
+}
+
+#endif /* fnv1a_hpp */
@@ -0,0 +1,132 @@
+//
+// checkpoint.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef checkpoint_hpp
+#define checkpoint_hpp
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <ionFinder/params.hpp>
+#include <ionFinder/datProc.hpp>
+#include <dtafilter.hpp>
+#include <peptide.hpp>
+#include <utils.hpp>
+#include <fnv1a.hpp>
+
+namespace IonFinder{
+
+	//!First bytes of checkpoint file. Last byte is format version.
+	char const CHECKPOINT_MAGIC[8] = {'I', 'F', 'C', 'K', 'P', 'T', '\0', '\1'};
+	//!First bytes of each block of records in checkpoint file.
+	uint32_t const CHECKPOINT_BLOCK_MAGIC = 0x4b4c4231;
+
+	/**
+	 Periodically writes the search results for completed scans to a binary file, and
+	 reads them back with --resume so finished scans are not searched again. <br><br>
+	 The file has a header with a key for the input and options, followed by blocks of records
+	 written every Params::_checkpointInterval seconds. Each block ends with a hash of its contents,
+	 so a block which was only partly written when the process was stopped is discarded.
+	 Values are written in native byte order. <br>
+	 Only the precursor information and the labeled fragments are stored for each scan.
+	 The rest of the Peptide is recalculated with IonFinder::initPeptide when it is restored.
+	 */
+	class Checkpoint{
+	public:
+		//!Labeled fragment ion
+		struct Fragment{
+			uint32_t index;
+			bool found;
+			double mz;
+			double intensity;
+		};
+		//!Search results for a single scan
+		struct Record{
+			std::string precursorMZ;
+			std::string precursorScan;
+			double rt;
+			int32_t charge;
+			double intensity;
+			uint32_t nFragments;
+			std::vector<Fragment> fragments;
+		};
+		typedef std::unique_ptr<Record> RecordPtr;
+		typedef std::chrono::steady_clock ClockType;
+
+	private:
+		std::string _fname;
+		int _interval;
+		std::ofstream _outF;
+
+		//! Records waiting to be written
+		std::string _buffer;
+		uint32_t _nBuffered;
+		ClockType::time_point _lastWrite;
+		std::mutex _mutex;
+
+		//! Records read from existing checkpoint for each scan index. nullptr if scan was not finished.
+		std::vector<RecordPtr> _records;
+		size_t _nRestored;
+
+		static uint64_t makeKey(const std::vector<Dtafilter::Scan>& scans, const IonFinder::Params& pars);
+		bool read(uint64_t key, size_t nScans);
+		bool writeBlock();
+
+	public:
+		Checkpoint(std::string fname, int interval){
+			_fname = std::move(fname);
+			_interval = interval;
+			_nBuffered = 0;
+			_nRestored = 0;
+		}
+		~Checkpoint() = default;
+
+		bool open(const std::vector<Dtafilter::Scan>& scans, const IonFinder::Params& pars, bool resume);
+		void add(size_t index, const Dtafilter::Scan& scan, const PeptideNamespace::Peptide& peptide);
+		void restore(size_t index, Dtafilter::Scan& scan, PeptideNamespace::Peptide& peptide,
+					 const IonFinder::Params& pars, const AminoAcidMassesMap& aminoAcidMassesMap);
+		bool flush();
+
+		//! Was the scan at \p index finished in the run being resumed?
+		bool isDone(size_t index) const{
+			return index < _records.size() && _records[index];
+		}
+		size_t getNRestored() const{
+			return _nRestored;
+		}
+	};
+}
+
+#endif /* checkpoint_hpp */
@@ -0,0 +1,54 @@
+//
+// convert.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef convert_hpp
+#define convert_hpp
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+
+#include <ionFinder/params.hpp>
+#include <msInterface.hpp>
+#include <peakStore.hpp>
+#include <scanIndex.hpp>
+#include <utils.hpp>
+
+namespace IonFinder{
+
+	//!First argument to run convert subcommand instead of search
+	std::string const CONVERT_SUBCOMMAND = "convert";
+	std::string const CONVERT_USAGE = "usage: ionFinder convert [--nThread <count>] [--force] <ms_file> [...]";
+
+	int convertMsFiles(int argc, const char* const argv[]);
+	bool convertMsFile(const std::string& fname, bool force);
+}
+
+#endif /* convert_hpp */
@@ -41,16 +41,21 @@
 #include <set>
 #include <cmath>
 #include <limits>
+#include <functional>
+#include <tuple>
 
 #include <constants.hpp>
 #include <ionFinder/ionFinder.hpp>
 #include <ionFinder/params.hpp>
+#include <ionFinder/metrics.hpp>
 #include <dtafilter.hpp>
 #include <fastaFile.hpp>
 #include <peptide.hpp>
 #include <scanData.hpp>
 #include <msInterface.hpp>
+#include <scanPrefetcher.hpp>
 #include <ms2Spectrum.hpp>
+#include <profile.hpp>
 
 namespace IonFinder{
 	
@@ -58,22 +63,99 @@ namespace IonFinder{
 	class RichFragmentIon;
 	class PeptideStats;
 	class PeptideFragmentsMap;
+	class Checkpoint;
 	
 	const std::string FRAG_DELIM = ";";
 	int const N_ION_TYPES = 5;
 	const std::string ION_TYPES_STR [] = {"frag", "det", "amb", "detNL", "artNL"};
 	const std::string CONTAINS_CIT_STR [] {"false", "ambiguous", "likely", "true"};
 	
-	//!Progress bar sleep time in seconds
-	int const PROGRESS_SLEEP_TIME = 1;
-	//!Max iterations of progress bar loop with no progress before quitting
-	int const MAX_PROGRESS_ITTERATIONS = 600;
 	//!Progress bar width in chars
 	int const PROGRESS_BAR_WIDTH = 60;
+	//!Smallest block of scans handed to a thread by ScanScheduler
+	size_t const MIN_SCAN_CHUNK_SIZE = 1;
+
+	/**
+	 Hands out blocks of scan indices to worker threads on demand. <br>
+	 Block sizes are guided: each block is a fraction of the scans remaining, so
+	 early blocks are large and blocks shrink as the queue drains. Threads which
+	 finish early come back for more work instead of idling while a few slow blocks finish.
+	 */
+	class ScanScheduler{
+	private:
+		std::atomic<size_t> _next;
+		std::atomic<bool> _stopped;
+		size_t _end;
+		size_t _nThread;
+		size_t _minChunk;
+	public:
+		ScanScheduler(size_t beg, size_t end, size_t nThread, size_t minChunk = MIN_SCAN_CHUNK_SIZE)
+				: _next(beg), _stopped(false) {
+			_end = end;
+			_nThread = nThread == 0 ? 1 : nThread;
+			_minChunk = minChunk == 0 ? 1 : minChunk;
+		}
+		bool next(size_t& beg, size_t& end);
+		//! Stop handing out blocks. Threads should also check getStopped before each scan in their current block.
+		void stop(){
+			_stopped = true;
+		}
+		bool getStopped() const{
+			return _stopped.load(std::memory_order_relaxed);
+		}
+	};
+
+	//!Amino acid masses for each sequest.params file or smod file and modification mass
+	typedef std::map<std::string, aaDB::AADB> AminoAcidMassesMap;
+	/**
+	 Get the modified residue in a protein from the protein ID, peptide sequence and
+	 modification location. The last argument is set to false if the protein or peptide is not found.
+	 */
+	typedef std::function<std::string(const std::string&, const std::string&, int, bool&)> ModResidueFunction;
+
+	/**
+	 Modified residues of peptides looked up in a FASTA file before the peptides are analyzed.
+	 After every peptide is added the map is only read, so ModResidueMap::get
+	 can be called from any number of threads without a lock.
+	 */
+	class ModResidueMap{
+	public:
+		//!Protein ID, peptide sequence and modification location
+		typedef std::tuple<std::string, std::string, int> KeyType;
+		//!Modified residue and whether the protein and peptide were found
+		typedef std::pair<std::string, bool> ValueType;
+	private:
+		std::map<KeyType, ValueType> _residues;
+	public:
+		void add(utils::FastaFile& seqFile, const Dtafilter::Scan& scan,
+				 const PeptideNamespace::Peptide& peptide, bool verbose);
+		std::string get(const std::string& proteinID, const std::string& sequence,
+						int modLoc, bool& found) const;
+		size_t size() const{
+			return _residues.size();
+		}
+	};
+
+	/**
+	 Files read by findFragmentsParallel and analyzeSequences which are kept between calls,
+	 so experiments in a batch run which use the same files only read them once.
+	 */
+	struct SharedFiles{
+		AminoAcidMassesMap aminoAcidMasses;
+		//!FASTA files by path
+		std::map<std::string, utils::FastaFile> fastaFiles;
+		//!Number of calls to findFragmentsParallel. Metrics are appended to the metrics file after the first.
+		size_t nSearched;
+
+		SharedFiles(){
+			nSearched = 0;
+		}
+	};
 
 	bool findFragmentsParallel(std::vector<Dtafilter::Scan>&,
 							   std::vector<PeptideNamespace::Peptide>&,
-							   const IonFinder::Params&);
+							   const IonFinder::Params&,
+							   SharedFiles* sharedFiles = nullptr);
 
     void findFragments_(std::vector<Dtafilter::Scan>& scans,
                         size_t beg, size_t end,
@@ -82,16 +164,44 @@ namespace IonFinder{
                         bool* success, std::atomic<size_t>& scansIndex);
 
     void findFragments_threadSafe(std::vector<Dtafilter::Scan>& scans,
-                                  size_t beg, size_t end,
+                                  ScanScheduler& scheduler,
+                                  const std::vector<size_t>& scanOrder,
                                   ms2::MsInterface& msInterface,
                                   std::vector<PeptideNamespace::Peptide>& peptides,
                                   const IonFinder::Params& pars,
-                                  bool* success, std::atomic<size_t>& scansIndex);
+                                  const AminoAcidMassesMap& aminoAcidMassesMap,
+                                  bool* success, IonFinder::Metrics& metrics,
+                                  unsigned int threadIndex,
+                                  IonFinder::Checkpoint* checkpoint = nullptr,
+                                  ms2::ScanPrefetcher* prefetcher = nullptr);
+
+	std::string aminoAcidMassesKey(const Dtafilter::Scan& scan, const IonFinder::Params& pars);
+	const aaDB::AADB& addAminoAcidMasses(const Dtafilter::Scan& scan, const IonFinder::Params& pars,
+										 AminoAcidMassesMap& aminoAcidMassesMap);
+	bool initAminoAcidMasses(std::vector<Dtafilter::Scan>::const_iterator begin,
+							 std::vector<Dtafilter::Scan>::const_iterator end,
+							 const IonFinder::Params& pars, AminoAcidMassesMap& aminoAcidMassesMap);
+
+	void initPeptide(const Dtafilter::Scan& scan,
+					 PeptideNamespace::Peptide& peptide,
+					 const IonFinder::Params& pars,
+					 const AminoAcidMassesMap& aminoAcidMassesMap);
+
+	void findFragments_scan(Dtafilter::Scan& scan,
+							PeptideNamespace::Peptide& peptide,
+							ms2::MsInterface& msInterface,
+							const IonFinder::Params& pars,
+							const AminoAcidMassesMap& aminoAcidMassesMap,
+							ms2::Spectrum& spectrum);
+
+	void findFragments_spectrum(Dtafilter::Scan& scan,
+								PeptideNamespace::Peptide& peptide,
+								const IonFinder::Params& pars,
+								const AminoAcidMassesMap& aminoAcidMassesMap,
+								ms2::Spectrum& spectrum);
+
+	std::runtime_error scanNotFoundError(const Dtafilter::Scan& scan);
 
-	void findFragmentsProgress(std::atomic<size_t>& scansIndex, size_t count,
-							   const std::string& message,
-							   int sleepTime = PROGRESS_SLEEP_TIME);
-	
 	bool findFragments(std::vector<Dtafilter::Scan>& scans,
 					   std::vector<PeptideNamespace::Peptide>& peptides,
 					   IonFinder::Params& pars);
@@ -99,10 +209,19 @@ namespace IonFinder{
 	bool analyzeSequences(std::vector<Dtafilter::Scan>&,
 						  const std::vector<PeptideNamespace::Peptide>&,
 						  std::vector<PeptideStats>&,
-						  const IonFinder::Params&);
+						  const IonFinder::Params&,
+						  SharedFiles* sharedFiles = nullptr);
+
+	void analyzeSequence(Dtafilter::Scan& scan,
+						 const PeptideNamespace::Peptide& peptide,
+						 std::vector<PeptideStats>& peptideStats,
+						 const IonFinder::Params& pars,
+						 const ModResidueFunction& modResidue, int& nSeqNotFound);
 
 	bool printFragmentIntensities(const std::vector<PeptideStats>&, std::string, std::string = "");
 	
+	void printPeptideStatsHeader(std::ostream& out, const IonFinder::Params&);
+
 	bool printPeptideStats(const std::vector<PeptideStats>&,
 						   const IonFinder::Params&);
 	
@@ -132,13 +251,11 @@ namespace IonFinder{
 
 	class PeptideStats{
 	public:
-		friend bool analyzeSequences(std::vector<Dtafilter::Scan>&,
-									 const std::vector<PeptideNamespace::Peptide>&,
-									 std::vector<PeptideStats>&,
-									 const IonFinder::Params&);
-		
-		friend bool printPeptideStats(const std::vector<PeptideStats>&,
-									  const IonFinder::Params&);
+		friend void analyzeSequence(Dtafilter::Scan&,
+									const PeptideNamespace::Peptide&,
+									std::vector<PeptideStats>&,
+									const IonFinder::Params&,
+									const ModResidueFunction&, int&);
 		enum class IonType{
 			//!All fragments identified
 			FRAG,
@@ -200,7 +317,7 @@ namespace IonFinder{
 	
 	public:		
 		PeptideStats(){
-			_scan = new Dtafilter::Scan;
+			_scan = nullptr;
 			initStats();
 			_fragDelim = FRAG_DELIM;
             containsCit = ContainsCitType::FALSE;
@@ -216,7 +333,7 @@ namespace IonFinder{
 		}
 		explicit PeptideStats(const PeptideNamespace::Peptide& p){
 			//PeptideStats data
-			_scan = new Dtafilter::Scan;
+			_scan = nullptr;
 			_fragDelim = FRAG_DELIM;
             containsCit = ContainsCitType::FALSE;
             thisContainsCit = ContainsCitType::FALSE;
@@ -247,6 +364,8 @@ namespace IonFinder{
         double fragmentIntensity(IonType, double min, double max = std::numeric_limits<double>::max()) const;
         double calcIntCO(double fractionArtifact) const;
         void printFragmentStats(std::ostream& out) const;
+		void printStats(std::ostream& out, const IonFinder::Params& pars) const;
+		static std::vector<IonType> getOutputIonTypes(const IonFinder::Params& pars);
 
 		//modifiers
 		PeptideStats& operator = (const PeptideStats&);
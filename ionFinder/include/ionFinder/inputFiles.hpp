@@ -28,12 +28,14 @@
 #ifndef inputFiles_hpp
 #define inputFiles_hpp
 
+
 #include <dtafilter.hpp>
 #include <ionFinder/params.hpp>
 #include <scanData.hpp>
 #include <utils.hpp>
 #include <tsvFile.hpp>
 #include <tsv_constants.hpp>
+#include <profile.hpp>
 
 namespace Dtafilter{
 	bool readFilterFiles(const IonFinder::Params&, std::vector<Dtafilter::Scan>&);
@@ -47,8 +49,13 @@ namespace IonFinder{
                                                         PRECURSOR_SCAN};
 	int const TSV_INPUT_OPTIONAL_COLNAMES_LEN = 10;
 	
+	bool readInput(const IonFinder::Params& pars, std::vector<Dtafilter::Scan>& scans);
+
 	bool readInputTsv(const std::string& ifname, std::vector<Dtafilter::Scan>&scans,
-					  bool skipReverse = false, int modFilter = 1);
+					  bool skipReverse = false, int modFilter = 1,
+					  const Dtafilter::ScanFilterFunction& filter = Dtafilter::ScanFilterFunction());
+
+	Dtafilter::ScanFilterFunction makeShardFilter(size_t& nRead, const IonFinder::Params& pars);
 }
 
 #endif /* inputFiles_hpp */
@@ -32,6 +32,10 @@
 #include <dtafilter.hpp>
 #include <ionFinder/inputFiles.hpp>
 #include <ionFinder/datProc.hpp>
+#include <ionFinder/pipeline.hpp>
+#include <ionFinder/merge.hpp>
+#include <ionFinder/convert.hpp>
+#include <ionFinder/batch.hpp>
 
 #include <peptide.hpp>
 
@@ -0,0 +1,53 @@
+//
+// merge.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef merge_hpp
+#define merge_hpp
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <queue>
+#include <functional>
+#include <memory>
+
+#include <ionFinder/params.hpp>
+#include <utils.hpp>
+
+namespace IonFinder{
+
+	//!First argument to run merge subcommand instead of search
+	std::string const MERGE_SUBCOMMAND = "merge";
+	std::string const MERGE_USAGE = "usage: ionFinder merge [-o <ofname>] <shard_file> [...]";
+
+	int mergeShards(int argc, const char* const argv[]);
+	bool mergeShardFiles(const std::vector<std::string>& ifnames, const std::string& ofname);
+	std::string removeShardOfname(const std::string& fname);
+}
+
+#endif /* merge_hpp */
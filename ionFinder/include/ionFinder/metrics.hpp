@@ -0,0 +1,130 @@
+//
+// metrics.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef metrics_hpp
+#define metrics_hpp
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <utility>
+
+#include <ionFinder/params.hpp>
+#include <peptide.hpp>
+#include <utils.hpp>
+
+namespace IonFinder{
+
+	//!Progress bar sleep time in seconds
+	int const PROGRESS_SLEEP_TIME = 1;
+	//!Max iterations of progress bar loop with no progress before a stall is reported
+	int const MAX_PROGRESS_ITTERATIONS = 600;
+
+	/**
+	 Counters updated by worker threads during a stage, and a monitor which periodically
+	 reports them. <br><br>
+	 Metrics::monitor prints the progress bar and, if Params::_metricsFile is set, writes one
+	 JSON object per line with the spectra labeled by each thread, bytes of ms data read,
+	 fragments matched, queue depths and ETA. If there is no progress for
+	 MAX_PROGRESS_ITTERATIONS iterations the stage is reported as stalled, but keeps running.
+	 */
+	class Metrics{
+	public:
+		typedef std::function<size_t()> GaugeType;
+		typedef std::chrono::steady_clock ClockType;
+
+	private:
+		//! Name of stage reported in metrics output
+		std::string _stage;
+		//! Total number of scans in stage
+		size_t _count;
+		unsigned int _nThread;
+
+		//! Scans which have finished the stage
+		std::atomic<size_t> _done;
+		//! Spectra labeled by each thread
+		std::unique_ptr<std::atomic<size_t>[]> _threadSpectra;
+		std::atomic<size_t> _fragmentsMatched;
+		GaugeType _bytesRead;
+		std::vector<std::pair<std::string, GaugeType> > _queues;
+
+		//! Set when the stage is finished or aborted
+		std::atomic<bool> _stopped;
+		std::mutex _mutex;
+		std::condition_variable _cv;
+
+		std::ofstream _outF;
+		//! Metrics output stream. nullptr if metrics are not being written.
+		std::ostream* _out;
+		ClockType::time_point _startTime;
+
+		size_t getSpectraLabeled() const;
+		void writeJson(const std::string& status, double elapsed, double interval, double idle,
+					   std::vector<size_t>& lastThreadSpectra);
+
+	public:
+		Metrics(std::string stage, size_t count, unsigned int nThread, const IonFinder::Params& pars,
+				bool append = false);
+
+		//! Add \p n scans which have finished the stage.
+		void addDone(size_t n = 1){
+			if((_done += n) >= _count)
+				_cv.notify_all();
+		}
+		void addSpectrum(unsigned int threadIndex, const PeptideNamespace::Peptide& peptide);
+		//! Set function to get the number of bytes of ms data read.
+		void setBytesRead(GaugeType bytesRead){
+			_bytesRead = std::move(bytesRead);
+		}
+		//! Add function to get the current depth of a queue.
+		void addQueue(std::string name, GaugeType depth){
+			_queues.emplace_back(std::move(name), std::move(depth));
+		}
+		void stop();
+
+		//! Is metrics output being written?
+		bool getWriteMetrics() const{
+			return _out != nullptr;
+		}
+		size_t getDone() const{
+			return _done.load();
+		}
+
+		void monitor(const std::string& message, bool printProgress,
+					 int sleepTime = PROGRESS_SLEEP_TIME);
+	};
+}
+
+#endif /* metrics_hpp */
@@ -33,10 +33,14 @@
 #include <map>
 #include <vector>
 #include <thread>
+#include <cstdint>
+#include <algorithm>
+#include <iterator>
 
 #include <ionFinder/ionFinder.hpp>
 #include <paramsBase.hpp>
 #include <utils.hpp>
+#include <fnv1a.hpp>
 
 namespace IonFinder{
 	
@@ -58,6 +62,29 @@ namespace IonFinder{
 	double const DEFAULT_NEUTRAL_LOSS_MASS = CIT_NL_MASS;
 	double const CIT_MOD_MASS = 0.984289;
 
+	//!Default maximum number of scans in each queue between pipeline stages
+	size_t const DEFAULT_PIPELINE_QUEUE_SIZE = 64;
+
+	//!Name of column with position of each row in the full input in sharded output files
+	std::string const SHARD_INPUT_INDEX_COL = "input_index";
+	//!Inserted before the extension of output files from each shard
+	std::string const SHARD_OFNAME_INFIX = ".shard_";
+
+	//!Default number of scans retrieved ahead of the scan being searched by each search thread
+	size_t const DEFAULT_PREFETCH_DEPTH = 4;
+
+	//!Default seconds between writes to checkpoint file
+	int const DEFAULT_CHECKPOINT_INTERVAL = 60;
+	//!Appended to output file name to get default checkpoint file name
+	std::string const CHECKPOINT_EXT = ".checkpoint";
+
+	//!Argument to --metrics which writes metrics to stderr instead of a file
+	std::string const METRICS_STDERR_STR = "-";
+
+	size_t getShard(const std::string& precursorFile, size_t nShards);
+	std::string makeShardOfname(const std::string& ofname, size_t shardIndex, size_t nShards);
+	bool parseMemorySize(const std::string& str, size_t& bytes);
+
 	class Params;
 	
 	class Params : public base::ParamsBase{
@@ -120,6 +147,46 @@ namespace IonFinder{
 
 		//!Should unique peptide be printed?
 		bool _printPeptideUID;
+
+		//! Should search, analysis and output be run as a pipeline?
+		bool _pipeline;
+
+		//! Maximum number of scans in each queue between pipeline stages
+		size_t _queueSize;
+
+		//! Which shard of the input to process (1 based)
+		size_t _shardIndex;
+		//! Total number of shards input is split into
+		size_t _nShards;
+
+		//! Path of manifest file listing experiments to run in batch mode
+		std::string _batchFile;
+
+		//! Path of file to write metrics to, or METRICS_STDERR_STR
+		std::string _metricsFile;
+
+		//! Path of Chrome trace file to write profile to
+		std::string _profileFile;
+
+		//! Path of file to write completed scans to
+		std::string _checkpointFile;
+		//! Seconds between writes to _checkpointFile
+		int _checkpointInterval;
+		//! Should completed scans in _checkpointFile be skipped?
+		bool _resume;
+		//! Arguments which affect search results. Used to check that a checkpoint is from the same analysis.
+		std::string _checkpointKey;
+
+		//! Should sidecar scan index files be read and written for MS files?
+		bool _useScanIndex;
+		//! Directory to store scan index files in. If empty, they are stored next to each MS file.
+		std::string _scanIndexDir;
+
+		//! Maximum bytes of MS files to keep loaded. 0 if there is no limit.
+		size_t _maxMemory;
+
+		//! Number of scans retrieved in the background ahead of the scan being searched. 0 to disable prefetching.
+		size_t _prefetchDepth;
 		
 		bool getFlist(bool force);
 		static unsigned int computeThreads() ;
@@ -148,6 +215,21 @@ namespace IonFinder{
 			_groupMod = 1;
 			_printIonIntensity = false;
 			_printPeptideUID = false;
+			_pipeline = false;
+			_queueSize = DEFAULT_PIPELINE_QUEUE_SIZE;
+			_shardIndex = 1;
+			_nShards = 1;
+			_batchFile = "";
+			_metricsFile = "";
+			_profileFile = "";
+			_checkpointFile = "";
+			_checkpointInterval = DEFAULT_CHECKPOINT_INTERVAL;
+			_resume = false;
+			_checkpointKey = "";
+			_useScanIndex = true;
+			_scanIndexDir = "";
+			_maxMemory = 0;
+			_prefetchDepth = DEFAULT_PREFETCH_DEPTH;
 		}
 		
 		//modifiers
@@ -186,11 +268,12 @@ namespace IonFinder{
             return _includeCTermMod;
         }
 		std::string makeOfname() const{
+			std::string _ofname = _nShards > 1 ? makeShardOfname(ofname, _shardIndex, _nShards) : ofname;
 			if(_inDirSpecified)
-				return _wd + "/" + ofname;
+				return _wd + "/" + _ofname;
 			else{
 				assert(_inDirs.size() == 1);
-				return _inDirs.back() + "/" + ofname;
+				return _inDirs.back() + "/" + _ofname;
 			}
 		}
 		bool getPrintSpectraFiles() const{
@@ -223,6 +306,59 @@ namespace IonFinder{
 		bool getPrintPeptideUID() const {
             return _printPeptideUID;
         }
+		bool getPipeline() const {
+			return _pipeline;
+		}
+		size_t getQueueSize() const {
+			return _queueSize;
+		}
+		size_t getShardIndex() const {
+			return _shardIndex;
+		}
+		size_t getNShards() const {
+			return _nShards;
+		}
+		std::string getBatchFile() const {
+			return _batchFile;
+		}
+		std::string getMetricsFile() const {
+			return _metricsFile;
+		}
+		std::string getProfileFile() const {
+			return _profileFile;
+		}
+		std::string getCheckpointFile() const {
+			return _checkpointFile;
+		}
+		int getCheckpointInterval() const {
+			return _checkpointInterval;
+		}
+		bool getResume() const {
+			return _resume;
+		}
+		const std::string& getCheckpointKey() const {
+			return _checkpointKey;
+		}
+		bool getUseScanIndex() const {
+			return _useScanIndex;
+		}
+		std::string getScanIndexDir() const {
+			return _scanIndexDir;
+		}
+		size_t getMaxMemory() const {
+			return _maxMemory;
+		}
+		size_t getPrefetchDepth() const {
+			return _prefetchDepth;
+		}
+		//! Is only part of the input being processed?
+		bool getSharded() const {
+			return _nShards > 1;
+		}
+		//! Should scans from \p precursorFile be processed by this shard?
+		bool inShard(const std::string& precursorFile) const {
+			return _nShards <= 1 || getShard(precursorFile, _nShards) == _shardIndex;
+		}
 	};
 }
 
@@ -0,0 +1,133 @@
+//
+// pipeline.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef pipeline_hpp
+#define pipeline_hpp
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <cstdio>
+
+#include <ionFinder/params.hpp>
+#include <ionFinder/datProc.hpp>
+#include <dtafilter.hpp>
+#include <peptide.hpp>
+#include <msInterface.hpp>
+
+namespace IonFinder{
+
+	/**
+	 Thread safe FIFO queue with a maximum size. <br>
+	 push blocks while the queue is full and pop blocks while it is empty,
+	 so a fast stage can never get more than \p capacity items ahead of a slow one.
+	 After close is called, push fails and pop fails once the remaining items are consumed.
+	 */
+	template<typename _Tp>
+	class BoundedQueue{
+	private:
+		mutable std::mutex _mutex;
+		std::condition_variable _notFull;
+		std::condition_variable _notEmpty;
+		std::deque<_Tp> _items;
+		size_t _capacity;
+		bool _closed;
+	public:
+		explicit BoundedQueue(size_t capacity){
+			_capacity = capacity == 0 ? 1 : capacity;
+			_closed = false;
+		}
+
+		/**
+		 Add \p item to the back of the queue, waiting for space if the queue is full.
+		 \return false if the queue was closed before \p item could be added.
+		 */
+		bool push(_Tp item){
+			std::unique_lock<std::mutex> lock(_mutex);
+			_notFull.wait(lock, [this](){ return _closed || _items.size() < _capacity; });
+			if(_closed) return false;
+			_items.push_back(std::move(item));
+			lock.unlock();
+			_notEmpty.notify_one();
+			return true;
+		}
+
+		/**
+		 Remove the item at the front of the queue, waiting for one if the queue is empty.
+		 \return false if the queue is closed and empty.
+		 */
+		bool pop(_Tp& item){
+			std::unique_lock<std::mutex> lock(_mutex);
+			_notEmpty.wait(lock, [this](){ return _closed || !_items.empty(); });
+			if(_items.empty()) return false;
+			item = std::move(_items.front());
+			_items.pop_front();
+			lock.unlock();
+			_notFull.notify_one();
+			return true;
+		}
+
+		//! Stop accepting new items and wake all waiting threads.
+		void close(){
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_closed = true;
+			}
+			_notFull.notify_all();
+			_notEmpty.notify_all();
+		}
+
+		size_t size() const{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _items.size();
+		}
+		size_t capacity() const{
+			return _capacity;
+		}
+	};
+
+	//! A single scan as it moves through the pipeline.
+	struct PipelineItem{
+		//! index of scan in input
+		size_t index;
+		PeptideNamespace::Peptide peptide;
+		std::vector<PeptideStats> stats;
+
+		explicit PipelineItem(size_t _index) : index(_index) {}
+	};
+	typedef std::unique_ptr<PipelineItem> PipelineItemPtr;
+
+	bool runPipeline(std::vector<Dtafilter::Scan>& scans, const IonFinder::Params& pars);
+}
+
+#endif /* pipeline_hpp */
@@ -0,0 +1,84 @@
+//
+// mappedFile.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef mappedFile_hpp
+#define mappedFile_hpp
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+// Platform headers are only included in mappedFile.cpp, because windows.h defines
+// macros such as TRUE and FALSE which collide with names in the rest of the program.
+
+namespace ms2 {
+    class MappedFile;
+
+    /**
+     * Read only memory mapped file which is unmapped when the object is destroyed. <br>
+     * Files are mapped with mmap on POSIX systems and with MapViewOfFile on Windows.
+     */
+    class MappedFile {
+    public:
+        //! How the mapped file will be accessed. Ignored on Windows.
+        enum class Advice{NORMAL, SEQUENTIAL, RANDOM};
+
+    private:
+        //! Beginning of mapped file. nullptr if no file is mapped.
+        const char* _data;
+        size_t _size;
+
+    public:
+        MappedFile() {
+            _data = nullptr;
+            _size = 0;
+        }
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator = (const MappedFile&) = delete;
+        ~MappedFile() {
+            close();
+        }
+
+        bool open(const std::string& fname);
+        void close();
+        void advise(Advice advice) const;
+        size_t getResidentSize() const;
+
+        const char* begin() const {
+            return _data;
+        }
+        const char* end() const {
+            return _data + _size;
+        }
+        size_t size() const {
+            return _size;
+        }
+    };
+}
+
+#endif //mappedFile_hpp
@@ -0,0 +1,93 @@
+//
+// mappedMs2File.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef mappedMs2File_hpp
+#define mappedMs2File_hpp
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <utility>
+#include <cstdlib>
+#include <cstring>
+
+#include <ms2Spectrum.hpp>
+#include <msFile.hpp>
+#include <dataFile.hpp>
+#include <scanIndex.hpp>
+#include <utils.hpp>
+
+namespace ms2 {
+    class MappedMs2File;
+
+    /**
+     * Read only .ms2 file which is memory mapped instead of being copied into a buffer. <br><br>
+     * When the file is opened, the mapped file is scanned once for 'S' lines to build an index of
+     * the byte offset of each scan. The header and peaks of a scan are only parsed when it is
+     * requested with getScan, so pages of the file with scans which are never requested are not read. <br>
+     * gzip and BGZF compressed files are also supported. For BGZF files, getScan only decompresses
+     * the blocks which hold the requested scan. <br>
+     * If an index file is given, the scan index is read from it instead, and written to it
+     * when it does not exist or is out of date. <br>
+     * Because scans are already parsed lazily, the list of needed scans passed to read is not used.
+     */
+    class MappedMs2File : public MsFile {
+    private:
+        DataFile _file;
+        //! Offset of the 'S' line of each scan
+        ScanIndex _index;
+        //! Sorted offsets of all scans, used to find where each scan ends.
+        std::vector<uint64_t> _offsets;
+
+        void buildIndex(const char* begin, const char* end);
+
+    public:
+        MappedMs2File() : MsFile() { }
+
+        bool read(const std::string& fname, const std::string& indexFname = "",
+                  const ScanNumList& scans = ScanNumList()) override;
+        bool getScan(size_t scanNum, ms2::Spectrum& scan) const override;
+        void getScanNums(ScanNumList& scanNums) const override;
+        size_t getMemoryUsage() const override {
+            return _file.getMemoryUsage() + _index.size() * sizeof(ScanIndex::Entry) +
+                   _offsets.capacity() * sizeof(uint64_t);
+        }
+
+        const ScanIndex& getIndex() const {
+            return _index;
+        }
+        size_t getNumScans() const {
+            return _index.size();
+        }
+        size_t getSize() const {
+            return _file.size();
+        }
+    };
+}
+
+#endif //mappedMs2File_hpp
@@ -0,0 +1,52 @@
+//
+// matchWindows.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef matchWindows_hpp
+#define matchWindows_hpp
+
+#include <cstddef>
+
+/*
+ Find the peaks in the match tolerance window of each fragment ion.
+ The match tolerance of a fragment with m/z x is x * relative + absolute, so ppm and Th
+ tolerances are both supported. On x86 processors, tolerances are calculated and peaks are
+ compared to the window bounds with AVX-512 or AVX2 instructions if the processor supports
+ them, which is checked when ionFinder is run. Otherwise one value is processed at a time.
+ */
+namespace matchWindows{
+
+	void find(const double* fragments, size_t nFragments,
+			  double relative, double absolute,
+			  const double* peaks, size_t nPeaks,
+			  size_t* begins, size_t* ends);
+	void findScalar(const double* fragments, size_t nFragments,
+					double relative, double absolute,
+					const double* peaks, size_t nPeaks,
+					size_t* begins, size_t* ends);
+}
+
+#endif /* matchWindows_hpp */
@@ -35,6 +35,7 @@
 #include <cassert>
 #include <list>
 #include <algorithm>
+#include <functional>
 #include <memory>
 #include <string>
 #include <iomanip>
@@ -48,6 +49,9 @@
 #include <calcLableLocs.hpp>
 #include <scanData.hpp>
 #include <spectrum_constants.hpp>
+#include <profile.hpp>
+#include <matchWindows.hpp>
+#include <mzBinIndex.hpp>
 
 namespace ms2{
 	
@@ -63,9 +67,20 @@ namespace ms2{
 	double const DEFAULT_X_OFFSET = 0;
 	double const DEFAULT_Y_OFFSET = 3;
 	size_t const LABEL_TOP = 200;
+	//! Max number of peaks for which the t distribution is used to find noise peaks.
+	size_t const SNR_T_MAX_PEAKS = 30;
+	//! Ratio of the interquartile range to the standard deviation of a normal distribution.
+	double const IQR_NORM_SD = 1.349;
+	//! Min number of neighboring peaks in the m/z window needed to estimate local noise.
+	size_t const SNR_WINDOW_MIN_PEAKS = 5;
+	//! Min number of fragments for which fragments are matched to peaks with an MZBinIndex.
+	size_t const BIN_INDEX_MIN_FRAGMENTS = 100;
+	//! Min ratio of fragments to peaks for which fragments are matched to peaks with an MZBinIndex.
+	double const BIN_INDEX_MIN_FRAGMENT_RATIO = 1.5;
 	
 	class Spectrum;
 	class DataPoint;
+	class MsFile;
 
     class DataPoint {
 		friend class Spectrum;
@@ -200,11 +215,119 @@ namespace ms2{
         };
 	};
 	
+	/**
+	 * Options for Spectrum::preprocess. <br>
+	 * By default, intensities are not normalized and no peaks are removed.
+	 */
+	struct PreprocessOptions {
+		//! Should intensities be normalized so the max intensity is normalizeMax?
+		bool normalize;
+		double normalizeMax;
+		bool minIntensitySpecified;
+		//! Peaks with a normalized intensity below minIntensity are removed.
+		double minIntensity;
+		//! Number of most intense peaks which can be labeled.
+		size_t labelTop;
+		bool minMZSpecified;
+		double minMZ;
+		bool maxMZSpecified;
+		double maxMZ;
+		bool minSNRSpecified;
+		double minSNR;
+		double snrConf;
+		//! Width of m/z window used to estimate local noise. If 0, noise is estimated from the whole spectrum.
+		double snrWindow;
+
+		PreprocessOptions(){
+			normalize = false;
+			normalizeMax = 100;
+			minIntensitySpecified = false;
+			minIntensity = 0;
+			labelTop = LABEL_TOP;
+			minMZSpecified = false;
+			minMZ = 0;
+			maxMZSpecified = false;
+			maxMZ = 0;
+			minSNRSpecified = false;
+			minSNR = 0;
+			snrConf = 0.9;
+			snrWindow = 0;
+		}
+		explicit PreprocessOptions(const base::ParamsBase& pars, size_t labelTop = LABEL_TOP);
+	};
+
     class Spectrum : public utils::msInterface::Scan{
+		friend class MsFile;
 	private:
 		typedef std::vector<ms2::DataPoint> ionVecType;
 		typedef ionVecType::const_iterator ionsTypeConstIt;
 		typedef ionVecType::iterator ionsTypeIt;
+
+		//! Rule used to choose between multiple ions in range of a fragment.
+		enum class MultipleMatchCompare {INTENSITY, MZ, UNKNOWN};
+
+		//! Bits of Peaks::flags
+		enum PeakFlag : unsigned char {
+			//! Is the peak one of the top n most intense peaks in the Spectrum?
+			PEAK_TOP_ABUNDANT = 1,
+			//! Is the peak statistically considered noise?
+			PEAK_NOISE = 2
+		};
+		//! Value of a missing peak or DataPoint index.
+		static size_t const NO_INDEX = size_t(-1);
+
+		/**
+		 * Peaks considered for labeling, stored as separate arrays so the filtering and matching
+		 * passes only read the values they use. <br>
+		 * Label data is only created in Spectrum::_dataPoints for peaks which are labeled
+		 * or drawn by calcLabelPos.
+		 */
+		struct Peaks {
+			std::vector<utils::msInterface::ScanMZ> mz;
+			std::vector<utils::msInterface::ScanIntensity> intensity;
+			//! Signal to noise ratio
+			std::vector<double> snr;
+			//! PeakFlag bits
+			std::vector<unsigned char> flags;
+			//! Index of the peak in Scan::_ions
+			std::vector<size_t> ion;
+			//! Index of the label data of the peak in Spectrum::_dataPoints or NO_INDEX.
+			std::vector<size_t> dataPoint;
+
+			size_t size() const{
+				return mz.size();
+			}
+			void clear();
+			void reserve(size_t len);
+			void add(const utils::msInterface::ScanIon& scanIon, size_t index);
+			void permute(const std::vector<size_t>& order);
+			void erase(size_t begin, size_t end);
+
+			/**
+			 * Remove peaks in a single pass, keeping the order of the remaining peaks.
+			 * \param remove Function which is called with the index of each peak and returns
+			 * true if the peak should be removed.
+			 */
+			template<typename _Pred> void removeIf(_Pred remove)
+			{
+				size_t len = size();
+				size_t n = 0;
+				for(size_t i = 0; i < len; i++)
+				{
+					if(remove(i)) continue;
+					if(n != i){
+						mz[n] = mz[i];
+						intensity[n] = intensity[i];
+						snr[n] = snr[i];
+						flags[n] = flags[i];
+						ion[n] = ion[i];
+						dataPoint[n] = dataPoint[i];
+					}
+					n++;
+				}
+				erase(n, len);
+			}
+		};
 		
 		//static metadata
 		double plotHeight;
@@ -217,13 +340,30 @@ namespace ms2{
 		//! Stores data about scan from input, not what was retrieved from the ms2 file.
 		scanData::Scan* _scanData;
 
+		Peaks _peaks;
+		//! Label data of peaks in _peaks. Not in m/z order.
 		ionVecType _dataPoints;
+		//! Have the peaks been initialized by preprocess since the ions were set?
+		bool _preprocessed;
 
 		void makePoints(labels::Labels&, double, double, double, double, double);
 		void setLabelTop(size_t);
+		void sortPeaksByMZ();
 		void removeUnlabeledIons();
-		void initLabeledIons();
 		void calcSNR(double snrConf);
+		void calcLocalSNR(double snrConf, double snrWindow);
+		static MultipleMatchCompare getMultipleMatchCompare(const base::ParamsBase& pars);
+		size_t bestMatch(double mz, size_t begin, size_t end, MultipleMatchCompare compare) const;
+		void matchFragments(const PeptideNamespace::Peptide& peptide,
+		                    const base::ParamsBase& pars,
+		                    std::vector<size_t>& matches) const;
+		void matchFragmentsIndexed(const PeptideNamespace::Peptide& peptide,
+		                           const base::ParamsBase& pars,
+		                           std::vector<size_t>& matches) const;
+		DataPoint& getDataPoint(size_t peak);
+		bool isLabeled(size_t peak) const{
+			return _peaks.dataPoint[peak] != NO_INDEX && _dataPoints[_peaks.dataPoint[peak]].getLabeledIon();
+		}
 
 	public:
 		Spectrum() : utils::msInterface::Scan()
@@ -233,6 +373,7 @@ namespace ms2{
 			plotWidth = 0;
 			plotHeight = 0;
 			_dataPoints = ionVecType();
+			_preprocessed = false;
 			_scanData = nullptr;
 		}
 		~Spectrum() = default;
@@ -240,7 +381,7 @@ namespace ms2{
 		//modifiers
 		void clear();
         void removeIntensityBelow(double minInt);
-        void removeSNRBelow(double snrThreshold, double snrConf = 0.9);
+        void removeSNRBelow(double snrThreshold, double snrConf = 0.9, double snrWindow = 0);
         void setMZRange(double minMZ, double maxMZ, bool _sort = true);
 
 		/**
@@ -255,7 +396,9 @@ namespace ms2{
 				ion.setIntensity(ion.getIntensity() / den);
 
 			updateRanges();
+			_preprocessed = false;
 		}
+		void preprocess(const PreprocessOptions& options);
 		void labelSpectrum(PeptideNamespace::Peptide& peptide,
 						   const base::ParamsBase& pars,
 						   bool removeUnlabeledFrags = false,
@@ -0,0 +1,124 @@
+//
+// msFile.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef msFile_hpp
+#define msFile_hpp
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <ms2Spectrum.hpp>
+#include <msInterface/msInterface.hpp>
+#include <msInterface/msScan.hpp>
+#include <utils.hpp>
+
+namespace ms2 {
+    class MsFile;
+
+    //! Extension of gzip or BGZF compressed MS files.
+    std::string const GZIP_EXT = ".gz";
+
+    /**
+     * Base class for readers of a single MS file used by MsInterface. <br>
+     * Readers are given the scans which will be requested from the file, so they
+     * can skip decoding the peaks of every other scan.
+     */
+    class MsFile {
+    public:
+        //! Sorted list of scan numbers. An empty list means every scan is needed.
+        typedef std::vector<size_t> ScanNumList;
+
+    protected:
+        std::string _fname;
+
+        //! Should \p scanNum be parsed?
+        static bool isNeeded(const ScanNumList& scans, size_t scanNum) {
+            return scans.empty() || std::binary_search(scans.begin(), scans.end(), scanNum);
+        }
+        //! Ion vector of \p scan, which derived classes can fill directly.
+        static std::vector<utils::msInterface::ScanIon>& ions(ms2::Spectrum& scan) {
+            return scan._ions;
+        }
+        static utils::msInterface::PrecursorScan& precursor(ms2::Spectrum& scan) {
+            return scan.precursorScan;
+        }
+        //! Sample name of scans in the file, which is the file name without its directory or extension.
+        std::string getSampleName() const {
+            return utils::removeExtension(utils::baseName(removeGzipExt(_fname)));
+        }
+
+    public:
+        MsFile() {
+            _fname = "";
+        }
+        virtual ~MsFile() = default;
+
+        /**
+         * Read \p fname.
+         * @param fname Path of MS file.
+         * @param indexFname Path of sidecar index file. Empty if no index file should be used.
+         * @param scans Scans which will be requested from the file.
+         * @return true if the file was successfully read.
+         */
+        virtual bool read(const std::string& fname, const std::string& indexFname, const ScanNumList& scans) = 0;
+        virtual bool getScan(size_t scanNum, ms2::Spectrum& scan) const = 0;
+        //! Get the sorted scan numbers of all the scans which can be retrieved with getScan.
+        virtual void getScanNums(ScanNumList& scanNums) const = 0;
+        //! Bytes of memory used by the file. For mapped files, only pages which are in memory are counted.
+        virtual size_t getMemoryUsage() const = 0;
+
+        const std::string& getFileName() const {
+            return _fname;
+        }
+
+        //! Get \p fname without GZIP_EXT at the end.
+        static std::string removeGzipExt(const std::string& fname) {
+            if(fname.size() > GZIP_EXT.size() &&
+               utils::toLower(fname.substr(fname.size() - GZIP_EXT.size())) == GZIP_EXT)
+                return fname.substr(0, fname.size() - GZIP_EXT.size());
+            return fname;
+        }
+        /**
+         * Get the type of an MS file, ignoring GZIP_EXT at the end of \p fname.
+         */
+        static utils::msInterface::MsInterface::FileType getFileType(const std::string& fname) {
+            return utils::msInterface::MsInterface::getFileType(removeGzipExt(fname));
+        }
+        /**
+         * Get the path to read for \p fname. If \p fname does not exist,
+         * but a compressed copy ending in GZIP_EXT does, the compressed file is used.
+         */
+        static std::string findFile(const std::string& fname) {
+            if(!utils::fileExists(fname) && utils::fileExists(fname + GZIP_EXT))
+                return fname + GZIP_EXT;
+            return fname;
+        }
+    };
+}
+
+#endif //msFile_hpp
@@ -33,36 +33,150 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <thread>
+#include <atomic>
+#include <fstream>
 
 #include <dtafilter.hpp>
+#include <profile.hpp>
+#include <ms2Spectrum.hpp>
+#include <msFile.hpp>
+#include <mappedMs2File.hpp>
+#include <xmlMsFile.hpp>
+#include <peakStore.hpp>
 #include <msInterface/msInterface.hpp>
 #include <msInterface/msScan.hpp>
-#include <msInterface/ms2File.hpp>
-#include <msInterface/mzXMLFile.hpp>
-#include <msInterface/mzMLFile.hpp>
 
 namespace ms2 {
     class MsInterface;
 
     class MsInterface {
-        typedef std::map<std::string, std::shared_ptr<utils::msInterface::MsInterface> > Ms2Map;
+    public:
         typedef std::vector<Dtafilter::Scan> InputScanList;
+        typedef std::shared_ptr<MsFile> MsFilePtr;
+
+    private:
+        //! A single MS file. The file can be released and read again if it is needed after it is released.
+        struct FileEntry {
+            enum class State {UNLOADED, LOADING, LOADED, FAILED};
+
+            std::string fname;
+            //! Path of sidecar scan index file. Empty if scan index files are not used.
+            std::string indexFname;
+            //! Protects state, file, scans, memory, users and badStore.
+            std::mutex mutex;
+            //! Notified when a thread finishes loading the file.
+            std::condition_variable loaded;
+            State state;
+            MsFilePtr file;
+            //! Scans which are needed from the file. If empty, all scans are read.
+            MsFile::ScanNumList scans;
+            //! Bytes of memory used by the file when it was last measured.
+            size_t memory;
+            //! Number of threads which are currently retrieving a scan from the file.
+            size_t users;
+            //! Set if the peak store for the file could not be read, so the MS file is read instead.
+            bool badStore;
+            //! Total bytes read from file, including each time it is reloaded.
+            std::atomic<size_t> nBytes;
+            //! Number of scans which still need to be retrieved from the file.
+            std::atomic<size_t> remaining;
+            /**
+             * Number of scans which have been requested but not retrieved yet.
+             * A file with outstanding scans is about to be used, so it is not released to stay under the memory limit.
+             */
+            std::atomic<size_t> outstanding;
+            //! Value of MsInterface::_clock when the file was last used.
+            std::atomic<uint64_t> lastUsed;
 
-        std::mutex mutex;
+            FileEntry(std::string _fname, std::string _indexFname)
+                    : fname(std::move(_fname)), indexFname(std::move(_indexFname)),
+                      state(State::UNLOADED), memory(0), users(0), badStore(false), nBytes(0), remaining(0), outstanding(0),
+                      lastUsed(0) { }
+        };
+        typedef std::shared_ptr<FileEntry> FileEntryPtr;
+        typedef std::map<std::string, FileEntryPtr> Ms2Map;
+
+        mutable std::mutex mutex;
         Ms2Map _ms2Map;
-        void getUniqueFileList(std::vector<std::string>& fnames,
-                               std::vector<Dtafilter::Scan>::const_iterator begin,
-                               std::vector<Dtafilter::Scan>::const_iterator end) const;
+        //! Set by ingest. After it is set, _ms2Map is no longer modified.
+        std::atomic<bool> _ingesting;
+        //! File reader threads started by ingest.
+        std::vector<std::thread> _readers;
+        //! Should scan index files be read and written?
+        bool _useScanIndex;
+        //! Directory to store scan index files in. If empty, they are stored next to each MS file.
+        std::string _scanIndexDir;
+
+        //! Maximum bytes of loaded files. 0 if there is no limit.
+        size_t _maxMemory;
+        //! Bytes used by loaded files.
+        mutable std::atomic<size_t> _memoryUsed;
+        //! Incremented each time a file is used.
+        mutable std::atomic<uint64_t> _clock;
+        //! Used by reader threads to wait for memory to be freed before reading the next file.
+        mutable std::mutex _memoryMutex;
+        mutable std::condition_variable _memoryFreed;
+        //! Set when reader threads should stop.
+        bool _stopReaders;
+
+        static void getUniqueFileList(std::vector<std::string>& fnames,
+                                      InputScanList::const_iterator begin,
+                                      InputScanList::const_iterator end);
+        FileEntryPtr getEntry(const std::string& fname);
+        FileEntryPtr findEntry(const std::string& fname) const;
+        FileEntryPtr makeEntry(const std::string& fname) const;
+        void countScans(InputScanList::const_iterator begin, InputScanList::const_iterator end, bool request);
+        bool load(FileEntry& entry) const;
+        MsFilePtr readStore(FileEntry& entry, const MsFile::ScanNumList& scans, std::string& path) const;
+        bool unload(FileEntry& entry, bool evict = false) const;
+        void updateMemory(FileEntry& entry) const;
+        void enforceMemoryLimit(const FileEntry* keep) const;
+        bool overMemoryLimit() const {
+            return _maxMemory > 0 && _memoryUsed.load() > _maxMemory;
+        }
+        bool getScan(FileEntry& entry, ms2::Spectrum& scan, size_t scanNum) const;
     public:
-        MsInterface(){
+        MsInterface() : _ingesting(false), _memoryUsed(0), _clock(0) {
             _ms2Map = Ms2Map();
+            _useScanIndex = true;
+            _scanIndexDir = "";
+            _maxMemory = 0;
+            _stopReaders = false;
         }
-        ~MsInterface(){}
+        ~MsInterface();
 
         bool read(InputScanList::const_iterator begin, InputScanList::const_iterator end);
         bool read(std::string fname);
-        bool getScan(utils::msInterface::Scan&, std::string fname, size_t scanNum) const;
-        bool getScan(utils::msInterface::Scan&, std::string fname, size_t scanNum);
+        bool ingest(InputScanList::const_iterator begin, InputScanList::const_iterator end,
+                    unsigned int nThread, bool readAhead = true);
+        bool request(const std::string& fname) const;
+        bool getScan(ms2::Spectrum&, std::string fname, size_t scanNum) const;
+        bool getScan(ms2::Spectrum&, std::string fname, size_t scanNum);
+        size_t getBytesRead() const;
+        size_t getMemoryUsed() const {
+            return _memoryUsed.load();
+        }
+
+        void setScanIndex(bool useScanIndex, const std::string& scanIndexDir = "");
+        /**
+         * Set the maximum memory used by loaded files. When it is exceeded, the least recently
+         * used files which no thread is using and which have no outstanding scans are released,
+         * and read again if they are needed later. Files are not read ahead while the limit is exceeded.
+         * Must be called before any files are read.
+         * @param maxMemory Bytes. 0 for no limit.
+         */
+        void setMaxMemory(size_t maxMemory) {
+            _maxMemory = maxMemory;
+        }
+
+        static MsFilePtr makeFile(const std::string& fname);
+        static void groupScansByFile(InputScanList::const_iterator begin,
+                                     InputScanList::const_iterator end,
+                                     std::vector<size_t>& order);
     };
 
 }
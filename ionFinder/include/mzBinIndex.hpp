@@ -0,0 +1,90 @@
+//
+// mzBinIndex.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef mzBinIndex_hpp
+#define mzBinIndex_hpp
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace ms2 {
+    class MZBinIndex;
+
+    /**
+     * Hashed index of m/z values in fixed width bins, used to find the values in the
+     * match tolerance of an m/z in constant time. <br><br>
+     * The match tolerance of an m/z x is x * relative + absolute, as returned by
+     * base::ParamsBase::getMatchToleranceCoefficients. The bin width is the width of the tolerance
+     * window of the largest indexed value, so the window of any m/z in the indexed range overlaps
+     * at most two bins. <br>
+     * Bins which have values are stored in an open addressing hash table with linear probing,
+     * so the size of the index does not depend on the m/z range or tolerance. <br>
+     * The m/z values must be sorted and must not change while the index is used.
+     */
+    class MZBinIndex {
+        typedef int64_t BinType;
+
+        //! Range of indices in _mzs in a bin. Empty slots in the hash table have end == 0.
+        struct Bin {
+            BinType bin;
+            size_t begin, end;
+        };
+
+        const double* _mzs;
+        size_t _len;
+        double _relative;
+        double _absolute;
+        double _binWidth;
+        BinType _minBin, _maxBin;
+        size_t _nBins;
+        //! Hash table of bins. Size is a power of 2.
+        std::vector<Bin> _table;
+
+        BinType getBin(double mz) const {
+            return BinType(std::floor(mz / _binWidth));
+        }
+        size_t getSlot(BinType bin) const {
+            return size_t((uint64_t(bin) * 0x9E3779B97F4A7C15ULL) >> 32) & (_table.size() - 1);
+        }
+        const Bin* findBin(BinType bin) const;
+
+    public:
+        MZBinIndex(const std::vector<double>& mzs, double relative, double absolute);
+
+        void find(double mz, size_t& begin, size_t& end) const;
+        double getBinWidth() const {
+            return _binWidth;
+        }
+        size_t getNumBins() const {
+            return _nBins;
+        }
+    };
+}
+
+#endif //mzBinIndex_hpp
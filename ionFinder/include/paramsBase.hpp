@@ -69,6 +69,8 @@ namespace base{
         double _minSNR;
         //! Confidence interval for distinguishing signal from noise
         double _snrConf;
+        //! Width of m/z window used to estimate local noise
+        double _snrWindow;
 		
 		//match tolerance stuff
 		//!match tolerance for fragment ions in either ppm or Th
@@ -125,6 +127,7 @@ namespace base{
 			minLabelIntensity = 0;
             _minSNR = 0;
             _snrConf = 0.9;
+            _snrWindow = 0;
 			multipleMatchCompare = "intensity";
 			
 			seqParSpecified = false;
@@ -172,6 +175,7 @@ namespace base{
 		}
 		double getMatchTolerance() const;
 		double getMatchTolerance(double mz) const;
+		void getMatchToleranceCoefficients(double& relative, double& absolute) const;
 		double getMinLabelIntensity() const{
 			return minLabelIntensity;
 		}
@@ -208,6 +212,9 @@ namespace base{
 		double getSNRConf() const {
 		    return _snrConf;
         }
+		double getSNRWindow() const {
+		    return _snrWindow;
+		}
 		bool getIncludeAllIons() const{
 			return includeAllIons;
 		}
@@ -0,0 +1,132 @@
+//
+// peakStore.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef peakStore_hpp
+#define peakStore_hpp
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <ms2Spectrum.hpp>
+#include <msFile.hpp>
+#include <mappedFile.hpp>
+#include <scanIndex.hpp>
+#include <msInterface/msScan.hpp>
+#include <utils.hpp>
+
+namespace ms2 {
+    class PeakStore;
+
+    //!First bytes of peak store file. Last byte is format version.
+    char const PEAK_STORE_MAGIC[8] = {'I', 'F', 'P', 'E', 'A', 'K', 'S', '\2'};
+    //!Appended to MS file name to get the name of its peak store file.
+    std::string const PEAK_STORE_EXT = ".peaks";
+
+    /**
+     * Binary copy of the scans in an MS file which is memory mapped instead of being parsed. <br><br>
+     * A peak store file written by PeakStore::write has a fixed size header, a directory with one entry
+     * for each scan sorted by scan number, an array with the m/z of every peak, an array with the
+     * intensity of every peak, and a table with the precursor m/z and scan strings. The peaks of each
+     * scan are contiguous in both arrays. Values are written in native byte order. <br>
+     * The header stores the size and modification time of the MS file the store was written from,
+     * and the store is not used if the MS file still exists and either of them have changed.
+     */
+    class PeakStore : public MsFile {
+    public:
+        struct Header {
+            char magic[8];
+            //! Size of the MS file the store was written from.
+            uint64_t sourceSize;
+            //! Modification time of the MS file in nanoseconds.
+            int64_t sourceMtime;
+            uint64_t nScans;
+            uint64_t nPeaks;
+            //! Size of string table in bytes.
+            uint64_t stringsSize;
+            uint64_t reserved[2];
+        };
+
+        struct DirEntry {
+            uint64_t scanNum;
+            //! Index of first peak of scan in peak arrays.
+            uint64_t peakOffset;
+            uint64_t nPeaks;
+            double rt;
+            double precursorIntensity;
+            //! Offset and length of precursor m/z in string table.
+            uint32_t mzOffset, mzLen;
+            //! Offset and length of precursor scan in string table.
+            uint32_t scanOffset, scanLen;
+            int32_t charge;
+            int32_t reserved;
+        };
+
+    private:
+        MappedFile _file;
+        const Header* _header;
+        const DirEntry* _dir;
+        const double* _mz;
+        const double* _intensity;
+        const char* _strings;
+
+        static size_t fileSize(const Header& header);
+        const DirEntry* find(size_t scanNum) const;
+
+    public:
+        PeakStore() : MsFile() {
+            _header = nullptr;
+            _dir = nullptr;
+            _mz = nullptr;
+            _intensity = nullptr;
+            _strings = nullptr;
+        }
+
+        bool read(const std::string& fname, const std::string& indexFname = "",
+                  const ScanNumList& scans = ScanNumList()) override;
+        bool getScan(size_t scanNum, ms2::Spectrum& scan) const override;
+        void getScanNums(ScanNumList& scanNums) const override;
+        size_t getMemoryUsage() const override {
+            return _file.getResidentSize();
+        }
+
+        static std::string findStore(const std::string& fname);
+        static bool write(const std::string& ofname, const MsFile& file, const ScanIndex::FileKey& key);
+    };
+}
+
+#endif //peakStore_hpp
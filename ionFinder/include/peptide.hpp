@@ -383,6 +383,9 @@ namespace PeptideNamespace{
         void removeUnlabeledFrags();
         void normalizeLabelIntensity(double den);
         void removeLabelIntensityBelow(double min_int, bool require_nl = false, bool remove = false);
+        void setID(std::uint64_t id){
+            _id = id;
+        }
 
         //properties
         std::string getSequence() const{
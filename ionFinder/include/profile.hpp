@@ -0,0 +1,157 @@
+//
+// profile.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef profile_hpp
+#define profile_hpp
+
+#include <string>
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <cstdint>
+
+#include <config.h>
+#include <utils.hpp>
+
+/*
+ Profiling hooks which record scoped timings in Chrome trace-event format.
+ Hooks are only compiled if ionFinder is built with -DENABLE_PROFILE=ON.
+ Otherwise, the macros below expand to empty statements, so they can still be
+ used as the body of an if statement.
+ */
+#ifdef ENABLE_PROFILE
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+//! Record time from macro until the end of the enclosing scope as \p name. \p name must be a string literal.
+#define PROFILE_SCOPE(name) profile::Scope PROFILE_CONCAT(_profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+//! Set name of calling thread in trace.
+#define PROFILE_THREAD_NAME(name) profile::setThreadName(name)
+//! Record events until the end of the enclosing scope and write them to \p fname.
+#define PROFILE_SESSION(fname) profile::Session PROFILE_CONCAT(_profileSession, __LINE__)(fname)
+#else
+#define PROFILE_SCOPE(name) do{}while(0)
+#define PROFILE_FUNCTION() do{}while(0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#define PROFILE_SESSION(fname) do{}while(0)
+#endif
+
+namespace profile{
+
+	typedef std::chrono::steady_clock ClockType;
+
+	//! A single complete event.
+	struct Event{
+		const char* name;
+		//! Start time in microseconds since profiling started
+		double begin;
+		//! Duration in microseconds
+		double duration;
+		Event(const char* _name, double _begin, double _duration){
+			name = _name;
+			begin = _begin;
+			duration = _duration;
+		}
+	};
+
+	//! Events recorded by a single thread.
+	struct ThreadBuffer{
+		uint32_t tid;
+		std::string name;
+		std::vector<Event> events;
+		explicit ThreadBuffer(uint32_t _tid){
+			tid = _tid;
+		}
+	};
+	typedef std::shared_ptr<ThreadBuffer> ThreadBufferPtr;
+
+	/**
+	 Collects events from all threads. <br>
+	 Each thread appends to its own ThreadBuffer, so recording an event does not lock.
+	 Buffers are only combined by Profiler::write after worker threads are joined.
+	 */
+	class Profiler{
+	private:
+		std::atomic<bool> _enabled;
+		ClockType::time_point _startTime;
+		std::mutex _mutex;
+		std::vector<ThreadBufferPtr> _buffers;
+
+		Profiler() : _enabled(false) {}
+	public:
+		static Profiler& instance();
+
+		void start();
+		void stop(){
+			_enabled = false;
+		}
+		bool getEnabled() const{
+			return _enabled.load(std::memory_order_relaxed);
+		}
+		double now() const{
+			return std::chrono::duration<double, std::micro>(ClockType::now() - _startTime).count();
+		}
+		ThreadBuffer& threadBuffer();
+		bool write(const std::string& fname);
+	};
+
+	void setThreadName(const std::string& name);
+
+	//! Records the time from construction until destruction as a single event.
+	class Scope{
+	private:
+		const char* _name;
+		double _begin;
+	public:
+		explicit Scope(const char* name){
+			_name = Profiler::instance().getEnabled() ? name : nullptr;
+			if(_name) _begin = Profiler::instance().now();
+		}
+		~Scope(){
+			if(!_name) return;
+			Profiler& profiler = Profiler::instance();
+			profiler.threadBuffer().events.emplace_back(_name, _begin, profiler.now() - _begin);
+		}
+		Scope(const Scope&) = delete;
+		Scope& operator = (const Scope&) = delete;
+	};
+
+	//! Starts profiling on construction and writes trace to a file on destruction.
+	class Session{
+	private:
+		std::string _fname;
+	public:
+		explicit Session(std::string fname);
+		~Session();
+	};
+}
+
+#endif /* profile_hpp */
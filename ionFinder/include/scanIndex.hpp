@@ -0,0 +1,135 @@
+//
+// scanIndex.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef scanIndex_hpp
+#define scanIndex_hpp
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <utils.hpp>
+#include <fnv1a.hpp>
+
+namespace ms2 {
+    class ScanIndex;
+
+    //!First bytes of scan index file. Last byte is format version.
+    char const SCAN_INDEX_MAGIC[8] = {'I', 'F', 'S', 'I', 'D', 'X', '\0', '\2'};
+    //!Appended to MS file name to get the name of its scan index file.
+    std::string const SCAN_INDEX_EXT = ".scanIndex";
+    //!Directory in the user cache directory where index files are stored by default.
+    std::string const SCAN_INDEX_CACHE_DIR = "ionFinder/scanIndex";
+
+    /**
+     * Byte offset of each scan in an MS file, which can be saved to a sidecar file
+     * so later runs do not have to find the scans again. <br><br>
+     * The sidecar file stores the path, size and modification time of the MS file it was built from,
+     * and is ignored if any of them have changed. Values are written in native byte order.
+     */
+    class ScanIndex {
+    public:
+        struct Entry {
+            uint64_t scanNum;
+            //! Offset of the beginning of the scan in the MS file.
+            uint64_t offset;
+
+            Entry() {
+                scanNum = 0;
+                offset = 0;
+            }
+        };
+
+        //! Identifies the version of the MS file an index was built from.
+        struct FileKey {
+            std::string path;
+            uint64_t size;
+            //! Modification time in nanoseconds.
+            int64_t mtime;
+
+            FileKey() {
+                path = "";
+                size = 0;
+                mtime = 0;
+            }
+            bool operator == (const FileKey& rhs) const {
+                return path == rhs.path && size == rhs.size && mtime == rhs.mtime;
+            }
+            bool operator != (const FileKey& rhs) const {
+                return !(*this == rhs);
+            }
+        };
+
+    private:
+        //! Sorted by scan number after sort() is called.
+        std::vector<Entry> _entries;
+
+    public:
+        ScanIndex() {
+            _entries = std::vector<Entry>();
+        }
+
+        static bool getFileKey(const std::string& fname, FileKey& key);
+        static std::string indexFname(const std::string& fname, const std::string& indexDir = "");
+        static std::string defaultIndexDir();
+
+        bool read(const std::string& indexFname, const FileKey& key);
+        bool write(const std::string& indexFname, const FileKey& key) const;
+
+        void clear() {
+            _entries.clear();
+        }
+        void add(const Entry& entry) {
+            _entries.push_back(entry);
+        }
+        void sort();
+        const Entry* find(size_t scanNum) const;
+        size_t size() const {
+            return _entries.size();
+        }
+        Entry& back() {
+            return _entries.back();
+        }
+        const Entry& operator [] (size_t i) const {
+            return _entries[i];
+        }
+    };
+}
+
+#endif //scanIndex_hpp
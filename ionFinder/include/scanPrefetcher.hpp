@@ -0,0 +1,131 @@
+//
+// scanPrefetcher.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef scanPrefetcher_hpp
+#define scanPrefetcher_hpp
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+
+#include <ms2Spectrum.hpp>
+#include <msInterface.hpp>
+#include <profile.hpp>
+
+namespace ms2 {
+    class ScanPrefetcher;
+
+    /**
+     * Pool of threads which retrieve scans from an MsInterface in the background, so the next scans
+     * are read and decoded while the current scan is being searched. <br><br>
+     * Each search thread requests the scans it will need next through its own ScanPrefetcher::Queue,
+     * and takes them from the queue in the order they were requested.
+     */
+    class ScanPrefetcher {
+    public:
+        class Queue;
+
+    private:
+        struct Request {
+            std::string fname;
+            size_t scanNum;
+            ms2::Spectrum spectrum;
+            //! Set when the scan has been retrieved.
+            bool done;
+            bool success;
+
+            Request() {
+                scanNum = 0;
+                done = true;
+                success = false;
+            }
+        };
+
+        const MsInterface& _msInterface;
+        //! Maximum number of scans requested ahead by each queue.
+        size_t _depth;
+        //! Protects _requests, _stop and Request::done of every request.
+        std::mutex _mutex;
+        //! Notified when a request is added.
+        std::condition_variable _requested;
+        //! Notified when a request is finished.
+        std::condition_variable _finished;
+        //! Requests which have not been started, in the order they were made.
+        std::deque<Request*> _requests;
+        bool _stop;
+        std::vector<std::thread> _threads;
+
+        void run(unsigned int threadIndex);
+
+    public:
+        ScanPrefetcher(const MsInterface& msInterface, unsigned int nThread, size_t depth);
+        ScanPrefetcher(const ScanPrefetcher&) = delete;
+        ScanPrefetcher& operator = (const ScanPrefetcher&) = delete;
+        ~ScanPrefetcher();
+
+        size_t getDepth() const {
+            return _depth;
+        }
+    };
+
+    /**
+     * Scans requested by a single thread. The Spectrum of each request is reused after it is popped. <br>
+     * A Queue should only be used by one thread, and must be destroyed before its ScanPrefetcher.
+     */
+    class ScanPrefetcher::Queue {
+    private:
+        ScanPrefetcher& _prefetcher;
+        //! Ring buffer of requests.
+        std::vector<std::unique_ptr<Request> > _slots;
+        size_t _front;
+        size_t _size;
+
+    public:
+        explicit Queue(ScanPrefetcher& prefetcher);
+        Queue(const Queue&) = delete;
+        Queue& operator = (const Queue&) = delete;
+        ~Queue();
+
+        //! Can more scans be requested?
+        bool full() const {
+            return _size == _slots.size();
+        }
+        bool empty() const {
+            return _size == 0;
+        }
+        void push(const std::string& fname, size_t scanNum);
+        ms2::Spectrum& front(bool& success);
+        void pop();
+    };
+}
+
+#endif //scanPrefetcher_hpp
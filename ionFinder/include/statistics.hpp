@@ -31,6 +31,9 @@
 #include <cmath>
 #include <functional>
 #include <vector>
+#include <limits>
+#include <numeric>
+#include <algorithm>
 
 namespace statistics{
 
@@ -38,6 +41,7 @@ namespace statistics{
     class TDist;
 
     double trapezium(double a, double b, std::function<double(double)> f, int n = 1000);
+    double regIncompleteBeta(double x, double a, double b, double lnBeta);
 
     //! Abstract base class for probability distributions
     class ProbabilityDist{
@@ -52,8 +56,13 @@ namespace statistics{
         }
         //! Probability density function of distribution
         virtual double pdf(double x) const = 0;
+        //! Cumulative distribution function of distribution
+        virtual double cdf(double x) const = 0;
         //! p-value of value x
-        virtual double pValue(double x) const = 0;
+        double pValue(double x) const{
+            return cdf(x);
+        }
+        double quantile(double p) const;
     };
 
     //! Student's T distribution
@@ -66,7 +75,7 @@ namespace statistics{
         }
         void setNu(double nu);
         double pdf(double x) const override;
-        double pValue(double x) const override;
+        double cdf(double x) const override;
     };
 
     //! Normal distribution
@@ -77,7 +86,89 @@ namespace statistics{
             _coeff = calcCoeff();
         };
         double pdf(double x) const override;
-        double pValue(double x) const override;
+        double cdf(double x) const override;
+    };
+
+    /**
+     * Critical values of the normal distribution and of Student's t distribution
+     * for a confidence level. <br>
+     * A statistic is significant at the confidence level if it is greater than the critical value.
+     */
+    class CriticalValues{
+        double _conf;
+        double _norm;
+        //! Critical values of the t distribution indexed by degrees of freedom.
+        std::vector<double> _t;
+    public:
+        CriticalValues(){
+            _conf = std::numeric_limits<double>::quiet_NaN();
+            _norm = std::numeric_limits<double>::quiet_NaN();
+        }
+        CriticalValues(double conf, size_t maxDf);
+
+        double getConf() const{
+            return _conf;
+        }
+        //! Critical value of the normal distribution
+        double norm() const{
+            return _norm;
+        }
+        double t(size_t df) const;
+    };
+
+    /**
+     * Quantiles of a sliding window over a vector of values. <br><br>
+     *
+     * The values are ranked once when the object is constructed. Values are added to and removed from the
+     * window by their index, and the window is stored as counts of ranks in a binary indexed tree, so
+     * adding or removing a value and finding a quantile of the window are O(log n).
+     */
+    class WindowQuantiles{
+        //! Values in ascending order.
+        std::vector<double> _sorted;
+        //! Index of each value in _sorted.
+        std::vector<size_t> _rank;
+        //! Binary indexed tree of rank counts (1 based).
+        std::vector<size_t> _tree;
+        //! Largest power of 2 <= number of values.
+        size_t _highBit;
+        //! Number of values in window.
+        size_t _size;
+
+        void update(size_t index, bool add);
+    public:
+        template<class T> explicit WindowQuantiles(const std::vector<T>& values){
+            size_t len = values.size();
+            std::vector<size_t> order(len);
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&values](size_t a, size_t b){
+                return values[a] < values[b];
+            });
+            _sorted.resize(len);
+            _rank.resize(len);
+            for(size_t r = 0; r < len; r++){
+                _sorted[r] = double(values[order[r]]);
+                _rank[order[r]] = r;
+            }
+            _tree.assign(len + 1, 0);
+            _highBit = 1;
+            while(_highBit * 2 <= len) _highBit *= 2;
+            _size = 0;
+        }
+
+        //! Add value at \p index to window.
+        void insert(size_t index){
+            update(index, true);
+        }
+        //! Remove value at \p index from window.
+        void erase(size_t index){
+            update(index, false);
+        }
+        size_t size() const{
+            return _size;
+        }
+        double kth(size_t k) const;
+        double quantile(double p) const;
     };
 
     /**
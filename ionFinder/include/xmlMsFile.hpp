@@ -0,0 +1,122 @@
+//
+// xmlMsFile.hpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#ifndef xmlMsFile_hpp
+#define xmlMsFile_hpp
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+
+#include <config.h>
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <ms2Spectrum.hpp>
+#include <msFile.hpp>
+#include <dataFile.hpp>
+#include <base64.hpp>
+#include <msInterface/msScan.hpp>
+#include <utils.hpp>
+
+namespace ms2 {
+    class XmlMsFile;
+
+    /**
+     * Reader for mzML and mzXML files which only decodes the peaks of needed scans. <br><br>
+     * If the file has an offset index (indexed mzML or mzXML with an index of scans), only the elements
+     * of the needed scans are read, starting at their offsets in the index. Each element is checked to be
+     * the scan the index says it is. <br>
+     * If a check fails, a needed scan is not in the index, or the file has no index, the file is read in a single pass. The scan number
+     * of each spectrum is read from its start tag, and spectra which are not in the list of needed scans
+     * are skipped without parsing their parameters or decoding their binary data. <br>
+     * Needed scans are stored until the file is released. <br>
+     * Binary data is decoded with base64::decode and written directly into the ions of each scan. <br>
+     * Compressed files are decompressed into memory before they are parsed.
+     */
+    class XmlMsFile : public MsFile {
+    public:
+        enum class Format {MZML, MZXML};
+
+    private:
+        struct StoredScan {
+            utils::msInterface::PrecursorScan precursor;
+            std::vector<utils::msInterface::ScanIon> ions;
+        };
+
+        //! Scan number and offset of an element in the offset index of a file.
+        struct IndexEntry {
+            size_t scanNum;
+            uint64_t offset;
+            bool operator < (const IndexEntry& rhs) const {
+                return scanNum < rhs.scanNum;
+            }
+        };
+        class BinaryDecoder;
+
+        Format _format;
+        std::map<size_t, StoredScan> _scans;
+        size_t _memoryUsage;
+
+        const char* elementName() const {
+            return _format == Format::MZML ? "spectrum" : "scan";
+        }
+        size_t getScanNum(const char* tagBegin, const char* tagEnd) const;
+        bool readOffsetIndex(const DataFile& file, std::vector<IndexEntry>& index, uint64_t& indexOffset) const;
+        bool readIndexed(const DataFile& file, const ScanNumList& scans);
+        void parseSpectrum(size_t scanNum, const char* pos, const char* tagEnd, const char* spectrumEnd, BinaryDecoder& decoder);
+        void parseScan(size_t scanNum, const char* pos, const char* tagEnd, const char* scanEnd, BinaryDecoder& decoder);
+        void parseMzML(const char* begin, const char* end, const ScanNumList& scans);
+        void parseMzXML(const char* begin, const char* end, const ScanNumList& scans);
+
+    public:
+        explicit XmlMsFile(Format format) : MsFile() {
+            _format = format;
+            _memoryUsage = 0;
+        }
+
+        bool read(const std::string& fname, const std::string& indexFname = "",
+                  const ScanNumList& scans = ScanNumList()) override;
+        bool getScan(size_t scanNum, ms2::Spectrum& scan) const override;
+        void getScanNums(ScanNumList& scanNums) const override;
+        size_t getMemoryUsage() const override {
+            return _memoryUsage;
+        }
+        size_t getNumScans() const {
+            return _scans.size();
+        }
+    };
+}
+
+#endif //xmlMsFile_hpp
@@ -0,0 +1,228 @@
+//
+// base64.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <base64.hpp>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BASE64_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace{
+
+	//! Value of each base64 character, or -1 for characters which are not in the alphabet.
+	struct DecodeTable{
+		int8_t values[256];
+		DecodeTable(){
+			for(int i = 0; i < 256; i++) values[i] = -1;
+			const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+			for(int i = 0; i < 64; i++)
+				values[(unsigned char)alphabet[i]] = int8_t(i);
+		}
+	};
+	const DecodeTable DECODE_TABLE;
+
+	//! Block decoder for the scalar decoder, which never decodes a block.
+	struct NoBlock{
+		static size_t const SIZE = 0;
+		bool operator()(const char*, char*) const{
+			return false;
+		}
+	};
+
+	/**
+	 Decode base64 text, decoding blocks of _Block::SIZE characters at once with a _Block when
+	 they start a new group of 4 characters. The block decoder returns false if the block contains
+	 characters which are not in the alphabet, in which case the block is decoded one character
+	 at a time. Characters which are not in the alphabet are skipped and decoding stops at the first '='. <br>
+	 The block decoder is a type rather than a function pointer, so it can be inlined into the loop.
+	 Callers compiled for another instruction set than this template must be flattened so that
+	 the loop and block decoder are both compiled for the caller's target.
+	 */
+	template<typename _Block>
+	inline size_t decodeBlocks(const char* begin, const char* end, char* out)
+	{
+		size_t const BLOCK = _Block::SIZE;
+		const _Block decodeBlock;
+		char* const outBegin = out;
+		uint32_t buffer = 0;
+		int nChars = 0;
+		for(const char* c = begin; c < end;){
+			if(BLOCK > 0 && nChars == 0 && size_t(end - c) >= BLOCK && decodeBlock(c, out)){
+				c += BLOCK;
+				out += BLOCK / 4 * 3;
+				continue;
+			}
+			if(*c == '=') break;
+			int8_t value = DECODE_TABLE.values[(unsigned char)*c++];
+			if(value < 0) continue;
+			buffer = (buffer << 6) | uint32_t(value);
+			if(++nChars == 4){
+				*out++ = char(buffer >> 16);
+				*out++ = char(buffer >> 8);
+				*out++ = char(buffer);
+				buffer = 0;
+				nChars = 0;
+			}
+		}
+		//incomplete group at end of text
+		if(nChars == 2)
+			*out++ = char(buffer >> 4);
+		else if(nChars == 3){
+			*out++ = char(buffer >> 10);
+			*out++ = char(buffer >> 2);
+		}
+		return size_t(out - outBegin);
+	}
+
+#ifdef BASE64_X86_SIMD
+	/*
+	 Block decoders translate characters to 6 bit values with nibble lookup tables, which also
+	 find characters that are not in the alphabet, then pack each group of 4 values into 3 bytes.
+	 */
+
+	//! Decode 16 characters to 12 bytes. 16 bytes are written to \p out.
+	struct BlockSSE41{
+		static size_t const SIZE = 16;
+		__attribute__((target("sse4.1")))
+		bool operator()(const char* in, char* out) const;
+	};
+
+	__attribute__((target("sse4.1")))
+	inline bool BlockSSE41::operator()(const char* in, char* out) const
+	{
+		const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+											0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+		const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+											0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+		const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+											  0, 0, 0, 0, 0, 0, 0, 0);
+		const __m128i mask2F = _mm_set1_epi8(0x2F);
+
+		__m128i str = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+		const __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask2F);
+		const __m128i loNibbles = _mm_and_si128(str, mask2F);
+		if(!_mm_testz_si128(_mm_shuffle_epi8(lutLo, loNibbles), _mm_shuffle_epi8(lutHi, hiNibbles)))
+			return false;
+		const __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(_mm_cmpeq_epi8(str, mask2F), hiNibbles));
+		str = _mm_add_epi8(str, roll);
+
+		str = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+		str = _mm_madd_epi16(str, _mm_set1_epi32(0x00011000));
+		str = _mm_shuffle_epi8(str, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), str);
+		return true;
+	}
+
+	//! Decode 32 characters to 24 bytes. 32 bytes are written to \p out.
+	struct BlockAVX2{
+		static size_t const SIZE = 32;
+		__attribute__((target("avx2")))
+		bool operator()(const char* in, char* out) const;
+	};
+
+	__attribute__((target("avx2")))
+	inline bool BlockAVX2::operator()(const char* in, char* out) const
+	{
+		const __m256i lutLo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+											   0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+											   0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+											   0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+		const __m256i lutHi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+											   0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+											   0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+											   0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+		const __m256i lutRoll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+												 0, 0, 0, 0, 0, 0, 0, 0,
+												 0, 16, 19, 4, -65, -65, -71, -71,
+												 0, 0, 0, 0, 0, 0, 0, 0);
+		const __m256i mask2F = _mm256_set1_epi8(0x2F);
+
+		__m256i str = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+		const __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask2F);
+		const __m256i loNibbles = _mm256_and_si256(str, mask2F);
+		if(!_mm256_testz_si256(_mm256_shuffle_epi8(lutLo, loNibbles), _mm256_shuffle_epi8(lutHi, hiNibbles)))
+			return false;
+		const __m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(_mm256_cmpeq_epi8(str, mask2F), hiNibbles));
+		str = _mm256_add_epi8(str, roll);
+
+		str = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+		str = _mm256_madd_epi16(str, _mm256_set1_epi32(0x00011000));
+		str = _mm256_shuffle_epi8(str, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+														2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+		//move the 12 bytes from each lane next to each other
+		str = _mm256_permutevar8x32_epi32(str, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), str);
+		return true;
+	}
+
+	//! The whole loop is flattened into the SIMD decoders so the block decoders are inlined.
+	__attribute__((target("sse4.1"), flatten))
+	size_t decodeSSE41(const char* begin, const char* end, char* out){
+		return decodeBlocks<BlockSSE41>(begin, end, out);
+	}
+
+	__attribute__((target("avx2"), flatten))
+	size_t decodeAVX2(const char* begin, const char* end, char* out){
+		return decodeBlocks<BlockAVX2>(begin, end, out);
+	}
+#endif
+
+	typedef size_t (*DecodeFunction)(const char*, const char*, char*);
+
+	//! Get the fastest decoder supported by the processor.
+	DecodeFunction selectDecoder()
+	{
+#ifdef BASE64_X86_SIMD
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2"))
+			return decodeAVX2;
+		if(__builtin_cpu_supports("sse4.1"))
+			return decodeSSE41;
+#endif
+		return base64::decodeScalar;
+	}
+}
+
+/**
+ Decode base64 text between \p begin and \p end into \p out.
+ Characters which are not in the base64 alphabet, such as white space, are skipped,
+ and decoding stops at the first '='.
+ \param out Buffer with room for base64::decodedSize(end - begin) + base64::DECODE_PADDING bytes.
+ \return Number of bytes decoded.
+ */
+size_t base64::decode(const char* begin, const char* end, char* out)
+{
+	static const DecodeFunction function = selectDecoder();
+	return function(begin, end, out);
+}
+
+//! base64::decode without SIMD instructions.
+size_t base64::decodeScalar(const char* begin, const char* end, char* out)
+{
+	return decodeBlocks<NoBlock>(begin, end, out);
+}
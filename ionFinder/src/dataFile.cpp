@@ -0,0 +1,311 @@
+//
+// dataFile.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <dataFile.hpp>
+
+static unsigned char const GZIP_MAGIC[2] = {0x1f, 0x8b};
+//! Size of BGZF block header, including the BC extra subfield
+static size_t const BGZF_HEADER_SIZE = 18;
+//! Size of gzip trailer with CRC32 and uncompressed size
+static size_t const GZIP_TRAILER_SIZE = 8;
+
+static uint16_t readUInt16(const unsigned char* data){
+    return uint16_t(data[0] | (uint16_t(data[1]) << 8));
+}
+
+static uint32_t readUInt32(const unsigned char* data){
+    return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+}
+
+/**
+ * Open \p fname. The compression type is detected from the first bytes of the file.
+ * @param fname Path of file.
+ * @return true if the file was successfully opened.
+ */
+bool ms2::DataFile::open(const std::string& fname)
+{
+    close();
+    if(!_file.open(fname)) return false;
+
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(_file.begin());
+    if(_file.size() < 2 || data[0] != GZIP_MAGIC[0] || data[1] != GZIP_MAGIC[1]){
+        _compression = Compression::NONE;
+        _size = _file.size();
+        return true;
+    }
+
+#ifndef ENABLE_ZLIB
+    throw std::runtime_error(fname + " is compressed, but ionFinder was built without zlib");
+#endif
+    if(buildBlockIndex()){
+        _compression = Compression::BGZF;
+        return true;
+    }
+    _compression = Compression::GZIP;
+    bool success = decompressGzip();
+    //the compressed data is no longer needed
+    _file.close();
+    if(!success) throw std::runtime_error("Failed to decompress " + fname);
+    return true;
+}
+
+void ms2::DataFile::close()
+{
+    _file.close();
+    std::string().swap(_buffer);
+    _blocks.clear();
+    _size = 0;
+    _compression = Compression::NONE;
+    std::lock_guard<std::mutex> lock(_cacheMutex);
+    _cache.clear();
+    _cacheOrder.clear();
+}
+
+/**
+ * Read the header of each block in a BGZF file to get its compressed size and
+ * the size of its uncompressed data.
+ * @return false if the file is not a valid BGZF file.
+ */
+bool ms2::DataFile::buildBlockIndex()
+{
+    _blocks.clear();
+    _size = 0;
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(_file.begin());
+    size_t fileSize = _file.size();
+    for(size_t offset = 0; offset < fileSize;)
+    {
+        //gzip header with FEXTRA flag and a single BC subfield
+        const unsigned char* header = data + offset;
+        if(fileSize - offset < BGZF_HEADER_SIZE + GZIP_TRAILER_SIZE ||
+           header[0] != GZIP_MAGIC[0] || header[1] != GZIP_MAGIC[1] ||
+           header[2] != 8 || (header[3] & 4) == 0 ||
+           readUInt16(header + 10) != 6 ||
+           header[12] != 'B' || header[13] != 'C' || readUInt16(header + 14) != 2){
+            _blocks.clear();
+            _size = 0;
+            return false;
+        }
+        size_t blockSize = size_t(readUInt16(header + 16)) + 1;
+        if(blockSize < BGZF_HEADER_SIZE + GZIP_TRAILER_SIZE || blockSize > fileSize - offset){
+            _blocks.clear();
+            _size = 0;
+            return false;
+        }
+
+        Block block;
+        block.offset = offset;
+        block.size = blockSize;
+        block.dataOffset = _size;
+        _size += readUInt32(header + blockSize - 4);
+        _blocks.push_back(block);
+        offset += blockSize;
+    }
+    return !_blocks.empty();
+}
+
+/**
+ * Decompress a gzip file into _buffer, one chunk at a time.
+ * Files with more than one gzip member are decompressed as a single stream.
+ * zlib checks the CRC32 and uncompressed size in the trailer of each member. <br>
+ * _buffer is reserved from the uncompressed size in the trailer of the last member so
+ * single member files are decompressed without reallocating.
+ * @return true if successful.
+ */
+bool ms2::DataFile::decompressGzip()
+{
+#ifdef ENABLE_ZLIB
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    //32 enables gzip header detection
+    if(inflateInit2(&stream, 15 + 32) != Z_OK) return false;
+
+    const size_t chunkSize = size_t(1) << 20;
+    std::string().swap(_buffer);
+    if(_file.size() >= GZIP_TRAILER_SIZE){
+        //deflate can not compress by more than 1032:1, which bounds the size of a corrupt trailer
+        size_t isize = readUInt32(reinterpret_cast<const unsigned char*>(_file.end()) - 4);
+        _buffer.reserve(std::min(isize, _file.size() * 1032) + 1);
+    }
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(_file.begin()));
+    size_t remaining = _file.size();
+    int ret = Z_OK;
+    while(remaining > 0 || ret == Z_OK)
+    {
+        if(stream.avail_in == 0){
+            stream.avail_in = uInt(std::min(remaining, size_t(UINT32_MAX)));
+            remaining -= stream.avail_in;
+        }
+        //fill the reserved space before growing the buffer
+        size_t used = _buffer.size();
+        size_t outSize = _buffer.capacity() > used ? std::min(_buffer.capacity() - used, chunkSize) : chunkSize;
+        _buffer.resize(used + outSize);
+        stream.next_out = reinterpret_cast<Bytef*>(&_buffer[used]);
+        stream.avail_out = uInt(outSize);
+        ret = inflate(&stream, Z_NO_FLUSH);
+        _buffer.resize(used + outSize - stream.avail_out);
+
+        if(ret == Z_STREAM_END){
+            //start the next gzip member, if there is one
+            if(stream.avail_in == 0 && remaining == 0) break;
+            if(inflateReset(&stream) != Z_OK) break;
+            ret = Z_OK;
+        }
+        else if(ret != Z_OK){
+            inflateEnd(&stream);
+            return false;
+        }
+    }
+    inflateEnd(&stream);
+    _size = _buffer.size();
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Decompress a single BGZF block and check it against the CRC32 in the block trailer.
+ * The uncompressed size in the trailer is checked by requiring inflate to fill exactly \p out.
+ * @param blockIndex Index of block in _blocks.
+ * @param out Buffer with room for the uncompressed block.
+ */
+void ms2::DataFile::decompressBlock(size_t blockIndex, char* out) const
+{
+#ifdef ENABLE_ZLIB
+    const Block& block = _blocks[blockIndex];
+    size_t dataSize = (blockIndex + 1 < _blocks.size() ? _blocks[blockIndex + 1].dataOffset : _size) - block.dataOffset;
+    if(dataSize == 0) return;
+
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    //raw deflate data between the block header and trailer
+    if(inflateInit2(&stream, -15) != Z_OK)
+        throw std::runtime_error("Failed to initialize zlib");
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(_file.begin() + block.offset + BGZF_HEADER_SIZE));
+    stream.avail_in = uInt(block.size - BGZF_HEADER_SIZE - GZIP_TRAILER_SIZE);
+    stream.next_out = reinterpret_cast<Bytef*>(out);
+    stream.avail_out = uInt(dataSize);
+    int ret = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    if(ret != Z_STREAM_END || stream.avail_out != 0)
+        throw std::runtime_error("Failed to decompress BGZF block");
+    const unsigned char* trailer = reinterpret_cast<const unsigned char*>(_file.begin()) + block.offset + block.size - GZIP_TRAILER_SIZE;
+    if(crc32(0L, reinterpret_cast<const Bytef*>(out), uInt(dataSize)) != readUInt32(trailer))
+        throw std::runtime_error("CRC mismatch in BGZF block");
+#endif
+}
+
+/**
+ * Get a decompressed BGZF block, using the cache of recently used blocks.
+ * This function is thread safe.
+ */
+ms2::DataFile::BlockPtr ms2::DataFile::getBlock(size_t blockIndex) const
+{
+    {
+        std::lock_guard<std::mutex> lock(_cacheMutex);
+        auto it = _cache.find(blockIndex);
+        if(it != _cache.end()) return it->second;
+    }
+
+    size_t dataSize = (blockIndex + 1 < _blocks.size() ? _blocks[blockIndex + 1].dataOffset : _size) - _blocks[blockIndex].dataOffset;
+    auto block = std::make_shared<std::string>(dataSize, '\0');
+    decompressBlock(blockIndex, &(*block)[0]);
+
+    std::lock_guard<std::mutex> lock(_cacheMutex);
+    if(_cache.emplace(blockIndex, block).second){
+        _cacheOrder.push_back(blockIndex);
+        if(_cacheOrder.size() > BGZF_BLOCK_CACHE_SIZE){
+            _cache.erase(_cacheOrder.front());
+            _cacheOrder.pop_front();
+        }
+    }
+    return block;
+}
+
+/**
+ * Get \p len bytes of uncompressed data starting at \p offset. <br>
+ * For plain and gzip files, a pointer into the file is returned and \p buffer is not used.
+ * For BGZF files, only the blocks which hold the range are decompressed into \p buffer.
+ * This function is thread safe.
+ * @param offset Offset in uncompressed data.
+ * @param len Number of bytes. Truncated if the range extends past the end of the file.
+ * @param buffer Buffer to use if data has to be decompressed.
+ * @return Pointer to the beginning of the range.
+ */
+const char* ms2::DataFile::read(size_t offset, size_t len, std::string& buffer) const
+{
+    if(offset > _size) offset = _size;
+    len = std::min(len, _size - offset);
+    if(isContiguous()) return begin() + offset;
+
+    buffer.clear();
+    buffer.reserve(len);
+    //find first block containing offset
+    auto it = std::upper_bound(_blocks.begin(), _blocks.end(), offset,
+                               [](size_t value, const Block& block){ return value < block.dataOffset; });
+    size_t blockIndex = size_t(it - _blocks.begin()) - 1;
+    for(size_t pos = offset; pos < offset + len; blockIndex++){
+        BlockPtr block = getBlock(blockIndex);
+        size_t blockBegin = pos - _blocks[blockIndex].dataOffset;
+        size_t n = std::min(block->size() - blockBegin, offset + len - pos);
+        buffer.append(*block, blockBegin, n);
+        pos += n;
+    }
+    return buffer.data();
+}
+
+/**
+ * Copy all of the uncompressed data into \p buffer.
+ */
+void ms2::DataFile::readAll(std::string& buffer) const
+{
+    if(isContiguous()){
+        buffer.assign(begin(), _size);
+        return;
+    }
+    buffer.resize(_size);
+    for(size_t i = 0; i < _blocks.size(); i++)
+        decompressBlock(i, &buffer[_blocks[i].dataOffset]);
+}
+
+/**
+ * Get the bytes of memory used by the open file. <br>
+ * For mapped files, only the pages which are in memory are counted, so the result
+ * grows as more of the file is read.
+ */
+size_t ms2::DataFile::getMemoryUsage() const
+{
+    if(_compression == Compression::GZIP) return _buffer.capacity();
+    size_t ret = _file.getResidentSize();
+    if(_compression == Compression::BGZF){
+        ret += _blocks.capacity() * sizeof(Block);
+        std::lock_guard<std::mutex> lock(_cacheMutex);
+        for(const auto& block: _cache)
+            ret += block.second->capacity();
+    }
+    return ret;
+}
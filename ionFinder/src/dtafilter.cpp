@@ -31,12 +31,14 @@
 Dtafilter::Scan& Dtafilter::Scan::operator = (const Dtafilter::Scan& rhs)
 {
 	scanData::Scan::operator=(rhs);
+	_formula = rhs._formula;
     _parentProtein = rhs._parentProtein;
 	_parentID = rhs._parentID;
 	_parentDescription = rhs._parentDescription;
 	_matchDirection = rhs._matchDirection;
 	_sampleName = rhs._sampleName;
 	_unique = rhs._unique;
+	_inputIndex = rhs._inputIndex;
 
 	return *this;
 }
@@ -87,6 +89,8 @@ bool Dtafilter::Scan::parse_matchDir_ID_Protein(const std::string& str)
  \param skipReverse Should reverse peptide matches be skipped?
  \param modFilter Which scans should be added to \p scans?
 	0: only modified, 1: all peptides regardless of modification, 2: only unmodified pepeitde.
+ \param filter If not empty, called with each scan which passes the other filters before it is added.
+ Scans for which it returns false are not added.
  
  \return true if file I/O was successful.
  */
@@ -94,7 +98,8 @@ bool Dtafilter::readFilterFile(const std::string& fname,
 							   const std::string& sampleName,
 							   std::vector<Dtafilter::Scan>& scans,
 							   bool skipReverse,
-							   int modFilter)
+							   int modFilter,
+							   const ScanFilterFunction& filter)
 {
 	std::ifstream inF(fname);
 	if(!inF) return false;
@@ -158,6 +163,9 @@ bool Dtafilter::readFilterFile(const std::string& fname,
 					if((modFilter == 0 && !newScan.isModified()) ||
 					   (modFilter == 2 && newScan.isModified()))
 						continue;
+
+					if(filter && !filter(newScan))
+						continue;
 					
 					scans.push_back(newScan);
 					
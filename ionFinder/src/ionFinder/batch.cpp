@@ -0,0 +1,152 @@
+//
+// batch.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <ionFinder/batch.hpp>
+
+/**
+ Read batch manifest file. <br><br>
+ Each line in \p fname describes one experiment and contains the arguments which would
+ be given to ionFinder to run that experiment by itself. The arguments on each line are appended
+ to the command line arguments in \p argv (except for \p --batch), so options given on the command line
+ apply to every experiment and can be overridden on each line.
+ Empty lines and lines starting with utils::COMMENT_SYMBOL are skipped.
+ \param fname path of manifest file
+ \param argc argc from main
+ \param argv argv from main
+ \param experiments Params object for each experiment are added here.
+ \return true if all experiments were successfully parsed.
+ */
+bool IonFinder::readBatchFile(const std::string& fname, int argc, const char* const argv[],
+							  std::vector<IonFinder::Params>& experiments)
+{
+	std::ifstream inF(fname);
+	if(!inF){
+		std::cerr << "\nFailed to read batch file: " << fname << NEW_LINE;
+		return false;
+	}
+
+	//command line arguments shared by all experiments
+	std::vector<std::string> baseArgs;
+	for(int i = 0; i < argc; i++){
+		if(!strcmp(argv[i], "--batch")){
+			i++;
+			continue;
+		}
+		baseArgs.emplace_back(argv[i]);
+	}
+
+	std::string line;
+	size_t lineNum = 0;
+	while(utils::safeGetline(inF, line))
+	{
+		lineNum++;
+		line = utils::trim(line);
+		if(line.empty() || utils::isCommentLine(line)) continue;
+
+		std::vector<std::string> args = baseArgs;
+		std::istringstream ss(line);
+		std::string arg;
+		while(ss >> arg)
+			args.push_back(arg);
+
+		std::vector<const char*> argPtrs;
+		for(const auto& a: args)
+			argPtrs.push_back(a.c_str());
+
+		experiments.emplace_back();
+		if(!experiments.back().getArgs(int(argPtrs.size()), argPtrs.data())){
+			std::cerr << "\nError parsing line " << lineNum << " of batch file: " << fname << NEW_LINE;
+			return false;
+		}
+		if(experiments.back().getPipeline()){
+			std::cerr << "\nERROR: --pipeline can not be used with --batch! Found on line " << lineNum <<
+			" of batch file: " << fname << NEW_LINE;
+			return false;
+		}
+	}
+
+	if(experiments.empty()){
+		std::cerr << "\nNo experiments found in batch file: " << fname << NEW_LINE;
+		return false;
+	}
+	return true;
+}
+
+/**
+ Run each experiment in the batch file given by Params::_batchFile. <br><br>
+ Experiments are searched, analyzed and written one at a time with
+ IonFinder::findFragmentsParallel and IonFinder::analyzeSequences, so only the scans of
+ one experiment are in memory at once. Amino acid masses and FASTA files are kept in
+ a SharedFiles object between experiments, so each sequest.params, smod and FASTA file is only
+ read once, even if it is used by more than one experiment. Each experiment is searched and
+ analyzed with its own options and written to the file given by its Params::makeOfname.
+ \param argc argc from main
+ \param argv argv from main
+ \param pars Params object from command line arguments
+ \return true if all file I/O was successful.
+ */
+bool IonFinder::runBatch(int argc, const char* const argv[], const IonFinder::Params& pars)
+{
+	std::vector<IonFinder::Params> experiments;
+	if(!IonFinder::readBatchFile(pars.getBatchFile(), argc, argv, experiments))
+		return false;
+	size_t const nExperiments = experiments.size();
+
+	IonFinder::SharedFiles sharedFiles;
+	bool allSucess = true;
+	for(size_t e = 0; e < nExperiments; e++)
+	{
+		std::cout << "\nExperiment " << e + 1 << " of " << nExperiments << ":";
+		std::vector<Dtafilter::Scan> scans;
+		if(!IonFinder::readInput(experiments[e], scans))
+			return false;
+
+		//an experiment with no scans is written with only a header
+		std::vector<IonFinder::PeptideStats> peptideStats;
+		if(!scans.empty()){
+			std::vector<PeptideNamespace::Peptide> peptides;
+			peptides.reserve(scans.size());
+			if(!IonFinder::findFragmentsParallel(scans, peptides, experiments[e], &sharedFiles))
+				return false;
+
+			std::cout << "\nAnalyzing peptide sequences...";
+			if(!IonFinder::analyzeSequences(scans, peptides, peptideStats, experiments[e], &sharedFiles))
+				return false;
+			std::cout << "Done!\n";
+		}
+
+		PROFILE_SCOPE("printPeptideStats");
+		if(!IonFinder::printPeptideStats(peptideStats, experiments[e])){
+			std::cerr << "Failed to write peptide stats to " << experiments[e].makeOfname() << NEW_LINE;
+			allSucess = false;
+			continue;
+		}
+		std::cout << "\nResults written to: " << experiments[e].makeOfname() << NEW_LINE;
+	}
+
+	return allSucess;
+}
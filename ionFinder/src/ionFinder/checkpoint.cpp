@@ -0,0 +1,346 @@
+//
+// checkpoint.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <ionFinder/checkpoint.hpp>
+
+template<typename _Tp>
+static void writeValue(std::string& buffer, _Tp value){
+	buffer.append(reinterpret_cast<const char*>(&value), sizeof(_Tp));
+}
+
+static void writeString(std::string& buffer, const std::string& str){
+	writeValue(buffer, uint32_t(str.size()));
+	buffer.append(str);
+}
+
+/**
+ Reads values written with writeValue and writeString from a buffer.
+ Reads past the end of the buffer set _good to false instead of reading.
+ */
+class CheckpointReader{
+private:
+	const char* _data;
+	size_t _size;
+	size_t _pos;
+	bool _good;
+public:
+	CheckpointReader(const char* data, size_t size){
+		_data = data;
+		_size = size;
+		_pos = 0;
+		_good = true;
+	}
+	template<typename _Tp>
+	_Tp read(){
+		_Tp value = _Tp();
+		if(!_good || _size - _pos < sizeof(_Tp)){
+			_good = false;
+			return value;
+		}
+		std::memcpy(&value, _data + _pos, sizeof(_Tp));
+		_pos += sizeof(_Tp);
+		return value;
+	}
+	std::string readString(){
+		uint32_t len = read<uint32_t>();
+		if(!_good || _size - _pos < len){
+			_good = false;
+			return "";
+		}
+		std::string ret(_data + _pos, len);
+		_pos += len;
+		return ret;
+	}
+	bool good() const{
+		return _good;
+	}
+	bool atEnd() const{
+		return _pos == _size;
+	}
+};
+
+/**
+ Hash arguments which affect search results and the precursor file, scan number and
+ sequence of each scan in \p scans.
+ */
+uint64_t IonFinder::Checkpoint::makeKey(const std::vector<Dtafilter::Scan>& scans, const IonFinder::Params& pars)
+{
+	uint64_t key = fnv1a::hash(pars.getCheckpointKey());
+	for(const auto& scan: scans){
+		std::string temp = scan.getPrecursor().getFile() + OUT_DELIM +
+						   std::to_string(scan.getScanNum()) + OUT_DELIM + scan.getSequence() + NEW_LINE;
+		key = fnv1a::hash(temp, key);
+	}
+	return key;
+}
+
+/**
+ Open checkpoint file for \p scans. <br>
+ If \p resume is true and the checkpoint file exists, scans which were finished in the previous
+ run are read and new scans are appended to the file. Otherwise a new file is started.
+ \param scans list of scans to search
+ \param pars Params object
+ \param resume should existing checkpoint be read?
+ \return false if the file could not be opened or if it is from a different analysis.
+ */
+bool IonFinder::Checkpoint::open(const std::vector<Dtafilter::Scan>& scans, const IonFinder::Params& pars, bool resume)
+{
+	uint64_t key = makeKey(scans, pars);
+	_records.clear();
+	_records.resize(scans.size());
+
+	if(resume && utils::fileExists(_fname)){
+		if(!read(key, scans.size()))
+			return false;
+		_outF.open(_fname, std::ios::out | std::ios::binary | std::ios::app);
+	}
+	else{
+		if(resume)
+			std::cout << "\nCheckpoint file " << _fname << " not found. Starting from the beginning." << NEW_LINE;
+		_outF.open(_fname, std::ios::out | std::ios::binary | std::ios::trunc);
+		if(_outF){
+			std::string header(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+			writeValue(header, key);
+			writeValue(header, uint64_t(scans.size()));
+			_outF.write(header.data(), header.size());
+			_outF.flush();
+		}
+	}
+	if(!_outF){
+		std::cerr << "\nFailed to open checkpoint file: " << _fname << NEW_LINE;
+		return false;
+	}
+	_lastWrite = ClockType::now();
+	return true;
+}
+
+/**
+ Read records from existing checkpoint file. <br>
+ Incomplete blocks at the end of the file are truncated so new blocks can be appended.
+ \param key key for current analysis
+ \param nScans number of scans in current analysis
+ \return false if file could not be read or \p key does not match.
+ */
+bool IonFinder::Checkpoint::read(uint64_t key, size_t nScans)
+{
+	std::ifstream inF(_fname, std::ios::in | std::ios::binary);
+	if(!inF){
+		std::cerr << "\nFailed to read checkpoint file: " << _fname << NEW_LINE;
+		return false;
+	}
+	std::string data((std::istreambuf_iterator<char>(inF)), std::istreambuf_iterator<char>());
+	inF.close();
+
+	CheckpointReader header(data.data(), data.size());
+	char magic[sizeof(CHECKPOINT_MAGIC)];
+	for(char& c: magic) c = header.read<char>();
+	uint64_t fileKey = header.read<uint64_t>();
+	uint64_t fileNScans = header.read<uint64_t>();
+	if(!header.good() || std::memcmp(magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0){
+		std::cerr << "\n" << _fname << " is not a valid checkpoint file!" << NEW_LINE;
+		return false;
+	}
+	if(fileKey != key || fileNScans != nScans){
+		std::cerr << "\nCheckpoint file " << _fname << " is from a different input or options!" << NEW_LINE;
+		return false;
+	}
+
+	//read blocks until the end of the file or the first incomplete block
+	size_t pos = sizeof(CHECKPOINT_MAGIC) + 2 * sizeof(uint64_t);
+	while(data.size() - pos >= 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t))
+	{
+		CheckpointReader blockHeader(data.data() + pos, data.size() - pos);
+		uint32_t blockMagic = blockHeader.read<uint32_t>();
+		uint32_t nRecords = blockHeader.read<uint32_t>();
+		uint64_t payloadSize = blockHeader.read<uint64_t>();
+		size_t payloadPos = pos + sizeof(uint32_t) * 2 + sizeof(uint64_t);
+		if(blockMagic != CHECKPOINT_BLOCK_MAGIC ||
+		   data.size() - payloadPos < sizeof(uint64_t) ||
+		   data.size() - payloadPos - sizeof(uint64_t) < payloadSize) break;
+		uint64_t hash;
+		std::memcpy(&hash, data.data() + payloadPos + payloadSize, sizeof(uint64_t));
+		if(hash != fnv1a::hash(data.data() + payloadPos, payloadSize)) break;
+
+		CheckpointReader payload(data.data() + payloadPos, payloadSize);
+		for(uint32_t r = 0; r < nRecords; r++)
+		{
+			uint64_t index = payload.read<uint64_t>();
+			RecordPtr record(new Record());
+			record->precursorMZ = payload.readString();
+			record->precursorScan = payload.readString();
+			record->rt = payload.read<double>();
+			record->charge = payload.read<int32_t>();
+			record->intensity = payload.read<double>();
+			record->nFragments = payload.read<uint32_t>();
+			uint32_t nStored = payload.read<uint32_t>();
+			for(uint32_t f = 0; f < nStored && payload.good(); f++){
+				Fragment fragment;
+				fragment.index = payload.read<uint32_t>();
+				fragment.found = payload.read<uint8_t>() != 0;
+				fragment.mz = payload.read<double>();
+				fragment.intensity = payload.read<double>();
+				record->fragments.push_back(fragment);
+			}
+			if(!payload.good() || index >= nScans){
+				std::cerr << "\nCheckpoint file " << _fname << " is corrupt!" << NEW_LINE;
+				return false;
+			}
+			if(!_records[index]) _nRestored++;
+			_records[index] = std::move(record);
+		}
+		pos = payloadPos + payloadSize + sizeof(uint64_t);
+	}
+
+	//remove incomplete block
+	if(pos < data.size()){
+		if(truncate(_fname.c_str(), off_t(pos)) != 0){
+			std::cerr << "\nFailed to truncate checkpoint file: " << _fname << NEW_LINE;
+			return false;
+		}
+	}
+
+	std::cout << "\nResuming from checkpoint: " << _nRestored << " of " << nScans
+			  << " scans already searched." << NEW_LINE;
+	return true;
+}
+
+/**
+ Write buffered records to the checkpoint file as a single block.
+ The caller must hold _mutex.
+ */
+bool IonFinder::Checkpoint::writeBlock()
+{
+	_lastWrite = ClockType::now();
+	if(_nBuffered == 0) return true;
+
+	std::string header;
+	writeValue(header, CHECKPOINT_BLOCK_MAGIC);
+	writeValue(header, _nBuffered);
+	writeValue(header, uint64_t(_buffer.size()));
+	std::string footer;
+	writeValue(footer, fnv1a::hash(_buffer));
+
+	_outF.write(header.data(), header.size());
+	_outF.write(_buffer.data(), _buffer.size());
+	_outF.write(footer.data(), footer.size());
+	_outF.flush();
+
+	_buffer.clear();
+	_nBuffered = 0;
+	return bool(_outF);
+}
+
+/**
+ Add search results for a completed scan. The scan is written to the checkpoint file
+ with the next block. <br>
+ This function is thread safe.
+ \param index index of scan in input
+ \param scan scan after it was searched
+ \param peptide labeled peptide for \p scan
+ */
+void IonFinder::Checkpoint::add(size_t index, const Dtafilter::Scan& scan, const PeptideNamespace::Peptide& peptide)
+{
+	std::string record;
+	writeValue(record, uint64_t(index));
+	writeString(record, scan.getPrecursor().getMZ());
+	writeString(record, scan.getPrecursor().getScan());
+	writeValue(record, double(scan.getPrecursor().getRT()));
+	writeValue(record, int32_t(scan.getPrecursor().getCharge()));
+	writeValue(record, double(scan.getPrecursor().getIntensity()));
+
+	//only fragments which were labeled are stored
+	size_t nFragments = peptide.getNumFragments();
+	std::string fragments;
+	uint32_t nStored = 0;
+	for(size_t i = 0; i < nFragments; i++){
+		const PeptideNamespace::FragmentIon& fragment = peptide.getFragment(i);
+		if(!fragment.getFound() && fragment.getFoundMZ() == 0 && fragment.getFoundIntensity() == 0)
+			continue;
+		writeValue(fragments, uint32_t(i));
+		writeValue(fragments, uint8_t(fragment.getFound()));
+		writeValue(fragments, fragment.getFoundMZ());
+		writeValue(fragments, fragment.getFoundIntensity());
+		nStored++;
+	}
+	writeValue(record, uint32_t(nFragments));
+	writeValue(record, nStored);
+	record += fragments;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_buffer += record;
+	_nBuffered++;
+	if(std::chrono::duration_cast<std::chrono::seconds>(ClockType::now() - _lastWrite).count() >= _interval){
+		if(!writeBlock())
+			std::cerr << "\nFailed to write checkpoint file: " << _fname << NEW_LINE;
+	}
+}
+
+/**
+ Restore search results for a scan which was finished in the run being resumed. <br>
+ Can be called concurrently for different values of \p index.
+ \param index index of scan in input. isDone(index) must be true.
+ \param scan precursor information is copied into \p scan
+ \param peptide set to the labeled peptide for \p scan
+ \param pars Params object
+ \param aminoAcidMassesMap amino acid masses for each scan, from IonFinder::initAminoAcidMasses
+ \throws std::runtime_error if the fragments of the peptide do not match the checkpoint.
+ */
+void IonFinder::Checkpoint::restore(size_t index, Dtafilter::Scan& scan, PeptideNamespace::Peptide& peptide,
+									const IonFinder::Params& pars, const AminoAcidMassesMap& aminoAcidMassesMap)
+{
+	assert(isDone(index));
+	RecordPtr record = std::move(_records[index]);
+
+	IonFinder::initPeptide(scan, peptide, pars, aminoAcidMassesMap);
+	if(peptide.getNumFragments() != record->nFragments)
+		throw std::runtime_error("Checkpoint for scan " + std::to_string(scan.getScanNum()) +
+								 " in " + scan.getPrecursor().getFile() + " does not match peptide fragments!");
+	for(const auto& fragment: record->fragments){
+		if(fragment.index >= record->nFragments)
+			throw std::runtime_error("Invalid fragment index in checkpoint for scan " + std::to_string(scan.getScanNum()));
+		peptide.setFound(fragment.index, fragment.found);
+		peptide.setFoundMZ(fragment.index, fragment.mz);
+		peptide.setFoundIntensity(fragment.index, fragment.intensity);
+	}
+
+	scan.getPrecursor().setMZ(record->precursorMZ);
+	scan.getPrecursor().setScan(record->precursorScan);
+	scan.getPrecursor().setRT(record->rt);
+	scan.getPrecursor().setCharge(record->charge);
+	scan.getPrecursor().setIntensity(record->intensity);
+}
+
+//! Write all buffered records to the checkpoint file.
+bool IonFinder::Checkpoint::flush()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if(!writeBlock()){
+		std::cerr << "\nFailed to write checkpoint file: " << _fname << NEW_LINE;
+		return false;
+	}
+	return true;
+}
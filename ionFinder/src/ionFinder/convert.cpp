@@ -0,0 +1,140 @@
+//
+// convert.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <ionFinder/convert.hpp>
+
+/**
+ Run convert subcommand.
+ \param argc argc from main, minus program name
+ \param argv argv from main, starting at the subcommand
+ \return exit code for program
+ */
+int IonFinder::convertMsFiles(int argc, const char* const argv[])
+{
+	std::vector<std::string> fnames;
+	unsigned int nThread = 1;
+	bool force = false;
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+		{
+			std::cout << CONVERT_USAGE << NEW_LINE;
+			return 0;
+		}
+		if(!strcmp(argv[i], "--nThread"))
+		{
+			if(!utils::isArg(argv[++i]))
+			{
+				std::cerr << IonFinder::ARG_REQUIRED_STR << argv[i-1] << NEW_LINE << CONVERT_USAGE << NEW_LINE;
+				return 1;
+			}
+			nThread = unsigned(std::max(1, std::stoi(argv[i])));
+			continue;
+		}
+		if(!strcmp(argv[i], "--force"))
+		{
+			force = true;
+			continue;
+		}
+		if(utils::isFlag(argv[i]))
+		{
+			std::cerr << argv[i] << " is an invalid argument." << NEW_LINE << CONVERT_USAGE << NEW_LINE;
+			return 1;
+		}
+		fnames.emplace_back(argv[i]);
+	}
+
+	if(fnames.empty())
+	{
+		std::cerr << "At least one ms file is required!" << NEW_LINE << CONVERT_USAGE << NEW_LINE;
+		return 1;
+	}
+
+	std::cout << "\nConverting " << fnames.size() << " ms file(s)...\n";
+	std::atomic<size_t> nextFile(0);
+	std::atomic<bool> allSuccess(true);
+	std::mutex printMutex;
+	std::vector<std::thread> threads;
+	for(size_t i = 0; i < std::min(size_t(nThread), fnames.size()); i++){
+		threads.emplace_back([&](){
+			for(size_t j = nextFile++; j < fnames.size(); j = nextFile++){
+				bool success = IonFinder::convertMsFile(fnames[j], force);
+				std::lock_guard<std::mutex> lock(printMutex);
+				if(success) std::cout << "\t" << ms2::MsFile::removeGzipExt(fnames[j]) << ms2::PEAK_STORE_EXT << NEW_LINE;
+				else{
+					std::cerr << "\tFailed to convert " << fnames[j] << NEW_LINE;
+					allSuccess = false;
+				}
+			}
+		});
+	}
+	for(auto& thread: threads)
+		thread.join();
+
+	if(!allSuccess)
+	{
+		std::cerr << "Failed to convert ms files!" << NEW_LINE;
+		return 1;
+	}
+	std::cout << "Done!\n";
+	return 0;
+}
+
+/**
+ Write peak store for a single MS file next to \p fname.
+ \param fname Path of MS file. If it is compressed, the store is named after the uncompressed file.
+ \param force Should the store be written if there is already an up to date store for \p fname?
+ \return true if all file I/O was successful.
+ */
+bool IonFinder::convertMsFile(const std::string& fname, bool force)
+{
+	//stores for compressed files are named after the uncompressed file, which is the name used in the input
+	std::string msFname = ms2::MsFile::removeGzipExt(fname);
+	if(!force && !ms2::PeakStore::findStore(msFname).empty())
+		return true;
+
+	std::string path = ms2::MsFile::findFile(msFname);
+	ms2::MsInterface::MsFilePtr file = ms2::MsInterface::makeFile(path);
+	if(!file)
+	{
+		std::cerr << "\nUnknown file type for file " << fname << NEW_LINE;
+		return false;
+	}
+
+	ms2::ScanIndex::FileKey key;
+	try{
+		if(!ms2::ScanIndex::getFileKey(path, key) || !file->read(path, "", ms2::MsFile::ScanNumList()))
+		{
+			std::cerr << "\nNo file found at: " << utils::absPath(fname) << NEW_LINE;
+			return false;
+		}
+	} catch(std::exception& e){
+		std::cerr << NEW_LINE << e.what() << NEW_LINE;
+		return false;
+	}
+	return ms2::PeakStore::write(msFname + ms2::PEAK_STORE_EXT, *file, key);
+}
@@ -26,6 +26,7 @@
 //
 
 #include <ionFinder/datProc.hpp>
+#include <ionFinder/checkpoint.hpp>
 
 //!Copy constructor
 IonFinder::PeptideStats::PeptideStats(const IonFinder::PeptideStats& rhs) {
@@ -41,7 +42,6 @@ IonFinder::PeptideStats::PeptideStats(const IonFinder::PeptideStats& rhs) {
     charge = rhs.charge;
     fullSequence = rhs.fullSequence;
     mass = rhs.mass;
-    _scan = new Dtafilter::Scan;
     _scan = rhs._scan;
 }
 
@@ -278,102 +278,130 @@ double IonFinder::PeptideStats::calcIntCO(double fractionArtifact) const
 }
 
 /**
- * Analyze the fragment ions found in the context of the peptide sequence to determine
- * whether the peptide is likely to be modified.
- *
- * \param scans Populated vector of scans.
- * \param peptides Populated vector of peptides.
- * \param peptideStats Empty vector of peptideStats.
- * \param pars Populated Params object.
+ Look up the modified residues of \p peptide in \p seqFile and store them.
+ Residues already in the map are not looked up again.
+ This function is not thread safe.
+ \param seqFile FASTA file to look up residues in.
+ \param scan Scan which \p peptide was identified from.
+ \param peptide Peptide to add residues for.
+ \param verbose Passed to FastaFile::getModifiedResidue
+ */
+void IonFinder::ModResidueMap::add(utils::FastaFile& seqFile, const Dtafilter::Scan& scan,
+								   const PeptideNamespace::Peptide& peptide, bool verbose)
+{
+	if(!peptide.isModified()) return;
+	std::string const sequence = peptide.getSequence();
+	for(size_t modLoc: peptide.getModLocs())
+	{
+		KeyType key(scan.getParentID(), sequence, int(modLoc));
+		if(_residues.find(key) != _residues.end()) continue;
+		bool found;
+		std::string residue = seqFile.getModifiedResidue(scan.getParentID(), sequence, int(modLoc),
+														 verbose, found);
+		_residues[key] = ValueType(residue, found);
+	}
+}
+
+/**
+ Get a modified residue stored by ModResidueMap::add.
+ \param proteinID Parent protein ID.
+ \param sequence Peptide sequence.
+ \param modLoc Modification location in \p sequence.
+ \param found Set to false if the protein or peptide was not found in the FASTA file.
+ \return Modified residue.
+ \throws std::out_of_range if the residue was never added.
+ */
+std::string IonFinder::ModResidueMap::get(const std::string& proteinID, const std::string& sequence,
+										  int modLoc, bool& found) const
+{
+	const ValueType& residue = _residues.at(KeyType(proteinID, sequence, modLoc));
+	found = residue.second;
+	return residue.first;
+}
+
+/**
+ Classify the fragment ions found for each peptide in \p peptides. <br><br>
+ Analysis is performed in parallel in number of threads in Params::_numThread.
+ Threads take blocks of peptides from a ScanScheduler and write the PeptideStats
+ for each peptide at the same index as the peptide. The results are concatenated in
+ peptide order, so \p peptideStats is in the same order as the single threaded result.
+ Modified residues are looked up in the FASTA file before the threads are started,
+ so the threads only read the lookup table and never lock.
+ \param scans list of scans \p peptides were identified from
+ \param peptides peptides annotated by IonFinder::findFragmentsParallel
+ \param peptideStats empty vector to fill
+ \param pars Params object for information on how to perform analysis
+ \param sharedFiles If not nullptr, the FASTA file is added to and reused from \p sharedFiles.
+ \return true if all file I/O was successful.
  */
 bool IonFinder::analyzeSequences(std::vector<Dtafilter::Scan>& scans,
 								 const std::vector<PeptideNamespace::Peptide>& peptides,
 								 std::vector<PeptideStats>& peptideStats,
-								 const IonFinder::Params& pars)
+								 const IonFinder::Params& pars,
+								 IonFinder::SharedFiles* sharedFiles)
 {
 	bool allSucess = true;
-	bool addModResidues = !pars.getFastaFile().empty();
-	utils::FastaFile seqFile;
-	int nSeqNotFound = 0;
-	if(addModResidues){
-		std::cout << "\nReading FASTA file...";
-		if(!seqFile.read(pars.getFastaFile())) return false;
-		std::cout << "Done!" << NEW_LINE;
+	size_t const nPeptides = peptides.size();
+
+	//look up modified residues before starting threads
+	ModResidueFunction modResidue;
+	ModResidueMap modResidues;
+	if(!pars.getFastaFile().empty()){
+		utils::FastaFile localSeqFile;
+		bool isRead = sharedFiles != nullptr && sharedFiles->fastaFiles.count(pars.getFastaFile()) > 0;
+		utils::FastaFile& seqFile = sharedFiles == nullptr ? localSeqFile :
+									sharedFiles->fastaFiles[pars.getFastaFile()];
+		if(!isRead){
+			std::cout << "\nReading FASTA file...";
+			if(!seqFile.read(pars.getFastaFile())) return false;
+			std::cout << "Done!" << NEW_LINE;
+		}
+		PROFILE_SCOPE("FastaFile::getModifiedResidue");
+		for(size_t i = 0; i < nPeptides; i++)
+			modResidues.add(seqFile, scans[i], peptides[i], pars.getVerbose());
+		modResidue = [&modResidues](const std::string& proteinID, const std::string& sequence,
+									int modLoc, bool& found){
+			return modResidues.get(proteinID, sequence, modLoc, found);
+		};
 	}
 
-	for(auto it = peptides.begin(); it != peptides.end(); ++it)
-	{
-		std::vector<IonFinder::PeptideStats> this_stats;
-
-		std::vector<size_t> modLocsTemp;
-		if(it->isModified())
-			modLocsTemp = it->getModLocs();
-		else modLocsTemp.push_back(std::string::npos);
-
-        for(auto mod_it = modLocsTemp.begin(); mod_it != modLocsTemp.end(); ++mod_it)
+	size_t nThread = std::min(size_t(pars.getNumThreads()), nPeptides);
+	if(nThread == 0) nThread = 1;
+
+	std::vector<std::vector<PeptideStats> > stats(nPeptides);
+	std::vector<int> nSeqNotFound(nThread, 0);
+	IonFinder::ScanScheduler scheduler(0, nPeptides, nThread);
+	auto analyze = [&](size_t threadIndex){
+		if(threadIndex > 0)
+			PROFILE_THREAD_NAME("analyze " + std::to_string(threadIndex));
+		PROFILE_SCOPE("analyzeSequences");
+		for(size_t i = 0, end = 0; i < end || scheduler.next(i, end); i++)
 		{
-            // initialize new pepStat object
-            this_stats.emplace_back(*it);
-            // this_stats.push_back(IonFinder::PeptideStats(
-            this_stats.back()._scan = &scans[it - peptides.begin()]; //add pointer to scan
-            size_t nFragments = it->getNumFragments();
-            this_stats.back().modIndex = *mod_it;
-
-            // iterate through ion fragments
-            for (size_t i = 0; i < nFragments; i++) {
-                //skip if not found
-                if (it->getFragment(i).getFound()) {
-                    this_stats.back().addSeq(it->getFragment(i), *mod_it, pars.getAmbigiousResidues());
-                } //end of if
-            }//end of for i
-
-            // if(it->getFullSequence() == "LEYQWTNNIGDAHTIGTR*PDNGMLSLGVSYR")
-            // if(this_stats.back()._scan->getScanNum() == 23248)
-            //     std::cout << "Found" << std::endl;
-
-            // Filter to remove Artifact ions
-            double int_co = this_stats.back().calcIntCO(pars.getArtifactNLIntFrac());
-            this_stats.back().removeBelowIntensity(int_co);
-
-            this_stats.back().calcContainsCit(pars.getIncludeCTermMod());
-
-            if(addModResidues && *mod_it != std::string::npos) {
-                bool found; //set to true if peptide and protein sequences are found in FastaFile
-                std::string modTemp = seqFile.getModifiedResidue(this_stats.back()._scan->getParentID(),
-                                                                 this_stats.back().sequence, int(*mod_it),
-                                                                 pars.getVerbose(), found);
-                this_stats.back().addMod(modTemp);
-                if (!found)
-                    nSeqNotFound++;
-            }
-        }//end for mod_it
+			IonFinder::analyzeSequence(scans[i], peptides[i], stats[i], pars,
+									   modResidue, nSeqNotFound[threadIndex]);
+		}
+	};
 
-        assert(pars.getGroupMod() == 0 || pars.getGroupMod() == 1);
-        if(pars.getGroupMod() == 0)
-        {
-            PeptideStats::ContainsCitType cc = PeptideStats::ContainsCitType::TRUE;
-            for (const auto &s:this_stats) {
-                cc = std::min(cc, s.thisContainsCit);
-            }
+	//the calling thread is the first analysis thread
+	std::vector<std::thread> threads;
+	for(size_t t = 1; t < nThread; t++)
+		threads.emplace_back(analyze, t);
+	analyze(0);
+	for(auto& thread: threads)
+		thread.join();
 
-            for(auto & this_stat : this_stats) {
-                this_stat.containsCit = cc;
-                peptideStats.push_back(this_stat);
-            }
-        }
-        else {
-            for(auto s = this_stats.begin(); s != this_stats.end(); ++s){
-                if(s == this_stats.begin()) {
-                    peptideStats.push_back(*s);
-                    peptideStats.back().containsCit = s->thisContainsCit;
-                }
-                else peptideStats.back().consolidate(*s);
-            }
-        }
-		
-	}//end if for it
-	if(nSeqNotFound > 0){
-		std::cerr << NEW_LINE << nSeqNotFound << " protein sequences not found in " <<
+	//concat stats for each peptide into one vector
+	for(auto& s: stats){
+		peptideStats.insert(peptideStats.end(),
+							std::make_move_iterator(s.begin()),
+							std::make_move_iterator(s.end()));
+		s.clear();
+	}
+	int nSeqNotFoundTotal = 0;
+	for(size_t t = 0; t < nThread; t++)
+		nSeqNotFoundTotal += nSeqNotFound[t];
+	if(nSeqNotFoundTotal > 0){
+		std::cerr << NEW_LINE << nSeqNotFoundTotal << " protein sequences not found in " <<
 		pars.getFastaFile() << NEW_LINE;
 	}
 
@@ -381,12 +409,90 @@ bool IonFinder::analyzeSequences(std::vector<Dtafilter::Scan>& scans,
 }//end of fxn
 
 /**
- * Print total intensities for each fragment to \p fname. (Mainly for debugging)
- * \param stats Populated list of PeptideStats.
- * \param fname File path.
- * \param id Optional id for last column.
- * \return true if all file I/O was successful.
+ Classify the fragment ions found for a single peptide and append the
+ results to \p peptideStats.
+ \param scan Scan which \p peptide was identified from.
+ A pointer to \p scan is stored in each PeptideStats object.
+ \param peptide Peptide annotated by IonFinder::findFragments_scan
+ \param peptideStats PeptideStats for \p peptide are appended here.
+ \param pars Params object for information on how to perform analysis
+ \param modResidue Function to lookup modified residues. Empty if no lookup should be done.
+ \param nSeqNotFound incremented for each protein sequence not found by \p modResidue
  */
+void IonFinder::analyzeSequence(Dtafilter::Scan& scan,
+								const PeptideNamespace::Peptide& peptide,
+								std::vector<PeptideStats>& peptideStats,
+								const IonFinder::Params& pars,
+								const ModResidueFunction& modResidue, int& nSeqNotFound)
+{
+	std::vector<IonFinder::PeptideStats> this_stats;
+
+	std::vector<size_t> modLocsTemp;
+	if(peptide.isModified())
+		modLocsTemp = peptide.getModLocs();
+	else modLocsTemp.push_back(std::string::npos);
+
+    for(auto mod_it = modLocsTemp.begin(); mod_it != modLocsTemp.end(); ++mod_it)
+	{
+        // initialize new pepStat object
+        this_stats.emplace_back(peptide);
+        // this_stats.push_back(IonFinder::PeptideStats(
+        this_stats.back()._scan = &scan; //add pointer to scan
+        size_t nFragments = peptide.getNumFragments();
+        this_stats.back().modIndex = *mod_it;
+
+        // iterate through ion fragments
+        for (size_t i = 0; i < nFragments; i++) {
+            //skip if not found
+            if (peptide.getFragment(i).getFound()) {
+                this_stats.back().addSeq(peptide.getFragment(i), *mod_it, pars.getAmbigiousResidues());
+            } //end of if
+        }//end of for i
+
+        // if(peptide.getFullSequence() == "LEYQWTNNIGDAHTIGTR*PDNGMLSLGVSYR")
+        // if(this_stats.back()._scan->getScanNum() == 23248)
+        //     std::cout << "Found" << std::endl;
+
+        // Filter to remove Artifact ions
+        double int_co = this_stats.back().calcIntCO(pars.getArtifactNLIntFrac());
+        this_stats.back().removeBelowIntensity(int_co);
+
+        this_stats.back().calcContainsCit(pars.getIncludeCTermMod());
+
+        if(modResidue && *mod_it != std::string::npos) {
+            bool found; //set to true if peptide and protein sequences are found in FastaFile
+            std::string modTemp = modResidue(this_stats.back()._scan->getParentID(),
+                                             this_stats.back().sequence, int(*mod_it), found);
+            this_stats.back().addMod(modTemp);
+            if (!found)
+                nSeqNotFound++;
+        }
+    }//end for mod_it
+
+    assert(pars.getGroupMod() == 0 || pars.getGroupMod() == 1);
+    if(pars.getGroupMod() == 0)
+    {
+        PeptideStats::ContainsCitType cc = PeptideStats::ContainsCitType::TRUE;
+        for (const auto &s:this_stats) {
+            cc = std::min(cc, s.thisContainsCit);
+        }
+
+        for(auto & this_stat : this_stats) {
+            this_stat.containsCit = cc;
+            peptideStats.push_back(this_stat);
+        }
+    }
+    else {
+        for(auto s = this_stats.begin(); s != this_stats.end(); ++s){
+            if(s == this_stats.begin()) {
+                peptideStats.push_back(*s);
+                peptideStats.back().containsCit = s->thisContainsCit;
+            }
+            else peptideStats.back().consolidate(*s);
+        }
+    }
+}
+
 bool IonFinder::printFragmentIntensities(const std::vector<PeptideStats>& stats,
                                          std::string fname, std::string id)
 {
@@ -406,120 +512,134 @@ bool IonFinder::printFragmentIntensities(const std::vector<PeptideStats>& stats,
     return true;
 }
 
+/**
+ Get the next block of scan indices to process.
+ \param beg set to the first index in the block
+ \param end set to one past the last index in the block
+ \return false if there are no scans left.
+ */
+bool IonFinder::ScanScheduler::next(size_t& beg, size_t& end)
+{
+	size_t cur = _next.load();
+	size_t chunk;
+	do{
+		if(cur >= _end || _stopped) return false;
+		chunk = (_end - cur) / (2 * _nThread);
+		if(chunk < _minChunk) chunk = _minChunk;
+		if(chunk > _end - cur) chunk = _end - cur;
+	} while(!_next.compare_exchange_weak(cur, cur + chunk));
+
+	beg = cur;
+	end = cur + chunk;
+	return true;
+}
+
 /**
  Search parent ms2 files in \p scans for predicted fragment ions. <br><br>
  Analysis is performed in parallel in number of threads in Params::_numThread. <br>
- \p scans is split up evenly across each thread.
+ Threads request blocks of \p scans from a shared ScanScheduler as they finish
+ their previous block, so uneven scans do not leave threads idle. <br>
+ ms files are read concurrently in the background with MsInterface::ingest, and scans
+ are processed grouped by file and in order of scan number. Unless Params::_prefetchDepth is 0,
+ the next scans for each thread are retrieved by a ms2::ScanPrefetcher while the current scan is searched. <br>
+ Amino acid masses are read before the threads are started, and shared by all threads.
  
  \param scans populated list of identified ms2 scans to search for
  \param peptides empty list of peptides to annotate
  \param pars Params object for information on how to perform analysis
+ \param sharedFiles If not nullptr, amino acid masses are added to and reused from \p sharedFiles.
  \return true is all file I/O was successful.
  */
 bool IonFinder::findFragmentsParallel(std::vector<Dtafilter::Scan>& scans,
 									  std::vector<PeptideNamespace::Peptide>& peptides,
-									  const IonFinder::Params& pars)
+									  const IonFinder::Params& pars,
+									  IonFinder::SharedFiles* sharedFiles)
 {
+	PROFILE_SCOPE("findFragmentsParallel");
 	unsigned int const nThread = pars.getNumThreads();
 	size_t const nScans = scans.size();
-	size_t peptidePerThread = nScans / nThread;
-	if(nScans % nThread != 0)
-		peptidePerThread += 1;
-	std::atomic<size_t> scansIndex(0); //used to update progress for findFragmentsProgress
-	
 	if(nScans == 0){
 		std::cout << "No scans in input!\n";
 		return false;
 	}
 	
-	//init threads
-	std::vector<std::thread> threads;
-	bool* sucsses = new bool[nThread];
+	//read scans finished before the last run was stopped
+	std::unique_ptr<IonFinder::Checkpoint> checkpoint;
+	if(!pars.getCheckpointFile().empty()){
+		checkpoint.reset(new IonFinder::Checkpoint(pars.getCheckpointFile(), pars.getCheckpointInterval()));
+		if(!checkpoint->open(scans, pars, pars.getResume()))
+			return false;
+	}
 
-    // read ms files
+	IonFinder::AminoAcidMassesMap localAminoAcidMasses;
+	IonFinder::AminoAcidMassesMap& aminoAcidMasses = sharedFiles == nullptr ?
+		localAminoAcidMasses : sharedFiles->aminoAcidMasses;
+	if(!IonFinder::initAminoAcidMasses(scans.begin(), scans.end(), pars, aminoAcidMasses))
+		return false;
+
+    // start reading ms files. Files with only finished scans are not read.
     ms2::MsInterface msInterface;
-    // msInterface.read(scans.begin(), scans.end());
+    msInterface.setScanIndex(pars.getUseScanIndex(), pars.getScanIndexDir());
+    msInterface.setMaxMemory(pars.getMaxMemory());
+    if(checkpoint && checkpoint->getNRestored() > 0){
+        std::vector<Dtafilter::Scan> unfinished;
+        for(size_t i = 0; i < nScans; i++)
+            if(!checkpoint->isDone(i)) unfinished.push_back(scans[i]);
+        if(!msInterface.ingest(unfinished.begin(), unfinished.end(), nThread))
+            return false;
+    }
+    else if(!msInterface.ingest(scans.begin(), scans.end(), nThread))
+        return false;
+    std::vector<size_t> scanOrder;
+    ms2::MsInterface::groupScansByFile(scans.begin(), scans.end(), scanOrder);
 
-	//split up input data for each thread
-	auto* splitPeptides = new std::vector<PeptideNamespace::Peptide>[nThread];
-	size_t begNum, endNum ;
-	unsigned int threadIndex = 0;
-	for(size_t i = 0; i < nScans; i += peptidePerThread)
+	//each thread writes its peptides at the same index as the corresponding scan
+	peptides.clear();
+	peptides.resize(nScans);
+	IonFinder::ScanScheduler scheduler(0, nScans, nThread);
+	IonFinder::Metrics metrics("search", nScans, nThread, pars,
+							   sharedFiles != nullptr && sharedFiles->nSearched++ > 0);
+	metrics.setBytesRead([&msInterface](){ return msInterface.getBytesRead(); });
+	std::unique_ptr<ms2::ScanPrefetcher> prefetcher;
+	if(pars.getPrefetchDepth() > 0)
+		prefetcher.reset(new ms2::ScanPrefetcher(msInterface, nThread, pars.getPrefetchDepth()));
+
+	//init threads
+	std::vector<std::thread> threads;
+	std::unique_ptr<bool[]> sucsses(new bool[nThread]);
+	for(unsigned int threadIndex = 0; threadIndex < nThread; threadIndex++)
 	{
-		begNum = i;
-		endNum = (begNum + peptidePerThread > nScans ? nScans : begNum + peptidePerThread);
-
-		//spawn thread
-		assert(threadIndex < nThread);
-		splitPeptides[threadIndex] = std::vector<PeptideNamespace::Peptide>();
-		// threads.emplace_back(IonFinder::findFragments_, std::ref(scans), begNum, endNum,
-		//						  std::ref(splitPeptides[threadIndex]), std::ref(pars),
-		//						  sucsses + threadIndex, std::ref(scansIndex));
-		threads.emplace_back(IonFinder::findFragments_threadSafe, std::ref(scans), begNum, endNum,
-									  std::ref(msInterface),
-									  std::ref(splitPeptides[threadIndex]), std::ref(pars),
-									  sucsses + threadIndex, std::ref(scansIndex));
-		threadIndex++;
+		threads.emplace_back(IonFinder::findFragments_threadSafe, std::ref(scans), std::ref(scheduler),
+									  std::cref(scanOrder), std::ref(msInterface),
+									  std::ref(peptides), std::ref(pars), std::cref(aminoAcidMasses),
+									  sucsses.get() + threadIndex, std::ref(metrics), threadIndex, checkpoint.get(),
+									  prefetcher.get());
 	}
 
-	//spawn progress function
+	//spawn progress and metrics monitor
+	std::thread monitor;
     std::string progress_messge = "\nSearching ms2s for fragment ions using " + std::to_string(nThread) + " thread(s)...";
-	if(!pars.getVerbose())
-		threads.emplace_back(IonFinder::findFragmentsProgress, std::ref(scansIndex), nScans,
-									  std::ref(progress_messge), PROGRESS_SLEEP_TIME);
+	if(!pars.getVerbose() || metrics.getWriteMetrics())
+		monitor = std::thread(&IonFinder::Metrics::monitor, &metrics, progress_messge, !pars.getVerbose(),
+							  PROGRESS_SLEEP_TIME);
 
 	//join threads
 	for(auto & thread : threads){
 		thread.join();
 	 }
+	metrics.stop();
+	if(monitor.joinable())
+		monitor.join();
 
-	//concat split peptides into one vector
-	peptides.clear();
+	bool ret = true;
+	if(checkpoint && !checkpoint->flush())
+		ret = false;
 	for(unsigned int i = 0; i < nThread; i++){
 		if(!sucsses[i])
-			return false;
-		peptides.insert(peptides.end(), splitPeptides[i].begin(), splitPeptides[i].end());
+			ret = false;
 	}
 
-	delete [] splitPeptides;
-	delete [] sucsses;
-	return true;
-}
-
-/**
- Prints progress bar during findFragmentsParallel. <br>
- \p scansIndex is updated concurrently by each thread.
- \param scansIndex number of scans completed
- \param count total number of scans to search for
- \param sleepTime time before next update is printed (in seconds)
- */
-void IonFinder::findFragmentsProgress(std::atomic<size_t>& scansIndex, size_t count,
-									  const std::string& message, int sleepTime)
-{
-	size_t lastIndex = scansIndex.load();
-	size_t curIndex = lastIndex;
-	int noChangeIterations = 0;
-
-	std::cout << message << NEW_LINE;
-	while(scansIndex < count)
-	{
-		curIndex = scansIndex.load();
-
-		if(lastIndex == curIndex)
-			noChangeIterations++;
-		else noChangeIterations = 0;
-
-		if(noChangeIterations > IonFinder::MAX_PROGRESS_ITTERATIONS)
-			throw std::runtime_error("Thread timeout!");
-
-		utils::printProgress(float(curIndex) / float(count));
-		std::this_thread::sleep_for(std::chrono::seconds(sleepTime));
-
-		lastIndex = curIndex;
-	}
-	utils::printProgress(float(scansIndex.load()) / float(count));
-	std::cout << NEW_LINE;
-	std::cout << "Done!" << NEW_LINE;
+	return ret;
 }
 
 /**
@@ -553,123 +673,315 @@ void IonFinder::findFragments_(std::vector<Dtafilter::Scan>& scans,
 {
     // read ms files
     ms2::MsInterface msInterface;
+    msInterface.setScanIndex(pars.getUseScanIndex(), pars.getScanIndexDir());
+    msInterface.setMaxMemory(pars.getMaxMemory());
     msInterface.read(scans.begin() + beg, scans.begin() + end);
 
-    IonFinder::findFragments_threadSafe(scans, beg, end, msInterface,
-                                        peptides, pars, success, scansIndex);
+    IonFinder::AminoAcidMassesMap aminoAcidMasses;
+    if(!IonFinder::initAminoAcidMasses(scans.begin() + beg, scans.begin() + end, pars, aminoAcidMasses)) {
+        *success = false;
+        return;
+    }
+
+    if(peptides.size() < end)
+        peptides.resize(end);
+    std::vector<size_t> scanOrder;
+    ms2::MsInterface::groupScansByFile(scans.begin() + beg, scans.begin() + end, scanOrder);
+    for(auto& i: scanOrder) i += beg;
+    IonFinder::ScanScheduler scheduler(0, scanOrder.size(), 1);
+    IonFinder::Metrics metrics("search", scanOrder.size(), 1, pars);
+    IonFinder::findFragments_threadSafe(scans, scheduler, scanOrder, msInterface,
+                                        peptides, pars, aminoAcidMasses, success, metrics, 0);
+    scansIndex += metrics.getDone();
 }
 
 /**
  Find peptide fragment ions in ms2 files. <br>
  Function should not be called directly.
- Use IonFinder::findFragments or IonFinder::findFragmentsParallel instead.
- \param peptides empty vector of peptides to be filled from data in scans.
- \param beg index of beginning of scan vector
- \param end index of end of scan vector
+ Use IonFinder::findFragments or IonFinder::findFragmentsParallel instead. <br>
+ Blocks of scans are requested from \p scheduler until none are left.
+ \param scheduler hands out blocks of positions in \p scanOrder to search.
+ \param scanOrder indices in \p scans in the order they should be searched.
+ \param peptides vector of peptides with the same size as \p scans.
+ The peptide for scans[i] is written to peptides[i].
  \param pars IonFinder params object.
+ \param aminoAcidMassesMap amino acid masses for every scan in \p scans, from IonFinder::initAminoAcidMasses.
+ It is only read, so one map can be shared by all threads.
  \param success set to true if function was successful
+ \param metrics counters for each labeled spectrum are updated here.
+ \param threadIndex index of calling thread in \p metrics.
+ \param checkpoint If not nullptr, finished scans are restored from \p checkpoint instead of
+ being searched, and newly searched scans are added to it.
+ \param prefetcher If not nullptr, the next scans in each block are retrieved by \p prefetcher
+ while the current scan is searched.
+ If an error occurs, it is printed to std::cerr, \p scheduler is stopped so other threads
+ stop searching, and \p success is left false.
  */
 void IonFinder::findFragments_threadSafe(std::vector<Dtafilter::Scan>& scans,
-										 const size_t beg, const size_t end,
+										 IonFinder::ScanScheduler& scheduler,
+										 const std::vector<size_t>& scanOrder,
                                          ms2::MsInterface& msInterface,
 										 std::vector<PeptideNamespace::Peptide>& peptides,
 										 const IonFinder::Params& pars,
-										 bool* success, std::atomic<size_t>& scansIndex)
+										 const IonFinder::AminoAcidMassesMap& aminoAcidMassesMap,
+										 bool* success, IonFinder::Metrics& metrics,
+										 unsigned int threadIndex,
+										 IonFinder::Checkpoint* checkpoint,
+										 ms2::ScanPrefetcher* prefetcher)
 {
 	*success = false;
-	std::string curSample;
-	std::string curWD;
-	std::string spFname;
-	aaDB::AADB aminoAcidMasses;
-	bool aaDBInit = false;
+	PROFILE_THREAD_NAME("search " + std::to_string(threadIndex));
 	ms2::Spectrum spectrum;
+	try{
+		std::unique_ptr<ms2::ScanPrefetcher::Queue> prefetched;
+		if(prefetcher != nullptr)
+			prefetched.reset(new ms2::ScanPrefetcher::Queue(*prefetcher));
+
+		//get the next block of scans from scheduler when the current block is finished
+		for(size_t pos = 0, end = 0, ahead = 0;
+			!scheduler.getStopped() && (pos < end || scheduler.next(pos, end)); pos++)
+		{
+			//request the next scans in the block while the current scan is searched
+			if(prefetched){
+				for(ahead = std::max(ahead, pos); ahead < end && !prefetched->full(); ahead++){
+					size_t const j = scanOrder[ahead];
+					if(checkpoint == nullptr || !checkpoint->isDone(j))
+						prefetched->push(scans[j].getPrecursor().getFile(), scans[j].getScanNum());
+				}
+			}
+
+			size_t const i = scanOrder[pos];
+			if(checkpoint != nullptr && checkpoint->isDone(i))
+				checkpoint->restore(i, scans[i], peptides[i], pars, aminoAcidMassesMap);
+			else{
+				if(prefetched){
+					bool found = false;
+					ms2::Spectrum& prefetchedSpectrum = prefetched->front(found);
+					if(!found) throw IonFinder::scanNotFoundError(scans[i]);
+					IonFinder::findFragments_spectrum(scans[i], peptides[i], pars,
+													  aminoAcidMassesMap, prefetchedSpectrum);
+					prefetched->pop();
+				}
+				else IonFinder::findFragments_scan(scans[i], peptides[i], msInterface, pars,
+												   aminoAcidMassesMap, spectrum);
+				metrics.addSpectrum(threadIndex, peptides[i]);
+				if(checkpoint != nullptr)
+					checkpoint->add(i, scans[i], peptides[i]);
+			}
+			//id follows the input order regardless of which thread searched the scan
+			peptides[i].setID(scans[i].getInputIndex() + 1);
+			metrics.addDone();
+		} //end of for
+	} catch(std::exception& e){
+		std::cerr << NEW_LINE << e.what() << NEW_LINE;
+		scheduler.stop();
+		return;
+	}
 
-	for(size_t i = beg; i < end; i++)
+	*success = true;
+}
+
+/**
+ Get the key in an AminoAcidMassesMap of the amino acid masses used to search \p scan. <br>
+ Amino acid masses come from sequest.params in the directory of the ms file in dtafilter mode,
+ and from the smod file and modification mass otherwise.
+ \param scan scan to search
+ \param pars IonFinder params object.
+ \return key of amino acid masses.
+ */
+std::string IonFinder::aminoAcidMassesKey(const Dtafilter::Scan& scan, const IonFinder::Params& pars)
+{
+	if(pars.getInputMode() == DTAFILTER_INPUT_STR)
+		return utils::dirName(scan.getPrecursor().getFile()) + "/sequest.params";
+	return (pars.getSmodFileSpecified() ? pars.getSmodFileLoc() : "") + ";" + std::to_string(pars.getModMass());
+}
+
+/**
+ Get the amino acid masses used to search \p scan, reading them and adding them to
+ \p aminoAcidMassesMap if they are not already there. <br>
+ This function is not thread safe.
+ \param scan scan to search
+ \param pars IonFinder params object.
+ \param aminoAcidMassesMap amino acid masses which have already been read.
+ \return amino acid masses for \p scan
+ \throws std::runtime_error if the sequest.params or smod file can not be read.
+ */
+const aaDB::AADB& IonFinder::addAminoAcidMasses(const Dtafilter::Scan& scan, const IonFinder::Params& pars,
+												IonFinder::AminoAcidMassesMap& aminoAcidMassesMap)
+{
+	std::string aaKey = IonFinder::aminoAcidMassesKey(scan, pars);
+	auto aaIt = aminoAcidMassesMap.find(aaKey);
+	if(aaIt != aminoAcidMassesMap.end())
+		return aaIt->second;
+
+	aaDB::AADB aadb;
+	if(pars.getInputMode() == DTAFILTER_INPUT_STR)
+		PeptideNamespace::initAminoAcidsMasses(pars, aaKey, aadb);
+	else {
+		PeptideNamespace::initAminoAcidsMasses(pars, aadb);
+		if(!pars.getSmodFileSpecified() && pars.getModMass() != 0)
+			aadb.addMod(aaDB::AminoAcid(std::string(1, constants::MOD_CHAR), pars.getModMass()));
+	}
+	return aminoAcidMassesMap.emplace(aaKey, aadb).first->second;
+}
+
+/**
+ Read the amino acid masses used to search each scan from \p begin to \p end into \p aminoAcidMassesMap. <br>
+ Should be called before search threads are started, so the threads only read \p aminoAcidMassesMap
+ and can share it without a lock. Each sequest.params or smod file is only read once.
+ \param begin first scan
+ \param end one past the last scan
+ \param pars IonFinder params object.
+ \param aminoAcidMassesMap Map to add amino acid masses to.
+ \return false if a sequest.params or smod file could not be read.
+ */
+bool IonFinder::initAminoAcidMasses(std::vector<Dtafilter::Scan>::const_iterator begin,
+									std::vector<Dtafilter::Scan>::const_iterator end,
+									const IonFinder::Params& pars,
+									IonFinder::AminoAcidMassesMap& aminoAcidMassesMap)
+{
+	PROFILE_SCOPE("initAminoAcidMasses");
+	try{
+		for(auto it = begin; it != end; ++it)
+			IonFinder::addAminoAcidMasses(*it, pars, aminoAcidMassesMap);
+	} catch(std::exception& e){
+		std::cerr << NEW_LINE << e.what() << NEW_LINE;
+		return false;
+	}
+	return true;
+}
+
+/**
+ Calculate the fragments for the peptide identified in \p scan.
+ \param scan scan with peptide sequence
+ \param peptide set to the peptide for \p scan with all fragments, but nothing labeled.
+ \param pars IonFinder params object.
+ \param aminoAcidMassesMap amino acid masses for \p scan, from IonFinder::initAminoAcidMasses.
+ \throws std::runtime_error if the amino acid masses for \p scan are not in \p aminoAcidMassesMap.
+ */
+void IonFinder::initPeptide(const Dtafilter::Scan& scan,
+							PeptideNamespace::Peptide& peptide,
+							const IonFinder::Params& pars,
+							const IonFinder::AminoAcidMassesMap& aminoAcidMassesMap)
+{
+	auto aaIt = aminoAcidMassesMap.find(IonFinder::aminoAcidMassesKey(scan, pars));
+	if(aaIt == aminoAcidMassesMap.end())
+		throw std::runtime_error("Amino acid masses were not read for scan " + std::to_string(scan.getScanNum()) +
+								 " in " + scan.getPrecursor().getFile());
+	
+	//initialize peptide object for current scan
 	{
-		if((pars.getInputMode() == DTAFILTER_INPUT_STR && curSample != scans[i].getSampleName()) || !aaDBInit)
-		{
-			//re-init Peptide::AminoAcidMasses for each sample
-			curWD = utils::dirName(scans[i].getPrecursor().getFile());
-			spFname = curWD + "/sequest.params";
-			
-			//read sequest params file and init aadb
-			aminoAcidMasses.clear();
-			if(pars.getInputMode() == DTAFILTER_INPUT_STR)
-                PeptideNamespace::initAminoAcidsMasses(pars, spFname, aminoAcidMasses);
-			else {
-                PeptideNamespace::initAminoAcidsMasses(pars, aminoAcidMasses);
-                if(!pars.getSmodFileSpecified() && pars.getModMass() != 0)
-                    aminoAcidMasses.addMod(aaDB::AminoAcid(std::string(1, constants::MOD_CHAR), pars.getModMass()));
-            }
-		}//end if
-		curSample = scans[i].getSampleName();
-		
-		//initialize peptide object for current scan
-		peptides.emplace_back(scans[i].getSequence());
-		peptides.back().initialize(pars, aminoAcidMasses);
-		
+		PROFILE_SCOPE("Peptide::initialize");
+		peptide = PeptideNamespace::Peptide(scan.getSequence());
+		peptide.initialize(pars, aaIt->second);
+
 		//add neutral loss fragments to current peptide
 		if(pars.getCalcNL()){
-			peptides.back().addNeutralLoss(pars.getNeutralLossMass(), pars.getLabelArtifactNL());
+			peptide.addNeutralLoss(pars.getNeutralLossMass(), pars.getLabelArtifactNL());
 		}
-        
-        // std::cout << scans[i].getPrecursor().getFile() << " -> " << scans[i].getScanNum() << NEW_LINE;
-        // peptides.back().printFragments(std::cout, false);
+	}
+}
 
+/**
+ Calculate the fragments for the peptide identified in \p scan and search its ms2 spectrum for them.
+ \param scan scan to search. Precursor information from the ms2 file is copied into \p scan.
+ \param peptide set to the annotated peptide for \p scan
+ \param msInterface MsInterface to retrieve spectrum from
+ \param pars IonFinder params object.
+ \param aminoAcidMassesMap amino acid masses for \p scan, from IonFinder::initAminoAcidMasses.
+ \param spectrum Spectrum object to reuse as a buffer.
+ */
+void IonFinder::findFragments_scan(Dtafilter::Scan& scan,
+								   PeptideNamespace::Peptide& peptide,
+								   ms2::MsInterface& msInterface,
+								   const IonFinder::Params& pars,
+								   const IonFinder::AminoAcidMassesMap& aminoAcidMassesMap,
+								   ms2::Spectrum& spectrum)
+{
+	{
+		PROFILE_SCOPE("MsInterface::getScan");
 		if(!msInterface.getScan(spectrum,
-                                scans[i].getPrecursor().getFile(),
-                                scans[i].getScanNum()))
-            throw std::runtime_error("Failed to retrieve scan " +
-                                     std::to_string(scans[i].getScanNum()) + " from file " +
-                                     scans[i].getPrecursor().getFile());
-
-        spectrum.setScanData(&scans[i]);
-
-        //set all precursor info except file
-        scans[i].getPrecursor().setMZ(spectrum.getPrecursor().getMZ());
-        scans[i].getPrecursor().setScan(spectrum.getPrecursor().getScan());
-        scans[i].getPrecursor().setRT(spectrum.getPrecursor().getRT());
-        scans[i].getPrecursor().setCharge(spectrum.getPrecursor().getCharge());
-        scans[i].getPrecursor().setIntensity(spectrum.getPrecursor().getIntensity());
-
-        //remove ions below specified intensity
-        spectrum.normalizeIonInts(100);
-        if(pars.getMinIntensitySpecified())
-            spectrum.removeIntensityBelow(pars.getMinIntensity());
-		// spectrum.labelSpectrum(peptides.back(), pars, true); //removes unlabeled ions from peptide
-
-        // label spectrum
-        spectrum.labelSpectrum(peptides.back(), pars);
-
-        //Filter ion intensities
-        if(pars.getMinLabelIntensity() > 0)
-            peptides.back().removeLabelIntensityBelow(pars.getMinLabelIntensity(), false, false);
-        if(pars.getNlIntCo() > 0)
-            peptides.back().removeLabelIntensityBelow(pars.getNlIntCo(), true, false);
-
-		//print spectra file
-		if(pars.getPrintSpectraFiles())
-		{
-			std::string dirNameTemp = (pars.getInDirSpecified() ? pars.getWD() : curWD) + "/spectraFiles";
-			if(!utils::dirExists(dirNameTemp))
-				if(!utils::mkdir(dirNameTemp.c_str(), "-p")){
-					throw std::runtime_error("\nFailed to make dir: " + dirNameTemp);
-				}
+								scan.getPrecursor().getFile(),
+								scan.getScanNum()))
+			throw IonFinder::scanNotFoundError(scan);
+	}
 
-			//spectrum.normalizeIonInts(100);
-			spectrum.calcLabelPos();
+	IonFinder::findFragments_spectrum(scan, peptide, pars, aminoAcidMassesMap, spectrum);
+}
 
-			std::string temp = dirNameTemp + "/" + utils::baseName(scans[i].getOfname());
-			std::ofstream outF((temp).c_str());
-			if(!outF){
-				throw std::runtime_error("\nFailed to write spectrum!");
+//! Get the error thrown when the spectrum for \p scan can not be retrieved.
+std::runtime_error IonFinder::scanNotFoundError(const Dtafilter::Scan& scan)
+{
+	return std::runtime_error("Failed to retrieve scan " +
+							  std::to_string(scan.getScanNum()) + " from file " +
+							  scan.getPrecursor().getFile());
+}
+
+/**
+ Calculate the fragments for the peptide identified in \p scan and search \p spectrum for them.
+ \param scan scan to search. Precursor information from \p spectrum is copied into \p scan.
+ \param peptide set to the annotated peptide for \p scan
+ \param pars IonFinder params object.
+ \param aminoAcidMassesMap amino acid masses for \p scan, from IonFinder::initAminoAcidMasses.
+ \param spectrum ms2 spectrum for \p scan which has already been retrieved from its ms file.
+ */
+void IonFinder::findFragments_spectrum(Dtafilter::Scan& scan,
+									   PeptideNamespace::Peptide& peptide,
+									   const IonFinder::Params& pars,
+									   const IonFinder::AminoAcidMassesMap& aminoAcidMassesMap,
+									   ms2::Spectrum& spectrum)
+{
+	IonFinder::initPeptide(scan, peptide, pars, aminoAcidMassesMap);
+
+    // std::cout << scan.getPrecursor().getFile() << " -> " << scan.getScanNum() << NEW_LINE;
+    // peptide.printFragments(std::cout, false);
+
+    spectrum.setScanData(&scan);
+
+    //set all precursor info except file
+    scan.getPrecursor().setMZ(spectrum.getPrecursor().getMZ());
+    scan.getPrecursor().setScan(spectrum.getPrecursor().getScan());
+    scan.getPrecursor().setRT(spectrum.getPrecursor().getRT());
+    scan.getPrecursor().setCharge(spectrum.getPrecursor().getCharge());
+    scan.getPrecursor().setIntensity(spectrum.getPrecursor().getIntensity());
+
+    //normalize ion intensities and apply m/z and signal to noise filters
+    ms2::PreprocessOptions preprocessOptions(pars);
+    preprocessOptions.normalize = true;
+    spectrum.preprocess(preprocessOptions);
+	// spectrum.labelSpectrum(peptide, pars, true); //removes unlabeled ions from peptide
+
+    // label spectrum
+    {
+        PROFILE_SCOPE("Spectrum::labelSpectrum");
+        spectrum.labelSpectrum(peptide, pars);
+    }
+
+    //Filter ion intensities
+    if(pars.getMinLabelIntensity() > 0)
+        peptide.removeLabelIntensityBelow(pars.getMinLabelIntensity(), false, false);
+    if(pars.getNlIntCo() > 0)
+        peptide.removeLabelIntensityBelow(pars.getNlIntCo(), true, false);
+
+	//print spectra file
+	if(pars.getPrintSpectraFiles())
+	{
+		std::string dirNameTemp = (pars.getInDirSpecified() ? pars.getWD() : utils::dirName(scan.getPrecursor().getFile())) + "/spectraFiles";
+		if(!utils::dirExists(dirNameTemp))
+			if(!utils::mkdir(dirNameTemp.c_str(), "-p")){
+				throw std::runtime_error("\nFailed to make dir: " + dirNameTemp);
 			}
-			spectrum.printLabeledSpectrum(outF, true);
+
+		//spectrum.normalizeIonInts(100);
+		spectrum.calcLabelPos();
+
+		std::string temp = dirNameTemp + "/" + utils::baseName(scan.getOfname());
+		std::ofstream outF((temp).c_str());
+		if(!outF){
+			throw std::runtime_error("\nFailed to write spectrum!");
 		}
-		scansIndex++;
-	} //end of for
-	
-	*success = true;
+		spectrum.printLabeledSpectrum(outF, true);
+	}
 }
 
 void IonFinder::PeptideStats::calcContainsCit(bool includeCTermMod)
@@ -748,18 +1060,32 @@ std::string IonFinder::PeptideStats::containsCitToStr(const ContainsCitType& cc)
 }
 
 /**
- Prints peptide stats to file.
- \param stats Peptide stats to print.
- \param pars initialized IonFinder::Params object
- \return true if successful.
+ Get the ion types which are included in the peptide stats output file.
+ \param pars Params object for information on which analysis was performed
  */
-bool IonFinder::printPeptideStats(const std::vector<PeptideStats>& stats,
-								  const IonFinder::Params& pars)
+std::vector<IonFinder::PeptideStats::IonType> IonFinder::PeptideStats::getOutputIonTypes(const IonFinder::Params& pars)
+{
+	typedef IonFinder::PeptideStats::IonType itcType;
+	std::vector<itcType> _pepStats; //used to store relevant peptide stats based on params
+	//defaults
+	_pepStats.push_back(itcType::FRAG);
+	_pepStats.push_back(itcType::DET);
+	_pepStats.push_back(itcType::AMB);
+	//conditional stats
+	if(pars.getCalcNL()){
+		_pepStats.push_back(itcType::DET_NL);
+		_pepStats.push_back(itcType::ART_NL);
+	}
+	return _pepStats;
+}
+
+/**
+ Print header line of peptide stats output file.
+ \param out stream to print to
+ \param pars Params object for information on which columns to include
+ */
+void IonFinder::printPeptideStatsHeader(std::ostream& out, const IonFinder::Params& pars)
 {
-	//assert(outF);
-	std::ofstream outF (pars.makeOfname());
-	if(!outF) return false;
-	
 	typedef IonFinder::PeptideStats::IonType itcType;
 	//build stat names vector
 	std::vector<std::string> statNames;
@@ -774,16 +1100,7 @@ bool IonFinder::printPeptideStats(const std::vector<PeptideStats>& stats,
 	}
 	
 	//determine when to stop printing peptide stats based on analysis performed
-	std::vector<itcType> _pepStats; //used to store relevant peptide stats based on params
-	//defaults
-	_pepStats.push_back(itcType::FRAG);
-	_pepStats.push_back(itcType::DET);
-	_pepStats.push_back(itcType::AMB);
-	//conditional stats
-	if(pars.getCalcNL()){
-		_pepStats.push_back(itcType::DET_NL);
-		_pepStats.push_back(itcType::ART_NL);
-	}
+	std::vector<itcType> _pepStats = PeptideStats::getOutputIonTypes(pars);
 	
 	//append peptide stats names to headers
 	int statLen = 0;
@@ -807,6 +1124,8 @@ bool IonFinder::printPeptideStats(const std::vector<PeptideStats>& stats,
 	std::vector<std::string> oHeaders;
 	utils::split(otherHeaders, ' ', oHeaders);
 	std::vector<std::string> headers;
+	if(pars.getSharded())
+		headers.push_back(SHARD_INPUT_INDEX_COL);
 	if(pars.getPrintPeptideUID())
 		headers.emplace_back("peptide_unique_ID");
 	headers.insert(headers.end(), oHeaders.begin(), oHeaders.end());
@@ -816,91 +1135,121 @@ bool IonFinder::printPeptideStats(const std::vector<PeptideStats>& stats,
 	size_t len = headers.size();
 	for(size_t i = 0; i < len; i++){
 		if(i == 0)
-			outF << headers[i];
-		else outF << OUT_DELIM << headers[i];
+			out << headers[i];
+		else out << OUT_DELIM << headers[i];
 	}
-	outF << NEW_LINE;
+	out << NEW_LINE;
+}
+
+/**
+ Print a single line of the peptide stats output file.
+ \param out stream to print to
+ \param pars Params object for information on which columns to include
+ */
+void IonFinder::PeptideStats::printStats(std::ostream& out, const IonFinder::Params& pars) const
+{
+	typedef IonFinder::PeptideStats::IonType itcType;
+	std::vector<itcType> _pepStats = getOutputIonTypes(pars);
+
+	//scan data
+	if(pars.getSharded())
+		out << _scan->getInputIndex() << OUT_DELIM;
+	if(pars.getPrintPeptideUID())
+		out << _id << OUT_DELIM;
+
+    out << _scan->getParentID() <<
+		OUT_DELIM << _scan->getParentProtein() <<
+		OUT_DELIM << _scan->getParentDescription() <<
+		OUT_DELIM << _scan->getFullSequence() <<
+		OUT_DELIM << scanData::removeStaticMod(_scan->getSequence()) <<
+		OUT_DELIM << _scan->getFormula() <<
+		OUT_DELIM << _scan->getPrecursor().getMZ() <<
+		OUT_DELIM << (!modLocs.empty()) <<
+		OUT_DELIM << modResidues <<
+		OUT_DELIM << _scan->getPrecursor().getCharge() <<
+		OUT_DELIM << _scan->getUnique() <<
+		OUT_DELIM << _scan->getXcorr() <<
+		OUT_DELIM << _scan->getSpectralCounts() <<
+		OUT_DELIM << _scan->getScanNum() <<
+		OUT_DELIM << _scan->getPrecursor().getScan() <<
+		OUT_DELIM << _scan->getPrecursor().getRT() <<
+		OUT_DELIM << utils::baseName(_scan->getPrecursor().getFile()) <<
+		OUT_DELIM << _scan->getSampleName();
 	
-	//print data
-	for(const auto & stat : stats)
-	{
-		//scan data
-		if(pars.getPrintPeptideUID())
-			outF << stat._id << OUT_DELIM;
-
-        outF << stat._scan->getParentID() <<
-			OUT_DELIM << stat._scan->getParentProtein() <<
-			OUT_DELIM << stat._scan->getParentDescription() <<
-			OUT_DELIM << stat._scan->getFullSequence() <<
-			OUT_DELIM << scanData::removeStaticMod(stat._scan->getSequence()) <<
-			OUT_DELIM << stat._scan->getFormula() <<
-			OUT_DELIM << stat._scan->getPrecursor().getMZ() <<
-			OUT_DELIM << (!stat.modLocs.empty()) <<
-			OUT_DELIM << stat.modResidues <<
-			OUT_DELIM << stat._scan->getPrecursor().getCharge() <<
-			OUT_DELIM << stat._scan->getUnique() <<
-			OUT_DELIM << stat._scan->getXcorr() <<
-			OUT_DELIM << stat._scan->getSpectralCounts() <<
-			OUT_DELIM << stat._scan->getScanNum() <<
-			OUT_DELIM << stat._scan->getPrecursor().getScan() <<
-			OUT_DELIM << stat._scan->getPrecursor().getRT() <<
-			OUT_DELIM << utils::baseName(stat._scan->getPrecursor().getFile()) <<
-			OUT_DELIM << stat._scan->getSampleName();
-		
-		//peptide analysis data
-		outF << OUT_DELIM;
-		if(pars.getCalcNL())
-			 outF << PeptideStats::containsCitToStr(stat.containsCit);
-		else{
-			outF << (stat.ionTypesCount.at(itcType::DET).size() > 0);
-		}
-		if(pars.getGroupMod() == 0){
-            outF << OUT_DELIM;
-            if(pars.getCalcNL())
-                outF << PeptideStats::containsCitToStr(stat.thisContainsCit);
-            else{
-                outF << (stat.ionTypesCount.at(itcType::DET).size() > 0);
-            }
-            outF << OUT_DELIM << stat.modIndex;
-		}
+	//peptide analysis data
+	out << OUT_DELIM;
+	if(pars.getCalcNL())
+		 out << PeptideStats::containsCitToStr(containsCit);
+	else{
+		out << (ionTypesCount.at(itcType::DET).size() > 0);
+	}
+	if(pars.getGroupMod() == 0){
+        out << OUT_DELIM;
+        if(pars.getCalcNL())
+            out << PeptideStats::containsCitToStr(thisContainsCit);
+        else{
+            out << (ionTypesCount.at(itcType::DET).size() > 0);
+        }
+        out << OUT_DELIM << modIndex;
+	}
 
-		// ion counts
-		for(auto & _pepStat : _pepStats)
-			outF << OUT_DELIM << stat.ionTypesCount.at(_pepStat).size();
-
-		// list individual ions
-		for(auto & _pepStat : _pepStats){
-			outF << OUT_DELIM;
-            for(auto it = stat.ionTypesCount.at(_pepStat).begin();
-                it != stat.ionTypesCount.at(_pepStat).end();
-                ++it)
-            {
-                if(it == stat.ionTypesCount.at(_pepStat).begin())
-                    outF << it->getIonStr();
-                else outF << stat._fragDelim << it->getIonStr();
-            }
+	// ion counts
+	for(auto & _pepStat : _pepStats)
+		out << OUT_DELIM << ionTypesCount.at(_pepStat).size();
+
+	// list individual ions
+	for(auto & _pepStat : _pepStats){
+		out << OUT_DELIM;
+        for(auto it = ionTypesCount.at(_pepStat).begin();
+            it != ionTypesCount.at(_pepStat).end();
+            ++it)
+        {
+            if(it == ionTypesCount.at(_pepStat).begin())
+                out << it->getIonStr();
+            else out << _fragDelim << it->getIonStr();
         }
+    }
 
-		if(pars.getPrintIonIntensity()) {
-            // list individual ion intensities
-            for (auto &_pepStat : _pepStats) {
-                outF << OUT_DELIM;
-                for (auto it = stat.ionTypesCount.at(_pepStat).begin();
-                     it != stat.ionTypesCount.at(_pepStat).end();
-                     ++it) {
-                    if (it == stat.ionTypesCount.at(_pepStat).begin())
-                        outF << it->getIntensity();
-                    else outF << stat._fragDelim << it->getIntensity();
-                }
+	if(pars.getPrintIonIntensity()) {
+        // list individual ion intensities
+        for (auto &_pepStat : _pepStats) {
+            out << OUT_DELIM;
+            for (auto it = ionTypesCount.at(_pepStat).begin();
+                 it != ionTypesCount.at(_pepStat).end();
+                 ++it) {
+                if (it == ionTypesCount.at(_pepStat).begin())
+                    out << it->getIntensity();
+                else out << _fragDelim << it->getIntensity();
             }
-
-            // total intensities
-            for (auto &_pepStat : _pepStats)
-                outF << OUT_DELIM << stat.fragmentIntensity(_pepStat);
         }
 
-		outF << NEW_LINE;
-	}
+        // total intensities
+        for (auto &_pepStat : _pepStats)
+            out << OUT_DELIM << fragmentIntensity(_pepStat);
+    }
+
+	out << NEW_LINE;
+}
+
+/**
+ Prints peptide stats to file.
+ \param stats Peptide stats to print.
+ \param pars initialized IonFinder::Params object
+ \return true if successful.
+ */
+bool IonFinder::printPeptideStats(const std::vector<PeptideStats>& stats,
+								  const IonFinder::Params& pars)
+{
+	//assert(outF);
+	std::ofstream outF (pars.makeOfname());
+	if(!outF) return false;
+
+	IonFinder::printPeptideStatsHeader(outF, pars);
+	
+	//print data
+	for(const auto & stat : stats)
+		stat.printStats(outF, pars);
+
 	return true;
 }
 
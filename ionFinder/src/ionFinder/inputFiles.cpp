@@ -27,6 +27,41 @@
 
 #include <ionFinder/inputFiles.hpp>
 
+/**
+ Read DTASelect-filter or tsv input files supplied by \p pars, depending on Params::_inputMode.
+ \param pars initialized Params object
+ \param scans list of scans to add to
+ \returns true if all files were successfully read.
+ */
+bool IonFinder::readInput(const IonFinder::Params& pars, std::vector<Dtafilter::Scan>& scans)
+{
+	if(pars.getInputMode() == IonFinder::DTAFILTER_INPUT_STR)
+	{
+		std::cout << "\nReading DTAFilter-files...";
+		if(!Dtafilter::readFilterFiles(pars, scans))
+		{
+			std::cerr << "Failed to read DTASelect-filter files!" << NEW_LINE;
+			return false;
+		}
+		else std::cout << "Done!\n";
+	}
+	else{
+		assert(pars.getInputMode() == IonFinder::TSV_INPUT_STR);
+		std::cout << "\nReading input .tsv files...";
+		size_t nRead = 0;
+		Dtafilter::ScanFilterFunction shardFilter = IonFinder::makeShardFilter(nRead, pars);
+		for(auto file: pars.getInputDirs())
+		{
+            if(!IonFinder::readInputTsv(file,scans, !pars.getIncludeReverse(), pars.getModFilter(), shardFilter)) {
+                std::cerr << "Failed to read input .tsv files!" << NEW_LINE;
+                return false;
+            }
+        }
+		std::cout << "Done!\n";
+	}
+	return true;
+}
+
 /**
  Read list of filter files supplied by \p params
  \param params initialized Params object
@@ -36,17 +71,36 @@
 bool Dtafilter::readFilterFiles(const IonFinder::Params& params,
 								std::vector<Dtafilter::Scan>& scans)
 {
+	PROFILE_SCOPE("readFilterFiles");
+	size_t nRead = 0;
+	Dtafilter::ScanFilterFunction shardFilter = IonFinder::makeShardFilter(nRead, params);
 	auto endIt = params.getFilterFiles().end();
 	for(auto it = params.getFilterFiles().begin(); it != endIt; ++it)
 	{
 		if(!Dtafilter::readFilterFile(it->second, it->first, scans,
-									  !params.getIncludeReverse(), params.getModFilter()))
+									  !params.getIncludeReverse(), params.getModFilter(), shardFilter))
 			return false;
 	}
 	
 	return true;
 }
 
+/**
+ Make a filter for the input readers which numbers each scan read and skips those which do not
+ belong to the shard given by \p pars, so scans from other shards are never stored.
+ \param nRead Number of scans read. Incremented for every scan passed to the filter,
+ including scans which are skipped. Must outlive the returned function.
+ \param pars Params object with shard information. Must outlive the returned function.
+ \return Filter to pass to the input readers.
+ */
+Dtafilter::ScanFilterFunction IonFinder::makeShardFilter(size_t& nRead, const IonFinder::Params& pars)
+{
+	return [&nRead, &pars](Dtafilter::Scan& scan){
+		scan.setInputIndex(nRead++);
+		return pars.inShard(scan.getPrecursor().getFile());
+	};
+}
+
 /*
  sampleName
  parentID
@@ -72,13 +126,17 @@ bool Dtafilter::readFilterFiles(const IonFinder::Params& params,
  \param skipReverse Should reverse peptide matches be skipped?
  \param modFilter Which scans should be added to \p scans?
  0: only modified, 1: all peptides regardless of modification, 2: only unmodified pepeitde.
+ \param filter If not empty, called with each row which passes the other filters, before the
+ optional columns are read. Rows for which it returns false are skipped.
  
  \returns true if all files were successfully read.
  */
 bool IonFinder::readInputTsv(const std::string& ifname,
 							 std::vector<Dtafilter::Scan>& scans,
-							 bool skipReverse, int modFilter)
+							 bool skipReverse, int modFilter,
+							 const Dtafilter::ScanFilterFunction& filter)
 {
+	PROFILE_SCOPE("readInputTsv");
 	utils::TsvFile tsv(ifname);
 	if(!tsv.read()) return false;
 	
@@ -113,6 +171,20 @@ bool IonFinder::readInputTsv(const std::string& ifname,
         temp.setIsModified(temp.checkIsModified());
 		temp.getPrecursor().setFile(tsv.getValStr(i, IonFinder::PRECURSOR_FILE));
 		temp.setSampleName(tsv.getValStr(i, IonFinder::SAMPLE_NAME));
+		if(foundOptionalCols[IonFinder::MATCH_DIRECTION])
+			temp.setMatchDirection(Dtafilter::Scan::strToMatchDirection(tsv.getValStr(i, IonFinder::MATCH_DIRECTION)));
+
+		//reverse match filter
+		if(skipReverse && temp.getMatchDirection() == Dtafilter::Scan::MatchDirection::REVERSE)
+			continue;
+
+		//mod filter
+		if((modFilter == 0 && !temp.isModified()) ||
+		   (modFilter == 2 && temp.isModified()))
+			continue;
+
+		if(filter && !filter(temp))
+			continue;
 
 		//add optional columns which were found.
 		if(foundOptionalCols[IonFinder::PARENT_ID])
@@ -121,8 +193,6 @@ bool IonFinder::readInputTsv(const std::string& ifname,
 			temp.setParentProtein(tsv.getValStr(i, IonFinder::PARENT_PROTEIN));
 		if(foundOptionalCols[IonFinder::PARENT_DESCRIPTION])
 			temp.setParentDescription(tsv.getValStr(i, IonFinder::PARENT_DESCRIPTION));
-		if(foundOptionalCols[IonFinder::MATCH_DIRECTION])
-			temp.setMatchDirection(Dtafilter::Scan::strToMatchDirection(tsv.getValStr(i, IonFinder::MATCH_DIRECTION)));
         if(foundOptionalCols[IonFinder::FORMULA])
             temp.setFormula(tsv.getValStr(i, IonFinder::FORMULA));
 		if(foundOptionalCols[IonFinder::FULL_SEQUENCE])
@@ -137,16 +207,7 @@ bool IonFinder::readInputTsv(const std::string& ifname,
 			temp.getPrecursor().setMZ(tsv.getValStr(i, IonFinder::PRECURSOR_MZ));
 		if(foundOptionalCols[IonFinder::PRECURSOR_SCAN])
             temp.getPrecursor().setScan(tsv.getValStr(i, IonFinder::PRECURSOR_SCAN));
-		
-		//reverse match filter
-		if(skipReverse && temp.getMatchDirection() == Dtafilter::Scan::MatchDirection::REVERSE)
-			continue;
-		
-		//mod filter
-		if((modFilter == 0 && !temp.isModified()) ||
-		   (modFilter == 2 && temp.isModified()))
-			continue;
-		
+
 		scans.push_back(temp);
 	}
 	
@@ -29,42 +29,61 @@
 
 int main(int argc, const char** argv)
 {
+	//combine output from multiple shards
+	if(argc > 1 && !strcmp(argv[1], IonFinder::MERGE_SUBCOMMAND.c_str()))
+		return IonFinder::mergeShards(argc - 1, argv + 1);
+
+	//write peak stores for ms files
+	if(argc > 1 && !strcmp(argv[1], IonFinder::CONVERT_SUBCOMMAND.c_str()))
+		return IonFinder::convertMsFiles(argc - 1, argv + 1);
+
 	IonFinder::Params pars;
 	if(!pars.getArgs(argc, argv))
 		return 1;
 	
 	pars.printVersion(std::cout);
+	PROFILE_SESSION(pars.getProfileFile());
+
+	//run each experiment in manifest file
+	if(!pars.getBatchFile().empty())
+		return IonFinder::runBatch(argc, argv, pars) ? 0 : 1;
 
 	//read input files
 	std::vector<Dtafilter::Scan> scans;
-	if(pars.getInputMode() == IonFinder::DTAFILTER_INPUT_STR)
+	if(!IonFinder::readInput(pars, scans))
+		return 1;
+
+	//a shard with no scans is not an error, so it can still be merged with the other shards
+	if(scans.empty() && pars.getSharded())
 	{
-		std::cout << "\nReading DTAFilter-files...";
-		if(!Dtafilter::readFilterFiles(pars, scans))
+		std::cout << "\nNo scans in shard " << pars.getShardIndex() << "/" << pars.getNShards() << NEW_LINE;
+		if(!IonFinder::printPeptideStats(std::vector<IonFinder::PeptideStats>(), pars))
 		{
-			std::cerr << "Failed to read DTASelect-filter files!" << NEW_LINE;
+			std::cerr << "Failed to write peptide stats!" << NEW_LINE;
 			return 1;
 		}
-		else std::cout << "Done!\n";
+		std::cout << "\nResults written to: " << pars.makeOfname() << NEW_LINE;
+		return 0;
 	}
-	else{
-		assert(pars.getInputMode() == IonFinder::TSV_INPUT_STR);
-		std::cout << "\nReading input .tsv files...";
-		for(auto file: pars.getInputDirs())
+	
+	//search, analyze and write each scan as it moves through a pipeline
+	if(pars.getPipeline())
+	{
+		if(!IonFinder::runPipeline(scans, pars))
 		{
-            if(!IonFinder::readInputTsv(file,scans, !pars.getIncludeReverse(), pars.getModFilter())) {
-                std::cerr << "Failed to read input .tsv files!" << NEW_LINE;
-                return 1;
-            }
-        }
-		std::cout << "Done!\n";
+			std::cerr << "Failed to annotate spectra!" << NEW_LINE;
+			return 1;
+		}
+		std::cout << "\nResults written to: " << pars.makeOfname() << NEW_LINE;
+		return 0;
 	}
-	
+
 	//calculate and find fragments
 	std::vector<PeptideNamespace::Peptide> peptides;
 	peptides.reserve(scans.size());
 	if(!IonFinder::findFragmentsParallel(scans, peptides, pars)){
-		std::cout << "Failed to annotate spectra!" << std::endl;
+		std::cerr << "Failed to annotate spectra!" << NEW_LINE;
+		return 1;
 	}
 
 	/*
@@ -88,10 +107,13 @@ int main(int argc, const char** argv)
     */
 	
 	//write data
-	if(!IonFinder::printPeptideStats(peptideStats, pars))
 	{
-		std::cerr << "Failed to write peptide stats!" << NEW_LINE;
-		return 1;
+		PROFILE_SCOPE("printPeptideStats");
+		if(!IonFinder::printPeptideStats(peptideStats, pars))
+		{
+			std::cerr << "Failed to write peptide stats!" << NEW_LINE;
+			return 1;
+		}
 	}
 	std::cout << "\nResults written to: " << pars.makeOfname() << NEW_LINE;
 	
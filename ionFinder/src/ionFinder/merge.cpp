@@ -0,0 +1,213 @@
+//
+// merge.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <ionFinder/merge.hpp>
+
+/**
+ Run merge subcommand.
+ \param argc argc from main, minus program name
+ \param argv argv from main, starting at the subcommand
+ \return exit code for program
+ */
+int IonFinder::mergeShards(int argc, const char* const argv[])
+{
+	std::string ofname;
+	std::vector<std::string> ifnames;
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+		{
+			std::cout << MERGE_USAGE << NEW_LINE;
+			return 0;
+		}
+		if(!strcmp(argv[i], "-o") || !strcmp(argv[i], "--ofname"))
+		{
+			if(!utils::isArg(argv[++i]))
+			{
+				std::cerr << IonFinder::ARG_REQUIRED_STR << argv[i-1] << NEW_LINE << MERGE_USAGE << NEW_LINE;
+				return 1;
+			}
+			ofname = argv[i];
+			continue;
+		}
+		if(utils::isFlag(argv[i]))
+		{
+			std::cerr << argv[i] << " is an invalid argument." << NEW_LINE << MERGE_USAGE << NEW_LINE;
+			return 1;
+		}
+		ifnames.emplace_back(argv[i]);
+	}
+
+	if(ifnames.empty())
+	{
+		std::cerr << "At least one shard file is required!" << NEW_LINE << MERGE_USAGE << NEW_LINE;
+		return 1;
+	}
+	if(ofname.empty())
+	{
+		ofname = IonFinder::removeShardOfname(ifnames.front());
+		if(ofname == ifnames.front())
+		{
+			std::cerr << "Could not determine output file name from " << ifnames.front() <<
+			". Use -o to specify one." << NEW_LINE;
+			return 1;
+		}
+	}
+
+	std::cout << "\nMerging " << ifnames.size() << " shard file(s)...";
+	if(!IonFinder::mergeShardFiles(ifnames, ofname))
+	{
+		std::cerr << "Failed to merge shard files!" << NEW_LINE;
+		return 1;
+	}
+	std::cout << "Done!\n";
+	std::cout << "\nResults written to: " << ofname << NEW_LINE;
+	return 0;
+}
+
+/**
+ Remove shard number added by IonFinder::makeShardOfname from \p fname.
+ \return \p fname with shard number removed. If \p fname has no shard number it is returned unchanged.
+ */
+std::string IonFinder::removeShardOfname(const std::string& fname)
+{
+	size_t beg = fname.rfind(SHARD_OFNAME_INFIX);
+	if(beg == std::string::npos || beg < fname.find_last_of('/') + 1)
+		return fname;
+	size_t end = fname.find('.', beg + 1);
+	if(end == std::string::npos) end = fname.size();
+	return fname.substr(0, beg) + fname.substr(end);
+}
+
+/**
+ Combine peptide stats files written by each shard of a run with the \p --shard option. <br><br>
+ Rows are sorted by the IonFinder::SHARD_INPUT_INDEX_COL column, which is removed from the output,
+ so \p ofname is the same as the file a run without \p --shard would have written.
+ \param ifnames shard output files
+ \param ofname name of output file
+ \return true if all file I/O was successful.
+ */
+bool IonFinder::mergeShardFiles(const std::vector<std::string>& ifnames, const std::string& ofname)
+{
+	struct ShardFile{
+		std::string fname;
+		std::ifstream inF;
+		std::string line;
+		size_t index;
+		size_t lineNum;
+
+		//! Read next row. \return false if there are no more rows.
+		bool next(){
+			while(utils::safeGetline(inF, line)){
+				lineNum++;
+				if(line.empty()) continue;
+				size_t tab = line.find(OUT_DELIM);
+				try{
+					size_t newIndex = std::stoull(line.substr(0, tab));
+					if(lineNum > 2 && newIndex < index)
+						throw std::runtime_error("Rows in " + fname + " are not sorted by " + SHARD_INPUT_INDEX_COL);
+					index = newIndex;
+				} catch(std::logic_error&){
+					throw std::runtime_error("Invalid " + SHARD_INPUT_INDEX_COL + " on line " +
+											 std::to_string(lineNum) + " of " + fname);
+				}
+				line = tab == std::string::npos ? "" : line.substr(tab + 1);
+				return true;
+			}
+			return false;
+		}
+	};
+
+	std::vector<std::unique_ptr<ShardFile> > files;
+	std::string header;
+	for(const auto& ifname: ifnames)
+	{
+		files.emplace_back(new ShardFile());
+		ShardFile& file = *files.back();
+		file.fname = ifname;
+		file.index = 0;
+		file.lineNum = 1;
+		file.inF.open(ifname);
+		if(!file.inF){
+			std::cerr << "\nFailed to open " << ifname << NEW_LINE;
+			return false;
+		}
+
+		//check that headers match
+		std::string line;
+		utils::safeGetline(file.inF, line);
+		if(line.substr(0, line.find(OUT_DELIM)) != SHARD_INPUT_INDEX_COL){
+			std::cerr << NEW_LINE << ifname << " is not a shard output file!" << NEW_LINE;
+			return false;
+		}
+		if(header.empty())
+			header = line;
+		else if(line != header){
+			std::cerr << "\nHeader of " << ifname << " does not match " << ifnames.front() << NEW_LINE;
+			return false;
+		}
+	}
+
+	std::ofstream outF(ofname);
+	if(!outF) return false;
+	size_t tab = header.find(OUT_DELIM);
+	outF << (tab == std::string::npos ? "" : header.substr(tab + 1)) << NEW_LINE;
+
+	//k-way merge of rows by input index
+	typedef std::pair<size_t, size_t> IndexType; //input index, file index
+	std::priority_queue<IndexType, std::vector<IndexType>, std::greater<IndexType> > nextRows;
+	try{
+		for(size_t i = 0; i < files.size(); i++)
+			if(files[i]->next()) nextRows.emplace(files[i]->index, i);
+
+		size_t lastFile = 0;
+		size_t lastIndex = 0;
+		bool first = true;
+		while(!nextRows.empty())
+		{
+			IndexType cur = nextRows.top();
+			nextRows.pop();
+			if(!first && cur.first == lastIndex && cur.second != lastFile){
+				std::cerr << NEW_LINE << SHARD_INPUT_INDEX_COL << " " << cur.first << " is in both " <<
+				files[lastFile]->fname << " and " << files[cur.second]->fname << NEW_LINE;
+				return false;
+			}
+			first = false;
+			lastIndex = cur.first;
+			lastFile = cur.second;
+
+			ShardFile& file = *files[cur.second];
+			outF << file.line << NEW_LINE;
+			if(file.next()) nextRows.emplace(file.index, cur.second);
+		}
+	} catch(std::runtime_error& e){
+		std::cerr << NEW_LINE << e.what() << NEW_LINE;
+		return false;
+	}
+
+	return bool(outF);
+}
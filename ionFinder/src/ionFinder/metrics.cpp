@@ -0,0 +1,213 @@
+//
+// metrics.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <ionFinder/metrics.hpp>
+
+/**
+ \param stage Name of stage reported in metrics output.
+ \param count Total number of scans in stage.
+ \param nThread Number of worker threads which will call addSpectrum.
+ \param pars Params object. Metrics are written to Params::_metricsFile if it is not empty.
+ \param append Append to Params::_metricsFile instead of replacing it.
+ */
+IonFinder::Metrics::Metrics(std::string stage, size_t count, unsigned int nThread, const IonFinder::Params& pars,
+							bool append)
+		: _done(0), _fragmentsMatched(0), _stopped(false)
+{
+	_stage = std::move(stage);
+	_count = count;
+	_nThread = nThread == 0 ? 1 : nThread;
+	_threadSpectra = std::unique_ptr<std::atomic<size_t>[]>(new std::atomic<size_t>[_nThread]);
+	for(unsigned int i = 0; i < _nThread; i++)
+		_threadSpectra[i] = 0;
+	_startTime = ClockType::now();
+
+	_out = nullptr;
+	std::string fname = pars.getMetricsFile();
+	if(fname == METRICS_STDERR_STR)
+		_out = &std::cerr;
+	else if(!fname.empty()){
+		_outF.open(fname, append ? std::ios::app : std::ios::out);
+		if(_outF) _out = &_outF;
+		else std::cerr << "\nFailed to open metrics file: " << fname << NEW_LINE;
+	}
+}
+
+/**
+ Count a labeled spectrum and its matched fragments. <br>
+ Only the counter for \p threadIndex is written, so this can be called concurrently by each thread.
+ \param threadIndex index of calling thread. Must be less than nThread.
+ \param peptide peptide which was just labeled.
+ */
+void IonFinder::Metrics::addSpectrum(unsigned int threadIndex, const PeptideNamespace::Peptide& peptide)
+{
+	size_t nFound = 0;
+	for(size_t i = 0; i < peptide.getNumFragments(); i++)
+		if(peptide.getFound(i)) nFound++;
+	_fragmentsMatched += nFound;
+	_threadSpectra[threadIndex]++;
+}
+
+//! Stop monitor before all scans are done.
+void IonFinder::Metrics::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopped = true;
+	}
+	_cv.notify_all();
+}
+
+size_t IonFinder::Metrics::getSpectraLabeled() const
+{
+	size_t ret = 0;
+	for(unsigned int i = 0; i < _nThread; i++)
+		ret += _threadSpectra[i].load();
+	return ret;
+}
+
+/**
+ Write a single line of metrics JSON to _out.
+ \param status current status of stage
+ \param elapsed seconds since stage started
+ \param interval seconds since last line was written
+ \param idle seconds since progress was last made
+ \param lastThreadSpectra spectra labeled by each thread when last line was written. Updated with current values.
+ */
+void IonFinder::Metrics::writeJson(const std::string& status, double elapsed, double interval, double idle,
+								   std::vector<size_t>& lastThreadSpectra)
+{
+	size_t done = _done.load();
+	double time = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+	std::ostringstream ss;
+	ss.precision(3);
+	ss << std::fixed;
+	ss << "{\"time\":" << time
+	   << ",\"stage\":\"" << _stage << "\""
+	   << ",\"status\":\"" << status << "\""
+	   << ",\"elapsed\":" << elapsed
+	   << ",\"done\":" << done
+	   << ",\"total\":" << _count
+	   << ",\"spectra_labeled\":" << getSpectraLabeled()
+	   << ",\"fragments_matched\":" << _fragmentsMatched.load()
+	   << ",\"bytes_read\":" << (_bytesRead ? _bytesRead() : 0);
+
+	ss << ",\"threads\":[";
+	for(unsigned int i = 0; i < _nThread; i++){
+		size_t spectra = _threadSpectra[i].load();
+		ss << (i == 0 ? "" : ",") << "{\"spectra\":" << spectra << ",\"scans_per_sec\":"
+		   << (interval > 0 ? double(spectra - lastThreadSpectra[i]) / interval : 0);
+		ss << "}";
+		lastThreadSpectra[i] = spectra;
+	}
+	ss << "]";
+
+	ss << ",\"queues\":{";
+	for(size_t i = 0; i < _queues.size(); i++)
+		ss << (i == 0 ? "" : ",") << "\"" << _queues[i].first << "\":" << _queues[i].second();
+	ss << "}";
+
+	ss << ",\"eta\":";
+	if(done >= _count) ss << 0.0;
+	else if(done == 0 || elapsed <= 0) ss << "null";
+	else ss << double(_count - done) / (double(done) / elapsed);
+	ss << ",\"idle\":" << idle << "}";
+
+	*_out << ss.str() << std::endl;
+}
+
+/**
+ Print progress bar and write metrics until all scans are done or stop is called. <br>
+ Should be run on its own thread.
+ \param message message printed above progress bar
+ \param printProgress should the progress bar be printed?
+ \param sleepTime time between updates (in seconds)
+ */
+void IonFinder::Metrics::monitor(const std::string& message, bool printProgress, int sleepTime)
+{
+	std::vector<size_t> lastThreadSpectra(_nThread, 0);
+	size_t lastDone = _done.load();
+	size_t lastSpectra = getSpectraLabeled();
+	size_t lastBytes = _bytesRead ? _bytesRead() : 0;
+	ClockType::time_point lastTime = _startTime;
+	ClockType::time_point lastChange = _startTime;
+	bool stalled = false;
+	printProgress = printProgress && _count > 0;
+
+	if(printProgress) std::cout << message << NEW_LINE;
+	while(!_stopped && _done < _count)
+	{
+		ClockType::time_point now = ClockType::now();
+		size_t done = _done.load();
+		size_t spectra = getSpectraLabeled();
+		size_t bytes = _bytesRead ? _bytesRead() : 0;
+		if(done != lastDone || spectra != lastSpectra || bytes != lastBytes){
+			lastChange = now;
+			stalled = false;
+		}
+		lastDone = done;
+		lastSpectra = spectra;
+		lastBytes = bytes;
+
+		//report stall instead of quitting so a slow node can be told apart from a hung one
+		double idle = std::chrono::duration<double>(now - lastChange).count();
+		if(!stalled && idle >= double(IonFinder::MAX_PROGRESS_ITTERATIONS * sleepTime)){
+			stalled = true;
+			std::cerr << "\nWarning: no progress in " << _stage << " stage for "
+					  << int(idle) << " seconds!" << NEW_LINE;
+		}
+
+		if(printProgress)
+			utils::printProgress(float(done) / float(_count));
+		if(_out){
+			writeJson(stalled ? "stalled" : "running",
+					  std::chrono::duration<double>(now - _startTime).count(),
+					  std::chrono::duration<double>(now - lastTime).count(),
+					  idle, lastThreadSpectra);
+		}
+		lastTime = now;
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_cv.wait_for(lock, std::chrono::seconds(sleepTime), [this](){
+			return _stopped || _done >= _count;
+		});
+	}
+
+	if(printProgress){
+		utils::printProgress(float(_done.load()) / float(_count));
+		std::cout << NEW_LINE;
+		std::cout << "Done!" << NEW_LINE;
+	}
+	if(_out){
+		ClockType::time_point now = ClockType::now();
+		writeJson(_done >= _count ? "done" : "stopped",
+				  std::chrono::duration<double>(now - _startTime).count(),
+				  std::chrono::duration<double>(now - lastTime).count(),
+				  0, lastThreadSpectra);
+	}
+}
@@ -43,6 +43,55 @@ unsigned int IonFinder::Params::computeThreads()
     return ret;
 }
 
+/**
+ Get the shard which scans from \p precursorFile belong to. <br>
+ The shard is computed from a FNV-1a hash of the base name of \p precursorFile,
+ so it does not depend on the directory the input was read from, and all scans
+ from the same ms file are always in the same shard.
+ \param precursorFile path of ms file
+ \param nShards total number of shards
+ \return shard index between 1 and \p nShards
+ */
+size_t IonFinder::getShard(const std::string& precursorFile, size_t nShards)
+{
+    return size_t(fnv1a::hash(utils::baseName(precursorFile)) % nShards) + 1;
+}
+
+/**
+ Insert shard number before the extension of \p ofname. <br>
+ For example "peptide_cit_stats.tsv" becomes "peptide_cit_stats.shard_1_of_4.tsv".
+ */
+std::string IonFinder::makeShardOfname(const std::string& ofname, size_t shardIndex, size_t nShards)
+{
+    std::string shardStr = SHARD_OFNAME_INFIX + std::to_string(shardIndex) + "_of_" + std::to_string(nShards);
+    size_t extPos = ofname.find_last_of('.');
+    if(extPos == std::string::npos || extPos < ofname.find_last_of('/') + 1)
+        return ofname + shardStr;
+    return ofname.substr(0, extPos) + shardStr + ofname.substr(extPos);
+}
+
+/**
+ Parse a memory size such as "512M" or "48G". <br>
+ The suffix can be K, M or G (case insensitive). Sizes without a suffix are in megabytes.
+ \param str String to parse.
+ \param bytes Set to the size in bytes.
+ \return false if \p str is not a valid size.
+ */
+bool IonFinder::parseMemorySize(const std::string& str, size_t& bytes)
+{
+    char* end = nullptr;
+    double value = std::strtod(str.c_str(), &end);
+    if(end == str.c_str() || value < 0) return false;
+    double multiplier = 1024 * 1024;
+    std::string suffix = utils::toLower(std::string(end));
+    if(suffix == "k" || suffix == "kb") multiplier = 1024;
+    else if(suffix == "m" || suffix == "mb") multiplier = 1024 * 1024;
+    else if(suffix == "g" || suffix == "gb") multiplier = 1024.0 * 1024 * 1024;
+    else if(!suffix.empty()) return false;
+    bytes = size_t(value * multiplier);
+    return true;
+}
+
 /**
  Parses command line arguments and stores in Params object
  \pre current working directory exists
@@ -57,6 +106,22 @@ bool IonFinder::Params::getArgs(int argc, const char* const argv[])
     _wd = utils::pwd();
     assert(utils::dirExists(_wd));
 
+    //options which do not change search results are left out of the checkpoint key
+    const char* const keyFlags[] = {"--resume", "--parallel", "--noScanIndex"};
+    const char* const keyArgs[] = {"--checkpoint", "--checkpointInterval", "--nThread", "--metrics", "--profile",
+                                   "--scanIndexDir", "--maxMemory", "--prefetch"};
+    _checkpointKey.clear();
+    for(int i = 1; i < argc; i++)
+    {
+        if(std::any_of(std::begin(keyFlags), std::end(keyFlags), [&](const char* f){ return !strcmp(argv[i], f); }))
+            continue;
+        if(std::any_of(std::begin(keyArgs), std::end(keyArgs), [&](const char* f){ return !strcmp(argv[i], f); })){
+            i++;
+            continue;
+        }
+        _checkpointKey += std::string(argv[i]) + OUT_DELIM;
+    }
+
     for(int i = 1; i < argc; i++)
     {
         if(!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
@@ -412,6 +477,21 @@ bool IonFinder::Params::getArgs(int argc, const char* const argv[])
             _snrConf = std::stod(argv[i]);
             continue;
         }
+        if(!strcmp(argv[i], "--snrWindow"))
+        {
+            if(!utils::isArg(argv[++i]))
+            {
+                usage(IonFinder::ARG_REQUIRED_STR + argv[i-1]);
+                return false;
+            }
+            _snrWindow = std::stod(argv[i]);
+            if(_snrWindow < 0)
+            {
+                std::cerr << argv[i] << base::PARAM_ERROR_MESSAGE << argv[i-1] << NEW_LINE;
+                return false;
+            }
+            continue;
+        }
         if(!strcmp(argv[i], "-y") || !strcmp(argv[i], "--height"))
         {
             if(!utils::isArg(argv[++i]))
@@ -494,6 +574,171 @@ bool IonFinder::Params::getArgs(int argc, const char* const argv[])
             _numThread = computeThreads();
             continue;
         }
+        if(!strcmp(argv[i], "--pipeline"))
+        {
+            _pipeline = true;
+            continue;
+        }
+        if(!strcmp(argv[i], "--queueSize"))
+        {
+            if(!utils::isArg(argv[++i]))
+            {
+                usage(IonFinder::ARG_REQUIRED_STR + argv[i-1]);
+                return false;
+            }
+            int queueSize = std::stoi(argv[i]);
+            if(queueSize < 1)
+            {
+                std::cerr << argv[i] << base::PARAM_ERROR_MESSAGE << argv[i-1] << std::endl;
+                return false;
+            }
+            _queueSize = size_t(queueSize);
+            continue;
+        }
+        if(!strcmp(argv[i], "--prefetch"))
+        {
+            if(!utils::isArg(argv[++i]))
+            {
+                usage(IonFinder::ARG_REQUIRED_STR + argv[i-1]);
+                return false;
+            }
+            int prefetchDepth = std::stoi(argv[i]);
+            if(prefetchDepth < 0)
+            {
+                std::cerr << argv[i] << base::PARAM_ERROR_MESSAGE << argv[i-1] << std::endl;
+                return false;
+            }
+            _prefetchDepth = size_t(prefetchDepth);
+            continue;
+        }
+        if(!strcmp(argv[i], "--maxMemory"))
+        {
+            if(!utils::isArg(argv[++i]))
+            {
+                usage(IonFinder::ARG_REQUIRED_STR + argv[i-1]);
+                return false;
+            }
+            if(!parseMemorySize(argv[i], _maxMemory))
+            {
+                std::cerr << argv[i] << base::PARAM_ERROR_MESSAGE << argv[i-1] << std::endl;
+                return false;
+            }
+            continue;
+        }
+        if(!strcmp(argv[i], "--batch"))
+        {
+            if(!utils::isArg(argv[++i]))
+            {
+                usage(IonFinder::ARG_REQUIRED_STR + argv[i-1]);
+                return false;
+            }
+            _batchFile = utils::absPath(argv[i]);
+            if(!utils::fileExists(_batchFile))
+            {
+                std::cerr << "Specified batch file does not exist." << NEW_LINE;
+                return false;
+            }
+            continue;
+        }
+        if(!strcmp(argv[i], "--metrics"))
+        {
+            if(!utils::isArg(argv[++i]))
+            {
+                usage(IonFinder::ARG_REQUIRED_STR + argv[i-1]);
+                return false;
+            }
+            _metricsFile = strcmp(argv[i], METRICS_STDERR_STR.c_str()) ? utils::absPath(argv[i]) : METRICS_STDERR_STR;
+            continue;
+        }
+        if(!strcmp(argv[i], "--profile"))
+        {
+            if(!utils::isArg(argv[++i]))
+            {
+                usage(IonFinder::ARG_REQUIRED_STR + argv[i-1]);
+                return false;
+            }
+#ifdef ENABLE_PROFILE
+            _profileFile = utils::absPath(argv[i]);
+#else
+            std::cerr << "ERROR: --profile requires ionFinder to be built with -DENABLE_PROFILE=ON" << NEW_LINE;
+            return false;
+#endif
+            continue;
+        }
+        if(!strcmp(argv[i], "--checkpoint"))
+        {
+            if(!utils::isArg(argv[++i]))
+            {
+                usage(IonFinder::ARG_REQUIRED_STR + argv[i-1]);
+                return false;
+            }
+            _checkpointFile = utils::absPath(argv[i]);
+            continue;
+        }
+        if(!strcmp(argv[i], "--checkpointInterval"))
+        {
+            if(!utils::isArg(argv[++i]))
+            {
+                usage(IonFinder::ARG_REQUIRED_STR + argv[i-1]);
+                return false;
+            }
+            _checkpointInterval = std::stoi(argv[i]);
+            if(_checkpointInterval < 0)
+            {
+                std::cerr << argv[i] << base::PARAM_ERROR_MESSAGE << argv[i-1] << std::endl;
+                return false;
+            }
+            continue;
+        }
+        if(!strcmp(argv[i], "--resume"))
+        {
+            _resume = true;
+            continue;
+        }
+        if(!strcmp(argv[i], "--scanIndexDir"))
+        {
+            if(!utils::isArg(argv[++i]))
+            {
+                usage(IonFinder::ARG_REQUIRED_STR + argv[i-1]);
+                return false;
+            }
+            _scanIndexDir = utils::absPath(argv[i]);
+            if(!utils::dirExists(_scanIndexDir))
+            {
+                std::cerr << "Specified scan index directory does not exist." << NEW_LINE;
+                return false;
+            }
+            continue;
+        }
+        if(!strcmp(argv[i], "--noScanIndex"))
+        {
+            _useScanIndex = false;
+            continue;
+        }
+        if(!strcmp(argv[i], "--shard"))
+        {
+            if(!utils::isArg(argv[++i]))
+            {
+                usage(IonFinder::ARG_REQUIRED_STR + argv[i-1]);
+                return false;
+            }
+            std::vector<std::string> elems;
+            utils::split(argv[i], '/', elems);
+            int shardIndex = 0;
+            int nShards = 0;
+            if(elems.size() == 2){
+                shardIndex = std::atoi(elems[0].c_str());
+                nShards = std::atoi(elems[1].c_str());
+            }
+            if(nShards < 1 || shardIndex < 1 || shardIndex > nShards)
+            {
+                std::cerr << argv[i] << base::PARAM_ERROR_MESSAGE << argv[i-1] << std::endl;
+                return false;
+            }
+            _shardIndex = size_t(shardIndex);
+            _nShards = size_t(nShards);
+            continue;
+        }
         if(!strcmp(argv[i], "-v") || !strcmp(argv[i], "--verbose"))
         {
             verbose = true;
@@ -529,6 +774,23 @@ bool IonFinder::Params::getArgs(int argc, const char* const argv[])
     //fix options
     if(_wd[_wd.length() - 1] != '/')
         _wd += "/";
+    if((_resume || !_checkpointFile.empty()) && (_pipeline || !_batchFile.empty())){
+        std::cerr << "ERROR: --checkpoint and --resume can not be used with --pipeline or --batch!\n";
+        return false;
+    }
+    //input for each experiment is read from batch file
+    if(!_batchFile.empty()){
+        if(_pipeline){
+            std::cerr << "ERROR: --pipeline can not be used with --batch!\n";
+            return false;
+        }
+        if(_inDirSpecified){
+            std::cerr << "ERROR: Input can not be specified on the command line when using --batch!\n";
+            usage();
+            return false;
+        }
+        return true;
+    }
     if(_inputMode == DTAFILTER_INPUT_STR){
         if(!getFlist(force)){
             std::cerr << "Could not find DTAFilter-files!" << NEW_LINE;
@@ -542,6 +804,8 @@ bool IonFinder::Params::getArgs(int argc, const char* const argv[])
             return false;
         }
     }
+    if(_resume && _checkpointFile.empty())
+        _checkpointFile = makeOfname() + CHECKPOINT_EXT;
 
     return true;
 }//end of getArgs
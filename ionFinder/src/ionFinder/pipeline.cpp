@@ -0,0 +1,257 @@
+//
+// pipeline.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <ionFinder/pipeline.hpp>
+
+/**
+ Search, analyze and write \p scans as a pipeline of concurrent stages. <br><br>
+ Scan indices are fed to Params::_numThread search threads which retrieve and label each
+ spectrum with IonFinder::findFragments_scan. Labeled peptides are passed to a thread which
+ classifies the fragments with IonFinder::analyzeSequence, then to the calling thread which
+ writes each row to the output file. <br>
+ Stages are connected by BoundedQueue(s), and scans are released into the pipeline only
+ when they are within a fixed window of the next scan to be written, so the number of
+ Peptide and PeptideStats objects in memory depends on Params::_queueSize rather than the
+ number of scans. A reorder buffer keeps output rows in the same order as \p scans. <br>
+ ms files are not read ahead. Each file is read when the first of its scans is released into the
+ pipeline and released after its last scan is searched. With Params::_maxMemory, files which have
+ no scans in the window are released when the limit is exceeded and read again when they are needed. <br>
+ The output file is created when the first scan has been searched, and is removed if
+ the run fails, so a failed run does not leave a partial file behind.
+ 
+ \param scans populated list of identified ms2 scans to search for
+ \param pars Params object for information on how to perform analysis
+ \return true if all file I/O was successful.
+ */
+bool IonFinder::runPipeline(std::vector<Dtafilter::Scan>& scans, const IonFinder::Params& pars)
+{
+	size_t const nScans = scans.size();
+	unsigned int const nThread = pars.getNumThreads() == 0 ? 1 : pars.getNumThreads();
+	size_t const queueSize = pars.getQueueSize();
+	//max number of scans between the next scan to be written and the last scan released
+	size_t const window = 3 * queueSize + nThread + 1;
+
+	//the FASTA file is only used by the analysis thread
+	utils::FastaFile seqFile;
+	IonFinder::ModResidueFunction modResidue;
+	if(!pars.getFastaFile().empty()){
+		std::cout << "\nReading FASTA file...";
+		if(!seqFile.read(pars.getFastaFile())) return false;
+		std::cout << "Done!" << NEW_LINE;
+		modResidue = [&seqFile, &pars](const std::string& proteinID, const std::string& sequence,
+									   int modLoc, bool& found){
+			return seqFile.getModifiedResidue(proteinID, sequence, modLoc, pars.getVerbose(), found);
+		};
+	}
+
+	std::ofstream outF;
+	auto openOutput = [&outF, &pars]() -> bool {
+		outF.open(pars.makeOfname());
+		if(!outF) return false;
+		IonFinder::printPeptideStatsHeader(outF, pars);
+		return true;
+	};
+	if(nScans == 0){
+		std::cout << "No scans in input!\n";
+		return openOutput();
+	}
+
+	//amino acid masses are shared by the search threads
+	IonFinder::AminoAcidMassesMap aminoAcidMasses;
+	if(!IonFinder::initAminoAcidMasses(scans.begin(), scans.end(), pars, aminoAcidMasses))
+		return false;
+
+	// files are read as their scans are released into the pipeline
+	ms2::MsInterface msInterface;
+	msInterface.setScanIndex(pars.getUseScanIndex(), pars.getScanIndexDir());
+	msInterface.setMaxMemory(pars.getMaxMemory());
+	if(!msInterface.ingest(scans.begin(), scans.end(), nThread, false))
+		return false;
+
+	IonFinder::BoundedQueue<size_t> searchQueue(queueSize);
+	IonFinder::BoundedQueue<PipelineItemPtr> analyzeQueue(queueSize);
+	IonFinder::BoundedQueue<PipelineItemPtr> writeQueue(queueSize);
+
+	//index of the next scan to write
+	size_t nextIndex = 0;
+	std::mutex windowMutex;
+	std::condition_variable windowCv;
+	std::map<size_t, PipelineItemPtr> reorderBuffer;
+	std::atomic<size_t> reorderBufferSize(0);
+
+	IonFinder::Metrics metrics("pipeline", nScans, nThread, pars);
+	metrics.setBytesRead([&msInterface](){ return msInterface.getBytesRead(); });
+	metrics.addQueue("search", [&searchQueue](){ return searchQueue.size(); });
+	metrics.addQueue("analyze", [&analyzeQueue](){ return analyzeQueue.size(); });
+	metrics.addQueue("write", [&writeQueue](){ return writeQueue.size(); });
+	metrics.addQueue("reorder", [&reorderBufferSize](){ return reorderBufferSize.load(); });
+
+	std::atomic<bool> failed(false);
+	std::string errorMessage;
+	std::mutex errorMutex;
+	//stop all stages after an error
+	auto abort = [&](const std::string& message){
+		{
+			std::lock_guard<std::mutex> lock(errorMutex);
+			if(!failed) errorMessage = message;
+			failed = true;
+		}
+		searchQueue.close();
+		analyzeQueue.close();
+		writeQueue.close();
+		metrics.stop();
+		{
+			std::lock_guard<std::mutex> lock(windowMutex);
+		}
+		windowCv.notify_all();
+	};
+
+	//release scan indices into the pipeline
+	std::thread source([&](){
+		PROFILE_THREAD_NAME("source");
+		for(size_t i = 0; i < nScans; i++){
+			{
+				std::unique_lock<std::mutex> lock(windowMutex);
+				windowCv.wait(lock, [&](){ return failed || i < nextIndex + window; });
+			}
+			//read the file of the scan while earlier scans are searched. Errors are reported by the search thread.
+			msInterface.request(scans[i].getPrecursor().getFile());
+			if(failed || !searchQueue.push(i)) break;
+		}
+		searchQueue.close();
+	});
+
+	//search spectra for fragment ions
+	std::vector<std::thread> searchers;
+	std::atomic<unsigned int> activeSearchers(nThread);
+	for(unsigned int t = 0; t < nThread; t++){
+		searchers.emplace_back([&, t](){
+			PROFILE_THREAD_NAME("search " + std::to_string(t));
+			ms2::Spectrum spectrum;
+			size_t i;
+			try{
+				while(searchQueue.pop(i)){
+					PipelineItemPtr item(new PipelineItem(i));
+					IonFinder::findFragments_scan(scans[i], item->peptide, msInterface, pars,
+												  aminoAcidMasses, spectrum);
+					item->peptide.setID(scans[i].getInputIndex() + 1);
+					metrics.addSpectrum(t, item->peptide);
+					if(!analyzeQueue.push(std::move(item))) break;
+				}
+			} catch(std::exception& e){
+				abort(e.what());
+			}
+			if(--activeSearchers == 0)
+				analyzeQueue.close();
+		});
+	}
+
+	//classify fragment ions
+	int nSeqNotFound = 0;
+	std::thread analyzer([&](){
+		PROFILE_THREAD_NAME("analyze");
+		PipelineItemPtr item;
+		try{
+			while(analyzeQueue.pop(item)){
+				IonFinder::analyzeSequence(scans[item->index], item->peptide, item->stats, pars,
+										   modResidue, nSeqNotFound);
+				//fragments are not needed after PeptideStats are calculated
+				item->peptide = PeptideNamespace::Peptide();
+				if(!writeQueue.push(std::move(item))) break;
+			}
+		} catch(std::exception& e){
+			abort(e.what());
+		}
+		writeQueue.close();
+	});
+
+	//spawn progress and metrics monitor
+	std::thread monitor;
+	if(!pars.getVerbose() || metrics.getWriteMetrics()){
+		std::string progressMessage = "\nSearching ms2s for fragment ions using " + std::to_string(nThread) + " thread(s)...";
+		monitor = std::thread(&IonFinder::Metrics::monitor, &metrics, progressMessage, !pars.getVerbose(),
+							  PROGRESS_SLEEP_TIME);
+	}
+
+	//write rows in input order
+	PipelineItemPtr item;
+	while(writeQueue.pop(item)){
+		if(!outF.is_open() && !openOutput()){
+			abort("Failed to write " + pars.makeOfname());
+			break;
+		}
+		size_t index = item->index;
+		reorderBuffer[index] = std::move(item);
+
+		PROFILE_SCOPE("printStats");
+		size_t nWritten = 0;
+		for(auto it = reorderBuffer.begin();
+			it != reorderBuffer.end() && it->first == nextIndex + nWritten;
+			it = reorderBuffer.erase(it))
+		{
+			for(const auto& stat: it->second->stats)
+				stat.printStats(outF, pars);
+			nWritten++;
+		}
+		if(nWritten > 0){
+			{
+				std::lock_guard<std::mutex> lock(windowMutex);
+				nextIndex += nWritten;
+			}
+			windowCv.notify_all();
+			metrics.addDone(nWritten);
+		}
+		reorderBufferSize = reorderBuffer.size();
+		if(!outF){
+			abort("Failed to write " + pars.makeOfname());
+			break;
+		}
+	}
+
+	source.join();
+	for(auto& searcher: searchers)
+		searcher.join();
+	analyzer.join();
+	metrics.stop();
+	if(monitor.joinable())
+		monitor.join();
+
+	if(failed){
+		std::cerr << NEW_LINE << errorMessage << NEW_LINE;
+		//do not leave a file with only some of the rows behind
+		if(outF.is_open()){
+			outF.close();
+			std::remove(pars.makeOfname().c_str());
+		}
+		return false;
+	}
+	if(nSeqNotFound > 0){
+		std::cerr << NEW_LINE << nSeqNotFound << " protein sequences not found in " <<
+		pars.getFastaFile() << NEW_LINE;
+	}
+	return true;
+}
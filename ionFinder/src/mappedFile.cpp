@@ -0,0 +1,160 @@
+//
+// mappedFile.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <mappedFile.hpp>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Map \p fname into memory. Any file which was already mapped is unmapped first.
+ * @param fname Path of file to map.
+ * @return true if the file was successfully mapped.
+ */
+bool ms2::MappedFile::open(const std::string& fname)
+{
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(file, &fileSize)){
+        CloseHandle(file);
+        return false;
+    }
+    size_t size = size_t(fileSize.QuadPart);
+    if(size > 0){
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(mapping == nullptr){
+            CloseHandle(file);
+            return false;
+        }
+        void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        //the view keeps the mapping open until it is unmapped
+        CloseHandle(mapping);
+        if(data == nullptr){
+            CloseHandle(file);
+            return false;
+        }
+        _data = static_cast<const char*>(data);
+        _size = size;
+    }
+    CloseHandle(file);
+#else
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+    struct stat st;
+    if(fstat(fd, &st) != 0){
+        ::close(fd);
+        return false;
+    }
+    size_t size = size_t(st.st_size);
+    if(size > 0){
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED){
+            ::close(fd);
+            return false;
+        }
+        _data = static_cast<const char*>(data);
+        _size = size;
+    }
+    ::close(fd);
+#endif
+    return true;
+}
+
+void ms2::MappedFile::close()
+{
+    if(_data != nullptr && _size > 0) {
+#ifdef _WIN32
+        UnmapViewOfFile(_data);
+#else
+        munmap(const_cast<char*>(_data), _size);
+#endif
+    }
+    _data = nullptr;
+    _size = 0;
+}
+
+/**
+ * Get the number of bytes of the mapped file which are currently in memory. <br>
+ * Pages of the file are only read into memory when they are accessed, so this is usually
+ * less than the size of the file until the whole file has been read.
+ * On Windows the size of the file is always returned.
+ * @return Bytes, or the size of the file if it can not be determined.
+ */
+size_t ms2::MappedFile::getResidentSize() const
+{
+    if(_data == nullptr) return 0;
+#ifdef _WIN32
+    return _size;
+#else
+#ifdef __APPLE__
+    typedef char PageFlag;
+#else
+    typedef unsigned char PageFlag;
+#endif
+    size_t const pageSize = size_t(sysconf(_SC_PAGESIZE));
+    std::vector<PageFlag> pages((_size + pageSize - 1) / pageSize);
+    if(mincore(const_cast<char*>(_data), _size, pages.data()) != 0)
+        return _size;
+    size_t nResident = 0;
+    for(auto page: pages)
+        nResident += page & 1;
+    return std::min(_size, nResident * pageSize);
+#endif
+}
+
+//! Tell the kernel how the mapped file will be accessed with madvise. Does nothing on Windows.
+void ms2::MappedFile::advise(Advice advice) const
+{
+#ifndef _WIN32
+    if(_data == nullptr) return;
+    int flag = MADV_NORMAL;
+    switch(advice){
+        case Advice::SEQUENTIAL: flag = MADV_SEQUENTIAL; break;
+        case Advice::RANDOM: flag = MADV_RANDOM; break;
+        case Advice::NORMAL: break;
+    }
+    madvise(const_cast<char*>(_data), _size, flag);
+#else
+    (void)advice;
+#endif
+}
@@ -0,0 +1,187 @@
+//
+// mappedMs2File.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <mappedMs2File.hpp>
+
+/**
+ * Map \p fname into memory and build the scan index.
+ * @param fname Path of .ms2 file.
+ * @param indexFname Path of sidecar index file. If empty, the index is always rebuilt and not saved.
+ * @param scans Not used.
+ * @return true if the file was successfully mapped.
+ */
+bool ms2::MappedMs2File::read(const std::string& fname, const std::string& indexFname, const ScanNumList& scans)
+{
+    _index.clear();
+    _fname = fname;
+    if(!_file.open(fname)) return false;
+
+    ScanIndex::FileKey key;
+    bool haveKey = !indexFname.empty() && ScanIndex::getFileKey(fname, key);
+    if(!haveKey || !_index.read(indexFname, key)){
+        if(_file.isContiguous())
+            buildIndex(_file.begin(), _file.end());
+        else {
+            //BGZF files have to be decompressed once to find the scans
+            std::string buffer;
+            _file.readAll(buffer);
+            buildIndex(buffer.data(), buffer.data() + buffer.size());
+        }
+        //failing to save the index is not an error, it will just be rebuilt next time
+        if(haveKey) _index.write(indexFname, key);
+    }
+    _offsets.clear();
+    _offsets.reserve(_index.size());
+    for(size_t i = 0; i < _index.size(); i++)
+        _offsets.push_back(_index[i].offset);
+    std::sort(_offsets.begin(), _offsets.end());
+
+    //scans are requested in scan order, but most are skipped
+    _file.advise(MappedFile::Advice::RANDOM);
+    return true;
+}
+
+/**
+ * Find the offset and scan number of each 'S' line in the file.
+ * @param begin Beginning of uncompressed file.
+ * @param end End of uncompressed file.
+ */
+void ms2::MappedMs2File::buildIndex(const char* begin, const char* end)
+{
+    _index.clear();
+    for(const char* line = begin; line != nullptr && line < end;)
+    {
+        const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', size_t(end - line)));
+        if(lineEnd == nullptr) lineEnd = end;
+
+        if(*line == 'S' && lineEnd - line > 1 && (line[1] == '\t' || line[1] == ' ')){
+            //the first field after S is the scan number
+            ScanIndex::Entry entry;
+            entry.scanNum = std::strtoull(std::string(line + 1, lineEnd).c_str(), nullptr, 10);
+            entry.offset = uint64_t(line - begin);
+            _index.add(entry);
+        }
+        line = lineEnd < end ? lineEnd + 1 : nullptr;
+    }
+    _index.sort();
+}
+
+/**
+ * Parse a single scan from the mapped file. <br>
+ * This function is thread safe.
+ * @param scanNum Scan number to retrieve.
+ * @param scan Spectrum to populate.
+ * @return false if \p scanNum is not in the file.
+ */
+bool ms2::MappedMs2File::getScan(size_t scanNum, ms2::Spectrum& scan) const
+{
+    const ScanIndex::Entry* entry = _index.find(scanNum);
+    if(entry == nullptr)
+        return false;
+
+    scan.clear();
+    scan.setScanNum(scanNum);
+    utils::msInterface::PrecursorScan& precursorScan = precursor(scan);
+    std::vector<utils::msInterface::ScanIon>& scanIons = ions(scan);
+    precursorScan.setFile(_fname);
+    precursorScan.setSample(getSampleName());
+
+    //scan ends at the beginning of the next scan in the file
+    auto next = std::upper_bound(_offsets.begin(), _offsets.end(), entry->offset);
+    size_t scanEnd = next == _offsets.end() ? _file.size() : size_t(*next);
+    std::string buffer;
+    const char* begin = _file.read(size_t(entry->offset), scanEnd - size_t(entry->offset), buffer);
+    const char* const end = begin + (scanEnd - size_t(entry->offset));
+    std::string line;
+    std::vector<std::string> elems;
+    bool foundZ = false;
+    bool foundS = false;
+    for(const char* pos = begin; pos < end;)
+    {
+        const char* lineEnd = static_cast<const char*>(std::memchr(pos, '\n', size_t(end - pos)));
+        if(lineEnd == nullptr) lineEnd = end;
+        line.assign(pos, lineEnd);
+        pos = lineEnd + 1;
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        if(line.empty()) continue;
+
+        switch(line[0]){
+            case 'S':
+                //beginning of next scan
+                if(foundS) pos = end;
+                else {
+                    foundS = true;
+                    utils::split(line, '\t', elems);
+                    if(elems.size() > 3)
+                        precursorScan.setMZ(elems[3]);
+                }
+                break;
+            case 'I':
+                utils::split(line, '\t', elems);
+                if(elems.size() < 3) break;
+                if(elems[1] == "RetTime")
+                    precursorScan.setRT(std::atof(elems[2].c_str()));
+                else if(elems[1] == "PrecursorInt")
+                    precursorScan.setIntensity(std::atof(elems[2].c_str()));
+                else if(elems[1] == "PrecursorScan")
+                    precursorScan.setScan(elems[2]);
+                break;
+            case 'Z':
+                //only the first charge state is used
+                if(foundZ) break;
+                utils::split(line, '\t', elems);
+                if(elems.size() > 1)
+                    precursorScan.setCharge(std::atoi(elems[1].c_str()));
+                foundZ = true;
+                break;
+            default: {
+                if(line[0] < '0' || line[0] > '9') break;
+                char* next = nullptr;
+                double mz = std::strtod(line.c_str(), &next);
+                double intensity = std::strtod(next, nullptr);
+                scanIons.emplace_back();
+                scanIons.back().setMZ(utils::msInterface::ScanMZ(mz));
+                scanIons.back().setIntensity(utils::msInterface::ScanIntensity(intensity));
+            }
+        }
+    }
+    scan.updateRanges();
+    return true;
+}
+
+/**
+ * Get the scan numbers of all the scans in the index.
+ * @param scanNums Populated with sorted scan numbers.
+ */
+void ms2::MappedMs2File::getScanNums(ScanNumList& scanNums) const
+{
+    scanNums.clear();
+    scanNums.reserve(_index.size());
+    for(size_t i = 0; i < _index.size(); i++)
+        scanNums.push_back(size_t(_index[i].scanNum));
+    scanNums.erase(std::unique(scanNums.begin(), scanNums.end()), scanNums.end());
+}
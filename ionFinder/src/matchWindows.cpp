@@ -0,0 +1,208 @@
+//
+// matchWindows.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <matchWindows.hpp>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define MATCH_WINDOWS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace{
+
+	/**
+	 Find the first peak at or after \p pos which is not below \p bound,
+	 or which is above \p bound if \p INCLUSIVE.
+	 */
+	template<bool INCLUSIVE>
+	inline size_t skipScalar(const double* peaks, size_t pos, size_t nPeaks, double bound){
+		while(pos < nPeaks && (INCLUSIVE ? peaks[pos] <= bound : peaks[pos] < bound))
+			pos++;
+		return pos;
+	}
+
+	//! Kernel which processes one value at a time.
+	struct ScalarKernel{
+		static const size_t BLOCK = 1;
+		static void tolerances(const double* mzs, double relative, double absolute, double* out){
+			out[0] = mzs[0] * relative + absolute;
+		}
+		template<bool INCLUSIVE>
+		static size_t skip(const double* peaks, size_t pos, size_t nPeaks, double bound){
+			return skipScalar<INCLUSIVE>(peaks, pos, nPeaks, bound);
+		}
+	};
+
+	/**
+	 Find the window of peaks in the match tolerance of each fragment. Tolerances are calculated
+	 for blocks of _Kernel::BLOCK fragments and the window bounds are found with _Kernel::skip. <br>
+	 Because both arrays are sorted, the start of the window only moves forward, except when
+	 rounding of the tolerance moves it back by a few peaks.
+	 */
+	template<typename _Kernel>
+	inline void findWindows(const double* fragments, size_t nFragments,
+							double relative, double absolute,
+							const double* peaks, size_t nPeaks,
+							size_t* begins, size_t* ends)
+	{
+		double tolerances[_Kernel::BLOCK] = {};
+		size_t begin = 0;
+		for(size_t i = 0; i < nFragments; i++){
+			size_t inBlock = i % _Kernel::BLOCK;
+			if(inBlock == 0){
+				if(i + _Kernel::BLOCK <= nFragments)
+					_Kernel::tolerances(fragments + i, relative, absolute, tolerances);
+				else{
+					for(size_t j = i; j < nFragments; j++)
+						ScalarKernel::tolerances(fragments + j, relative, absolute, tolerances + (j - i));
+				}
+			}
+			double minMZ = fragments[i] - tolerances[inBlock];
+			double maxMZ = fragments[i] + tolerances[inBlock];
+
+			begin = _Kernel::template skip<false>(peaks, begin, nPeaks, minMZ);
+			while(begin > 0 && !(peaks[begin - 1] < minMZ))
+				begin--;
+			begins[i] = begin;
+			ends[i] = _Kernel::template skip<true>(peaks, begin, nPeaks, maxMZ);
+		}
+	}
+
+#ifdef MATCH_WINDOWS_X86_SIMD
+	//! Kernel which processes 4 values at a time.
+	struct AVX2Kernel{
+		static const size_t BLOCK = 4;
+
+		__attribute__((target("avx2")))
+		static void tolerances(const double* mzs, double relative, double absolute, double* out){
+			__m256d tol = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(mzs), _mm256_set1_pd(relative)),
+										_mm256_set1_pd(absolute));
+			_mm256_storeu_pd(out, tol);
+		}
+
+		template<bool INCLUSIVE>
+		__attribute__((target("avx2")))
+		static size_t skip(const double* peaks, size_t pos, size_t nPeaks, double bound){
+			__m256d b = _mm256_set1_pd(bound);
+			for(; pos + 4 <= nPeaks; pos += 4){
+				__m256d p = _mm256_loadu_pd(peaks + pos);
+				int mask = _mm256_movemask_pd(INCLUSIVE ? _mm256_cmp_pd(p, b, _CMP_LE_OQ)
+														: _mm256_cmp_pd(p, b, _CMP_LT_OQ));
+				if(mask != 0xF)
+					return pos + size_t(__builtin_ctz(~mask));
+			}
+			return skipScalar<INCLUSIVE>(peaks, pos, nPeaks, bound);
+		}
+	};
+
+	//! Kernel which processes 8 values at a time.
+	struct AVX512Kernel{
+		static const size_t BLOCK = 8;
+
+		__attribute__((target("avx512f")))
+		static void tolerances(const double* mzs, double relative, double absolute, double* out){
+			__m512d tol = _mm512_add_pd(_mm512_mul_pd(_mm512_loadu_pd(mzs), _mm512_set1_pd(relative)),
+										_mm512_set1_pd(absolute));
+			_mm512_storeu_pd(out, tol);
+		}
+
+		template<bool INCLUSIVE>
+		__attribute__((target("avx512f")))
+		static size_t skip(const double* peaks, size_t pos, size_t nPeaks, double bound){
+			__m512d b = _mm512_set1_pd(bound);
+			for(; pos + 8 <= nPeaks; pos += 8){
+				__m512d p = _mm512_loadu_pd(peaks + pos);
+				unsigned mask = INCLUSIVE ? _mm512_cmp_pd_mask(p, b, _CMP_LE_OQ)
+										  : _mm512_cmp_pd_mask(p, b, _CMP_LT_OQ);
+				if(mask != 0xFF)
+					return pos + size_t(__builtin_ctz(~mask));
+			}
+			return skipScalar<INCLUSIVE>(peaks, pos, nPeaks, bound);
+		}
+	};
+
+	__attribute__((target("avx2")))
+	void findAVX2(const double* fragments, size_t nFragments, double relative, double absolute,
+				  const double* peaks, size_t nPeaks, size_t* begins, size_t* ends){
+		findWindows<AVX2Kernel>(fragments, nFragments, relative, absolute, peaks, nPeaks, begins, ends);
+	}
+
+	__attribute__((target("avx512f")))
+	void findAVX512(const double* fragments, size_t nFragments, double relative, double absolute,
+					const double* peaks, size_t nPeaks, size_t* begins, size_t* ends){
+		findWindows<AVX512Kernel>(fragments, nFragments, relative, absolute, peaks, nPeaks, begins, ends);
+	}
+#endif
+
+	typedef void (*FindFunction)(const double*, size_t, double, double,
+								 const double*, size_t, size_t*, size_t*);
+
+	//! Get the fastest kernel supported by the processor.
+	FindFunction selectKernel()
+	{
+#ifdef MATCH_WINDOWS_X86_SIMD
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx512f"))
+			return findAVX512;
+		if(__builtin_cpu_supports("avx2"))
+			return findAVX2;
+#endif
+		return matchWindows::findScalar;
+	}
+}
+
+/**
+ Find the window of peaks in the match tolerance of each fragment. <br>
+ Peak \p j is in the window of fragment \p i if
+ fragments[i] - tolerance <= peaks[j] <= fragments[i] + tolerance, where
+ tolerance = fragments[i] * \p relative + \p absolute.
+ \param fragments Fragment m/z values sorted in ascending order.
+ \param nFragments Number of fragments.
+ \param relative Tolerance per unit m/z.
+ \param absolute Constant tolerance.
+ \param peaks Peak m/z values sorted in ascending order.
+ \param nPeaks Number of peaks.
+ \param begins Filled with the index of the first peak in the window of each fragment.
+ \param ends Filled with the index after the last peak in the window of each fragment.
+ */
+void matchWindows::find(const double* fragments, size_t nFragments,
+						double relative, double absolute,
+						const double* peaks, size_t nPeaks,
+						size_t* begins, size_t* ends)
+{
+	static const FindFunction function = selectKernel();
+	function(fragments, nFragments, relative, absolute, peaks, nPeaks, begins, ends);
+}
+
+//! matchWindows::find without SIMD instructions.
+void matchWindows::findScalar(const double* fragments, size_t nFragments,
+							  double relative, double absolute,
+							  const double* peaks, size_t nPeaks,
+							  size_t* begins, size_t* ends)
+{
+	findWindows<ScalarKernel>(fragments, nFragments, relative, absolute, peaks, nPeaks, begins, ends);
+}
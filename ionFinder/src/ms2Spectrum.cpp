@@ -27,6 +27,8 @@
 
 #include <ms2Spectrum.hpp>
 
+size_t const ms2::Spectrum::NO_INDEX;
+
 ms2::DataPoint& ms2::DataPoint::operator = (const ms2::DataPoint& rhs)
 {
     labeledIon = rhs.labeledIon;
@@ -131,29 +133,30 @@ void ms2::Spectrum::printLabeledSpectrum(std::ostream& out, bool includeMetaData
     }
     out << NEW_LINE;
 
+    //peaks without label data are printed with default values
+    const DataPoint unlabeled;
     std::streamsize ss = std::cout.precision();
     out.precision(5); //set out to print 5 floating point decimal places
-    for(const auto & ion : _dataPoints)
+    for(size_t i = 0; i < _peaks.size(); i++)
     {
-        // if(utils::strContains('*', ion.getFormatedLabel())) {
-        //     std::cout << ion.getFormatedLabel() << NEW_LINE;
-        // }
+        const utils::msInterface::ScanIon& ion = _ions[_peaks.ion[i]];
+        const DataPoint& point = _peaks.dataPoint[i] == NO_INDEX ? unlabeled : _dataPoints[_peaks.dataPoint[i]];
 
         out << std::fixed << ion.getMZ() << OUT_DELIM
             << ion.getIntensity() << OUT_DELIM
-            << ion.getLabel() << OUT_DELIM
-            << ion.getLableColor() << OUT_DELIM
-            << ion.label.getIncludeLabel() << OUT_DELIM
-            << PeptideNamespace::ionTypeToStr(ion.getIonType()) << OUT_DELIM
-            << ion.getIonNum() << OUT_DELIM
-            << ion.getFormatedLabel() << OUT_DELIM
-            << ion.label.labelLoc.getX() << OUT_DELIM
-            << ion.label.labelLoc.getY() << OUT_DELIM
-            << ion.label.getIncludeArrow() << OUT_DELIM
-            << ion.label.arrow.beg.getX() << OUT_DELIM
-            << ion.label.arrow.beg.getY() << OUT_DELIM
-            << ion.label.arrow.end.getX() << OUT_DELIM
-            << ion.label.arrow.end.getY() << NEW_LINE;
+            << point.getLabel() << OUT_DELIM
+            << point.getLableColor() << OUT_DELIM
+            << point.label.getIncludeLabel() << OUT_DELIM
+            << PeptideNamespace::ionTypeToStr(point.getIonType()) << OUT_DELIM
+            << point.getIonNum() << OUT_DELIM
+            << point.getFormatedLabel() << OUT_DELIM
+            << point.label.labelLoc.getX() << OUT_DELIM
+            << point.label.labelLoc.getY() << OUT_DELIM
+            << point.label.getIncludeArrow() << OUT_DELIM
+            << point.label.arrow.beg.getX() << OUT_DELIM
+            << point.label.arrow.beg.getY() << OUT_DELIM
+            << point.label.arrow.end.getX() << OUT_DELIM
+            << point.label.arrow.end.getY() << NEW_LINE;
     }
     out.precision(ss);
 
@@ -163,33 +166,146 @@ void ms2::Spectrum::printLabeledSpectrum(std::ostream& out, bool includeMetaData
 
 void ms2::Spectrum::clear()
 {
+    _peaks.clear();
     _dataPoints.clear();
+    _preprocessed = false;
     utils::msInterface::Scan::clear();
 }
 
+//! Reorder \p v so element \p i is the element at \p order[i] before.
+template<typename _Tp>
+static void permuteVector(std::vector<_Tp>& v, const std::vector<size_t>& order)
+{
+    std::vector<_Tp> temp(order.size());
+    for(size_t i = 0; i < order.size(); i++)
+        temp[i] = v[order[i]];
+    v.swap(temp);
+}
+
+void ms2::Spectrum::Peaks::clear()
+{
+    erase(0, size());
+}
+
+void ms2::Spectrum::Peaks::reserve(size_t len)
+{
+    mz.reserve(len);
+    intensity.reserve(len);
+    snr.reserve(len);
+    flags.reserve(len);
+    ion.reserve(len);
+    dataPoint.reserve(len);
+}
+
+/**
+ * Add a peak for an ion.
+ * \param scanIon Ion to copy m/z and intensity from.
+ * \param index Index of \p scanIon in Scan::_ions.
+ */
+void ms2::Spectrum::Peaks::add(const utils::msInterface::ScanIon& scanIon, size_t index)
+{
+    mz.push_back(scanIon.getMZ());
+    intensity.push_back(scanIon.getIntensity());
+    snr.push_back(0);
+    flags.push_back(PEAK_NOISE);
+    ion.push_back(index);
+    dataPoint.push_back(NO_INDEX);
+}
+
+/**
+ * Reorder peaks.
+ * \param order Index of the peak which should be at each position.
+ */
+void ms2::Spectrum::Peaks::permute(const std::vector<size_t>& order)
+{
+    permuteVector(mz, order);
+    permuteVector(intensity, order);
+    permuteVector(snr, order);
+    permuteVector(flags, order);
+    permuteVector(ion, order);
+    permuteVector(dataPoint, order);
+}
+
+//! Remove peaks from \p begin to \p end.
+void ms2::Spectrum::Peaks::erase(size_t begin, size_t end)
+{
+    mz.erase(mz.begin() + begin, mz.begin() + end);
+    intensity.erase(intensity.begin() + begin, intensity.begin() + end);
+    snr.erase(snr.begin() + begin, snr.begin() + end);
+    flags.erase(flags.begin() + begin, flags.begin() + end);
+    ion.erase(ion.begin() + begin, ion.begin() + end);
+    dataPoint.erase(dataPoint.begin() + begin, dataPoint.begin() + end);
+}
+
 /**
- * Set the DataPoint::topAbundant value for the top n ion intensities.<br><br>
+ * Get the label data of \p peak, creating it if the peak does not have any yet.
+ * \param peak Index of peak.
+ * \return Reference to DataPoint, which is valid until label data is created for another peak.
+ */
+ms2::DataPoint& ms2::Spectrum::getDataPoint(size_t peak)
+{
+    if(_peaks.dataPoint[peak] == NO_INDEX)
+    {
+        _peaks.dataPoint[peak] = _dataPoints.size();
+        _dataPoints.emplace_back(&_ions[_peaks.ion[peak]]);
+        DataPoint& point = _dataPoints.back();
+        point.setTopAbundant(_peaks.flags[peak] & PEAK_TOP_ABUNDANT);
+        point.setNoise(_peaks.flags[peak] & PEAK_NOISE);
+        point.setSNR(_peaks.snr[peak]);
+    }
+    return _dataPoints[_peaks.dataPoint[peak]];
+}
+
+/**
+ * Set the PEAK_TOP_ABUNDANT flag for the top n ion intensities.<br><br>
  *
- * The function iterates through the Spectrum and finds the top n most
- * intense ions.
+ * The nth highest intensity is found with std::nth_element, and peaks above it are flagged.
+ * If more than one peak has the nth highest intensity, the first ones in spectrum order are flagged.
  * \param labelTop Top n ion intensities to label.
  */
 void ms2::Spectrum::setLabelTop(size_t labelTop)
 {
-    typedef std::list<ms2::DataPoint*> listType;
-    listType pointList;
+    size_t len = _peaks.size();
+    if(len <= labelTop)
+    {
+        for(size_t i = 0; i < len; i++)
+            _peaks.flags[i] |= PEAK_TOP_ABUNDANT;
+        return;
+    }
+    if(labelTop == 0) return;
 
-    for(auto & ion : _dataPoints)
-        pointList.push_back(&ion);
+    std::vector<utils::msInterface::ScanIntensity> intensities(_peaks.intensity);
+    auto nth = intensities.begin() + (labelTop - 1);
+    std::nth_element(intensities.begin(), nth, intensities.end(),
+                     std::greater<utils::msInterface::ScanIntensity>());
+    utils::msInterface::ScanIntensity minIntensity = *nth;
 
-    if(pointList.size() > labelTop)
+    //number of peaks with the nth highest intensity which are in the top n
+    size_t nEqual = labelTop;
+    for(size_t i = 0; i < len; i++)
+        if(_peaks.intensity[i] > minIntensity) nEqual--;
+
+    for(size_t i = 0; i < len; i++)
     {
-        pointList.sort(ms2::DataPoint::IntComparison());
-        pointList.resize(labelTop);
+        if(_peaks.intensity[i] > minIntensity)
+            _peaks.flags[i] |= PEAK_TOP_ABUNDANT;
+        else if(nEqual > 0 && _peaks.intensity[i] == minIntensity){
+            _peaks.flags[i] |= PEAK_TOP_ABUNDANT;
+            nEqual--;
+        }
     }
+}
 
-    for(auto & it : pointList)
-        it->setTopAbundant(true);
+//! Sort peaks by m/z.
+void ms2::Spectrum::sortPeaksByMZ()
+{
+    std::vector<size_t> order(_peaks.size());
+    for(size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [this](size_t lhs, size_t rhs){
+        return _peaks.mz[lhs] < _peaks.mz[rhs];
+    });
+    _peaks.permute(order);
 }
 
 /**
@@ -203,44 +319,30 @@ void ms2::Spectrum::setMZRange(double minMZ, double maxMZ, bool _sort)
 {
     //sort ions by mz
     if(_sort)
-        sort(_dataPoints.begin(), _dataPoints.end(), DataPoint::MZComparison());
+        sortPeaksByMZ();
 
-    auto begin = _dataPoints.begin();
-    auto end = _dataPoints.end();
+    const std::vector<utils::msInterface::ScanMZ>& mzs = _peaks.mz;
+    size_t len = mzs.size();
 
-    //find min mz
-    for(auto it = _dataPoints.begin(); it != _dataPoints.end(); ++it)
-    {
-        if(it->getMZ() <= minMZ)
-        {
-            begin = it;
-            continue;
-        }
-        else break;
-    }
-    //find max mz
-    for(auto it = begin; it != _dataPoints.end(); ++it)
-    {
-        if(it->getMZ() < maxMZ)
-        {
-            end = it;
-            continue;
-        }
-        else break;
-    }
+    //the range begins at the last ion <= minMZ
+    size_t begin = size_t(std::upper_bound(mzs.begin(), mzs.end(), minMZ) - mzs.begin());
+    if(begin > 0) begin--;
 
-    _dataPoints = ionVecType(begin, end);
+    //and ends before the last ion < maxMZ, or at the end if the first ion is >= maxMZ
+    size_t end = len;
+    if(begin < len && mzs[begin] < maxMZ)
+        end = size_t(std::lower_bound(mzs.begin() + begin, mzs.end(), maxMZ) - mzs.begin()) - 1;
+
+    _peaks.erase(end, len);
+    _peaks.erase(0, begin);
     updateRanges();
 }
 
 void ms2::Spectrum::removeUnlabeledIons()
 {
-    for(auto it = _dataPoints.begin(); it != _dataPoints.end();)
-    {
-        if(!it->getForceLabel())
-            _dataPoints.erase(it);
-        else ++it;
-    }
+    _peaks.removeIf([this](size_t i){
+        return _peaks.dataPoint[i] == NO_INDEX || !_dataPoints[_peaks.dataPoint[i]].getForceLabel();
+    });
     updateRanges();
 }
 
@@ -250,73 +352,199 @@ void ms2::Spectrum::removeUnlabeledIons()
  */
 void ms2::Spectrum::removeIntensityBelow(double min_int)
 {
-    for(auto it = _dataPoints.begin(); it != _dataPoints.end();)
-    {
-        if(it->getIntensity() < min_int)
-            _dataPoints.erase(it);
-        else ++it;
-    }
+    _peaks.removeIf([this, min_int](size_t i){
+        return _peaks.intensity[i] < min_int;
+    });
 
     updateRanges();
 }
 
-//! Calculate signal to nose ratio of ion intensities
+/**
+ * Get the critical values for \p snrConf.
+ * Critical values are calculated once per thread for each \p snrConf.
+ */
+static const statistics::CriticalValues& getCriticalValues(double snrConf)
+{
+    static thread_local statistics::CriticalValues criticalValues;
+    if(!(criticalValues.getConf() == snrConf))
+        criticalValues = statistics::CriticalValues(snrConf, ms2::SNR_T_MAX_PEAKS);
+    return criticalValues;
+}
+
+/**
+ * Calculate signal to nose ratio of ion intensities. <br><br>
+ *
+ * Peaks whose absolute standard score is above the critical value of the normal distribution
+ * (or the t distribution when there are SNR_T_MAX_PEAKS or fewer peaks) at \p snrConf are signal.
+ * \param snrConf Confidence level a peak must have to be considered signal.
+ */
 void ms2::Spectrum::calcSNR(double snrConf)
 {
-    double sd = statistics::sd<DataPoint>(_dataPoints, [](const DataPoint& i) -> double{return i.getIntensity();});
-    double mean = statistics::mean<DataPoint>(_dataPoints, [](const DataPoint& i) -> double{return i.getIntensity();});
-    std::vector<double> stats;
-    for(auto point : _dataPoints)
-        stats.push_back(abs(point.getIntensity() - mean) / sd);
+    const statistics::CriticalValues& criticalValues = getCriticalValues(snrConf);
 
-    auto dist = std::shared_ptr<statistics::ProbabilityDist>();
-    size_t len = _dataPoints.size();
-    if(len > 30)
-        dist = std::make_shared<statistics::NormDist>();
-    else dist = std::make_shared<statistics::TDist>(double(len - 1));
+    double sd = statistics::sd<utils::msInterface::ScanIntensity>(_peaks.intensity);
+    double mean = statistics::mean<utils::msInterface::ScanIntensity>(_peaks.intensity);
+    size_t len = _peaks.size();
+    if(len == 0) return;
+    double criticalValue = len > SNR_T_MAX_PEAKS ? criticalValues.norm() : criticalValues.t(len - 1);
 
     double noise = 0;
     size_t noiseLen = 0;
     for(size_t i = 0; i < len; i++){
-        double pVal = dist->pValue(stats[i]);
-        if(pVal > snrConf)
-            _dataPoints[i].setNoise(false);
+        if(abs(_peaks.intensity[i] - mean) / sd > criticalValue)
+            _peaks.flags[i] &= ~PEAK_NOISE;
         else {
-            noise += _dataPoints[i].getIntensity();
+            noise += _peaks.intensity[i];
             noiseLen++;
         }
     }
     noise /= double(noiseLen);
 
-    for(auto & _dataPoint : _dataPoints)
-        _dataPoint.setSNR(_dataPoint.getIntensity() / noise);
+    for(size_t i = 0; i < len; i++)
+        _peaks.snr[i] = _peaks.intensity[i] / noise;
 }
 
-//! Remove ions with a signal to nose ratio below \p snrThreshold
-void ms2::Spectrum::removeSNRBelow(double snrThreshold, double snrConf)
+/**
+ * Calculate signal to nose ratio of ion intensities from the noise in an m/z window around each peak. <br><br>
+ *
+ * The noise level of a peak is the median intensity of the other peaks within \p snrWindow / 2 Th of it,
+ * and the spread of the noise is estimated from the interquartile range of the same peaks.
+ * Peaks whose intensity is above the median by more than the critical value of the normal
+ * distribution at \p snrConf are signal. If the spread is 0, peaks above the median are signal. <br>
+ * Peaks with fewer than SNR_WINDOW_MIN_PEAKS neighbors in the window, or with a median of 0,
+ * keep the estimate from the whole spectrum calculated by calcSNR. <br>
+ * The window slides over the peaks in a single pass, so peaks must be sorted by m/z.
+ * \param snrConf Confidence level a peak must have to be considered signal.
+ * \param snrWindow Width of m/z window.
+ */
+void ms2::Spectrum::calcLocalSNR(double snrConf, double snrWindow)
 {
+    size_t len = _peaks.size();
+    if(len == 0) return;
+    double criticalValue = getCriticalValues(snrConf).norm();
+    double halfWindow = snrWindow / 2;
+
+    //global estimate is used for peaks without enough neighbors
     calcSNR(snrConf);
-    for(auto it = _dataPoints.begin(); it != _dataPoints.end();)
+
+    statistics::WindowQuantiles window(_peaks.intensity);
+    size_t begin = 0;
+    size_t end = 0;
+    for(size_t i = 0; i < len; i++)
     {
-        if(it->getSNR() < snrThreshold)
-            _dataPoints.erase(it);
-        else ++it;
+        while(end < len && _peaks.mz[end] <= _peaks.mz[i] + halfWindow)
+            window.insert(end++);
+        while(_peaks.mz[begin] < _peaks.mz[i] - halfWindow)
+            window.erase(begin++);
+
+        //the peak being scored is not part of its own noise estimate
+        window.erase(i);
+        if(window.size() >= SNR_WINDOW_MIN_PEAKS)
+        {
+            double noise = window.quantile(0.5);
+            double sd = (window.quantile(0.75) - window.quantile(0.25)) / IQR_NORM_SD;
+            if(noise > 0)
+            {
+                double diff = _peaks.intensity[i] - noise;
+                bool signal = sd > 0 ? diff / sd > criticalValue : diff > 0;
+                if(signal) _peaks.flags[i] &= ~PEAK_NOISE;
+                else _peaks.flags[i] |= PEAK_NOISE;
+                _peaks.snr[i] = _peaks.intensity[i] / noise;
+            }
+        }
+        window.insert(i);
+    }
+}
+
+/**
+ * Remove ions with a signal to nose ratio below \p snrThreshold
+ * \param snrThreshold Min signal to noise ratio.
+ * \param snrConf Confidence level a peak must have to be considered signal.
+ * \param snrWindow Width of m/z window used to estimate local noise.
+ * If 0, noise is estimated from the whole spectrum.
+ */
+void ms2::Spectrum::removeSNRBelow(double snrThreshold, double snrConf, double snrWindow)
+{
+    PROFILE_SCOPE("Spectrum::removeSNRBelow");
+    if(snrWindow > 0){
+        if(!std::is_sorted(_peaks.mz.begin(), _peaks.mz.end()))
+            sortPeaksByMZ();
+        calcLocalSNR(snrConf, snrWindow);
     }
+    else calcSNR(snrConf);
+    _peaks.removeIf([this, snrThreshold](size_t i){
+        return _peaks.snr[i] < snrThreshold;
+    });
     updateRanges();
 }
 
-//! Copy ions from utils::Scan::_ions to labeledIons
-void ms2::Spectrum::initLabeledIons()
+/**
+ * Get the options used for labeling spectra with \p pars.
+ * \param pars Initialized params object.
+ * \param labelTop Number of most intense peaks which can be labeled.
+ */
+ms2::PreprocessOptions::PreprocessOptions(const base::ParamsBase& pars, size_t labelTop) : PreprocessOptions()
+{
+    this->labelTop = labelTop;
+    //-minInt is not used because it was only ever applied before the peaks were initialized,
+    //so it never removed any peaks.
+    minMZSpecified = pars.getMinMZSpecified();
+    minMZ = pars.getMinMZ();
+    maxMZSpecified = pars.getMaxMZSpecified();
+    maxMZ = pars.getMaxMZ();
+    minSNRSpecified = pars.getMinSNRSpecified();
+    minSNR = pars.getMinSnr();
+    snrConf = pars.getSNRConf();
+    snrWindow = pars.getSNRWindow();
+}
+
+/**
+ * Initialize the peaks used for labeling from the ions in the scan. <br><br>
+ *
+ * Intensities are normalized and ions below the min intensity are skipped while the peaks are copied.
+ * The top n most intense peaks are flagged, the peaks are sorted by m/z, then the
+ * m/z range and signal to noise filters are applied. <br>
+ * If only one m/z limit is specified, the other is the max m/z of the spectrum.
+ * \param options Preprocessing options.
+ */
+void ms2::Spectrum::preprocess(const PreprocessOptions& options)
 {
+    PROFILE_SCOPE("Spectrum::preprocess");
     _dataPoints.clear();
-    size_t len = size();
-    for(size_t i = 0; i < len; i++) {
-        _dataPoints.emplace_back(&_ions[i]);
+    _peaks.clear();
+
+    size_t len = _ions.size();
+    _peaks.reserve(len);
+    utils::msInterface::ScanIntensity den = options.normalize ? getMaxInt() / options.normalizeMax : 1;
+    for(size_t i = 0; i < len; i++)
+    {
+        if(options.normalize)
+            _ions[i].setIntensity(_ions[i].getIntensity() / den);
+        if(options.minIntensitySpecified && _ions[i].getIntensity() < options.minIntensity)
+            continue;
+        _peaks.add(_ions[i], i);
     }
+    if(options.normalize)
+        updateRanges();
+
+    setLabelTop(options.labelTop);
+    sortPeaksByMZ();
+    if(options.minMZSpecified || options.maxMZSpecified)
+    {
+        setMZRange(options.minMZSpecified ? options.minMZ : getMaxMZ(),
+                   options.maxMZSpecified ? options.maxMZ : getMaxMZ(),
+                   false);
+    }
+    if(options.minSNRSpecified)
+        removeSNRBelow(options.minSNR, options.snrConf, options.snrWindow);
+
+    _preprocessed = true;
 }
 
 /**
- * Label spectrum with predicted fragment ions from \p peptide.
+ * Label spectrum with predicted fragment ions from \p peptide. <br>
+ * If preprocess was not called since the ions were set, the peaks are
+ * preprocessed with the options in \p pars and \p labelTop.
  * \param peptide Peptide to label spectrum with.
  * \param pars Initialized params object.
  * \param removeUnlabeledFrags Should unlabeled F
@@ -326,115 +554,58 @@ void ms2::Spectrum::labelSpectrum(PeptideNamespace::Peptide& peptide,
                                   const base::ParamsBase& pars,
                                   bool removeUnlabeledFrags, size_t labelTop)
 {
-    initLabeledIons();
+    //determine which ions are abundant enough to considered in labeling and apply filters
+    if(!_preprocessed)
+        preprocess(PreprocessOptions(pars, labelTop));
+    _preprocessed = false;
+
     plotWidth = pars.getPlotWidth();
     plotHeight = pars.getPlotHeight();
     size_t len = peptide.getNumFragments();
     size_t labledCount = 0;
-    double _labelTolerance;
     bool seqPrinted = false;
 
-    typedef std::list<ms2::DataPoint*> listType;
-    listType rangeList;
-    listType::iterator label;
-
-    setLabelTop(labelTop); //determine which labeledIons are abundant enough to considered in labeling
-    std::sort(_dataPoints.begin(), _dataPoints.end(), DataPoint::MZComparison()); //sort labeledIons by mz
-    if(pars.getMZSpecified()) //set user specified mz range if specified
-    {
-        setMZRange(pars.getMinMZSpecified() ? pars.getMinMZ() : getMaxMZ(),
-                   pars.getMaxMZSpecified() ? pars.getMaxMZ() : getMaxMZ(),
-                   false);
-    }
-    // apply snr filter
-    if(pars.getMinSNRSpecified())
-        removeSNRBelow(pars.getMinSnr(), pars.getSNRConf());
+    //find the peak matching each fragment
+    std::vector<size_t> matches;
+    if(len >= BIN_INDEX_MIN_FRAGMENTS && double(len) >= BIN_INDEX_MIN_FRAGMENT_RATIO * double(_peaks.size()))
+        matchFragmentsIndexed(peptide, pars, matches);
+    else matchFragments(peptide, pars, matches);
 
     //iterate through all calculated fragment ions and label ions on spectrum if they are found
     for(size_t i = 0; i < len; i++)
     {
-        double tempMZ = peptide.getFragmentMZ(i);
-
-        rangeList.clear();
-
-        //first get lowest value in range
-        _labelTolerance = pars.getMatchTolerance(tempMZ);
-        auto lowerBound = std::lower_bound(_dataPoints.begin(), _dataPoints.end(),
-                                           (tempMZ - (_labelTolerance)),
-                                           DataPoint::MZComparison());
-
-        //ittreate throughout all labeledIons above in range
-        for(auto it = lowerBound; it != _dataPoints.end(); ++it)
-        {
-            if(it->getMZ() > (tempMZ + _labelTolerance))
-                break;
-
-            if(it->getTopAbundant()){
-                //check that it->mz is in range
-                bool inRange = utils::inRange(it->getMZ(), tempMZ, _labelTolerance);
-                if(inRange)
-                    rangeList.push_back(&(*it));
-            }//end of if
-        }
-        //else continue;
-
-        if(rangeList.empty())
+        size_t peak = matches[i];
+        if(peak == NO_INDEX)
             continue;
 
-        label = rangeList.begin();
-        if(rangeList.size() > 1)
-        {
-            //iterate through all ions within matchTolerance range to get the one with max intensity
-            double tempMax = (*label)->getIntensity();
-            double tempMZdiff = abs((*label)->getMZ() - tempMZ);
-            for(auto it = rangeList.begin(); it != rangeList.end(); ++it)
-            {
-                if(pars.getMultipleMatchCompare() == "intensity" || pars.getMultipleMatchCompare() == "int"){
-                    if((*it)->getIntensity() > tempMax)
-                    {
-                        label = it;
-                        tempMax = (*label)->getIntensity();
-                    }
-                }
-                else if(pars.getMultipleMatchCompare() == "mz"){
-                    if(((*it)->getMZ() - tempMZ) < tempMZdiff)
-                    {
-                        label = it;
-                        tempMZdiff = abs((*label)->getMZ() - tempMZ);
-                    }
-                }
-                else{
-                    throw std::runtime_error("Unknown multipleMatchCompare method!");
-                }
-            }
-        }
-
-        if((*label)->getLabeledIon() && pars.getVerbose()){
+        bool labeled = isLabeled(peak);
+        if(labeled && pars.getVerbose()){
             if(!seqPrinted){
                 std::cout << "In sequence: " << peptide.getFullSequence() << NEW_LINE;
                 seqPrinted = true;
             }
-            std::cout << "\tDuplicate label found: " << (*label)->getLabel() << ", " <<
+            std::cout << "\tDuplicate label found: " << getDataPoint(peak).getLabel() << ", " <<
                       peptide.getFragmentLabel(i) << NEW_LINE;
         }
 
         //if label is not already labeled or if peptide.getFragment(i) is not a NL
-        if(!(*label)->getLabeledIon() || peptide.getFragment(i).isNL())
+        if(!labeled || peptide.getFragment(i).isNL())
         {
             if(peptide.getIncludeLabel(i)) //only label spectrum if fragment should be labeled.
             {
-                (*label)->setLabel(peptide.getFragmentLabel(i));
-                (*label)->setFormatedLabel(peptide.getFormatedLabel(i));
-                (*label)->setLabeledIon(true);
-                (*label)->label.setIncludeLabel(true);
-                (*label)->setIonType(peptide.getFragment(i).getIonType());
-                (*label)->setIonNum(peptide.getFragment(i).getNum());
+                DataPoint& label = getDataPoint(peak);
+                label.setLabel(peptide.getFragmentLabel(i));
+                label.setFormatedLabel(peptide.getFormatedLabel(i));
+                label.setLabeledIon(true);
+                label.label.setIncludeLabel(true);
+                label.setIonType(peptide.getFragment(i).getIonType());
+                label.setIonNum(peptide.getFragment(i).getNum());
                 labledCount++;
             }
         }
         peptide.setFound(i, true);
-        peptide.setFoundMZ(i, (*label)->getMZ());
-        peptide.setFoundIntensity(i, (*label)->getIntensity());
+        peptide.setFoundMZ(i, _peaks.mz[peak]);
+        peptide.setFoundIntensity(i, _peaks.intensity[peak]);
     }//end of for
     ionPercent = (double(labledCount) / double(len)) * 100;
 
@@ -449,30 +620,173 @@ void ms2::Spectrum::labelSpectrum(PeptideNamespace::Peptide& peptide,
 
 }//end of function
 
+//! Get the rule used to choose between multiple peaks in range of a fragment.
+ms2::Spectrum::MultipleMatchCompare ms2::Spectrum::getMultipleMatchCompare(const base::ParamsBase& pars)
+{
+    std::string compareStr = pars.getMultipleMatchCompare();
+    if(compareStr == "intensity" || compareStr == "int")
+        return MultipleMatchCompare::INTENSITY;
+    else if(compareStr == "mz")
+        return MultipleMatchCompare::MZ;
+    return MultipleMatchCompare::UNKNOWN;
+}
+
+/**
+ * Choose the peak matched by a fragment from the peaks in its match tolerance.
+ * Only top abundant peaks are considered. If more than one is in range, one is chosen using \p compare.
+ * @param mz Fragment m/z.
+ * @param begin Index of first peak in range.
+ * @param end Index after last peak in range.
+ * @param compare Rule used to choose between multiple peaks.
+ * @return Index of matching peak, or NO_INDEX if no peak matches.
+ */
+size_t ms2::Spectrum::bestMatch(double mz, size_t begin, size_t end, MultipleMatchCompare compare) const
+{
+    const utils::msInterface::ScanMZ* mzs = _peaks.mz.data();
+    const utils::msInterface::ScanIntensity* intensities = _peaks.intensity.data();
+    const unsigned char* flags = _peaks.flags.data();
+
+    size_t label = NO_INDEX;
+    double tempMax = 0;
+    double tempMZdiff = 0;
+    for(size_t j = begin; j < end; j++)
+    {
+        if(!(flags[j] & PEAK_TOP_ABUNDANT))
+            continue;
+
+        if(label == NO_INDEX){
+            label = j;
+            tempMax = intensities[j];
+            tempMZdiff = abs(mzs[j] - mz);
+            continue;
+        }
+
+        //more than one peak is in range
+        if(compare == MultipleMatchCompare::INTENSITY){
+            if(intensities[j] > tempMax){
+                label = j;
+                tempMax = intensities[j];
+            }
+        }
+        else if(compare == MultipleMatchCompare::MZ){
+            //the signed difference is compared to the absolute difference of the current match
+            if((mzs[j] - mz) < tempMZdiff){
+                label = j;
+                tempMZdiff = abs(mzs[j] - mz);
+            }
+        }
+        else{
+            throw std::runtime_error("Unknown multipleMatchCompare method!");
+        }
+    }
+    return label;
+}
+
+/**
+ * Find the peak matched by each fragment of \p peptide. <br>
+ * Fragment m/z values are sorted once and merged with the peaks, which must already be sorted by m/z,
+ * so the peaks in range of every fragment are found in a single pass over the spectrum.
+ * If more than one top abundant peak is in range of a fragment, one is chosen using
+ * the multipleMatchCompare rule in \p pars.
+ * @param peptide Peptide with calculated fragments.
+ * @param pars Parameters with match tolerance and multipleMatchCompare rule.
+ * @param matches Populated with the index of the matching peak of each fragment, or NO_INDEX if no peak is in range.
+ */
+void ms2::Spectrum::matchFragments(const PeptideNamespace::Peptide& peptide,
+                                   const base::ParamsBase& pars,
+                                   std::vector<size_t>& matches) const
+{
+    size_t len = peptide.getNumFragments();
+    matches.assign(len, NO_INDEX);
+
+    //fragment m/z and index sorted by m/z
+    std::vector<std::pair<double, size_t> > fragments(len);
+    for(size_t i = 0; i < len; i++)
+        fragments[i] = std::make_pair(peptide.getFragmentMZ(i), i);
+    std::sort(fragments.begin(), fragments.end());
+    MultipleMatchCompare compare = getMultipleMatchCompare(pars);
+
+    //range of peaks in the match tolerance of each fragment
+    static_assert(std::is_same<utils::msInterface::ScanMZ, double>::value, "matchWindows::find requires double m/z values!");
+    std::vector<double> fragmentMZs(len);
+    for(size_t i = 0; i < len; i++)
+        fragmentMZs[i] = fragments[i].first;
+    double relTolerance, absTolerance;
+    pars.getMatchToleranceCoefficients(relTolerance, absTolerance);
+    std::vector<size_t> begins(len);
+    std::vector<size_t> ends(len);
+    matchWindows::find(fragmentMZs.data(), len, relTolerance, absTolerance,
+                       _peaks.mz.data(), _peaks.size(), begins.data(), ends.data());
+
+    for(size_t i = 0; i < len; i++)
+        matches[fragments[i].second] = bestMatch(fragments[i].first, begins[i], ends[i], compare);
+}
+
+/**
+ * Find the peak matched by each fragment of \p peptide using an MZBinIndex of the peaks. <br>
+ * Building the index is linear in the number of peaks, and the peaks in range of each fragment
+ * are found in constant time without sorting the fragments, so this is faster than
+ * Spectrum::matchFragments when there are many more fragments than peaks.
+ * The matches are the same as Spectrum::matchFragments.
+ * @param peptide Peptide with calculated fragments.
+ * @param pars Parameters with match tolerance and multipleMatchCompare rule.
+ * @param matches Populated with the index of the matching peak of each fragment, or NO_INDEX if no peak is in range.
+ */
+void ms2::Spectrum::matchFragmentsIndexed(const PeptideNamespace::Peptide& peptide,
+                                          const base::ParamsBase& pars,
+                                          std::vector<size_t>& matches) const
+{
+    size_t len = peptide.getNumFragments();
+    matches.assign(len, NO_INDEX);
+    MultipleMatchCompare compare = getMultipleMatchCompare(pars);
+
+    double relTolerance, absTolerance;
+    pars.getMatchToleranceCoefficients(relTolerance, absTolerance);
+    MZBinIndex index(_peaks.mz, relTolerance, absTolerance);
+
+    size_t begin, end;
+    for(size_t i = 0; i < len; i++)
+    {
+        double mz = peptide.getFragmentMZ(i);
+        index.find(mz, begin, end);
+        matches[i] = bestMatch(mz, begin, end, compare);
+    }
+}
+
 void ms2::Spectrum::makePoints(labels::Labels& labs, double maxPerc,
                                double offset_x, double offset_y,
                                double x_padding, double y_padding)
 {
-    for(auto & ion : _dataPoints)
+    //label data is created for all the drawn peaks first, so pointers to labels are not invalidated
+    size_t len = _peaks.size();
+    std::vector<size_t> drawn;
+    for(size_t i = 0; i < len; i++)
     {
-        if(ion.getIntensity() >= maxPerc || ion.getLabeledIon())
+        if(_ions[_peaks.ion[i]].getIntensity() >= maxPerc || isLabeled(i))
         {
-            if(!ion.getLabeledIon())
-            {
-                ion.setFormatedLabel(std::to_string(ion.getMZ()));
-                ion.setLabel(std::to_string(ion.getMZ()));
-                ion.label.setIncludeLabel(true);
-                ion.label.labelLoc = geometry::Rect(ion.getMZ() + offset_x,
-                                                    ion.getIntensity() + offset_y, x_padding, y_padding);
-            }
-            else {
-                ion.label.labelLoc = geometry::Rect(ion.getMZ() + offset_x,
-                                                    ion.getIntensity() + offset_y, x_padding, y_padding);
-            }
-            labs.push_back_labeledPoint(&(ion.label));
-            labs.push_back_dataPoint(geometry::Rect(ion.getMZ(), ion.getIntensity() / 2, POINT_PADDING,
-                                                    ion.getIntensity()));
+            getDataPoint(i);
+            drawn.push_back(i);
+        }
+    }
+
+    for(size_t i : drawn)
+    {
+        DataPoint& ion = _dataPoints[_peaks.dataPoint[i]];
+        if(!ion.getLabeledIon())
+        {
+            ion.setFormatedLabel(std::to_string(ion.getMZ()));
+            ion.setLabel(std::to_string(ion.getMZ()));
+            ion.label.setIncludeLabel(true);
+            ion.label.labelLoc = geometry::Rect(ion.getMZ() + offset_x,
+                                                ion.getIntensity() + offset_y, x_padding, y_padding);
+        }
+        else {
+            ion.label.labelLoc = geometry::Rect(ion.getMZ() + offset_x,
+                                                ion.getIntensity() + offset_y, x_padding, y_padding);
         }
+        labs.push_back_labeledPoint(&(ion.label));
+        labs.push_back_dataPoint(geometry::Rect(ion.getMZ(), ion.getIntensity() / 2, POINT_PADDING,
+                                                ion.getIntensity()));
     }
 }
 
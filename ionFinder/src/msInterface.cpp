@@ -27,44 +27,364 @@
 
 #include <msInterface.hpp>
 
+ms2::MsInterface::~MsInterface()
+{
+    {
+        std::lock_guard<std::mutex> lock(_memoryMutex);
+        _stopReaders = true;
+    }
+    _memoryFreed.notify_all();
+    for(auto& reader: _readers)
+        if(reader.joinable()) reader.join();
+}
+
 /**
- * Read an individual MS file. If the file has already been read, the file will simply return true.
+ * Set where scan index files are stored. Must be called before any files are read.
+ * If \p scanIndexDir is empty, the user cache directory is used so index files
+ * are never written into data directories. If no cache directory can be found or
+ * created, scan index files are not used.
+ * @param useScanIndex Should scan index files be used?
+ * @param scanIndexDir Directory to store index files in.
+ */
+void ms2::MsInterface::setScanIndex(bool useScanIndex, const std::string& scanIndexDir)
+{
+    _useScanIndex = useScanIndex;
+    _scanIndexDir = scanIndexDir;
+    if(!_useScanIndex || !_scanIndexDir.empty()) return;
+
+    _scanIndexDir = ScanIndex::defaultIndexDir();
+    if(_scanIndexDir.empty() ||
+       (!utils::dirExists(_scanIndexDir) && !utils::mkdir(_scanIndexDir.c_str(), "-p"))){
+        std::cerr << "WARN: Could not find or create scan index cache directory. Scan index files will not be used.\n";
+        _useScanIndex = false;
+        _scanIndexDir = "";
+    }
+}
+
+/**
+ * Get the entry for \p fname, adding an empty entry if it does not exist yet.
  * This function is thread safe.
- * @param fname Path to file to read.
+ * @param fname MS file name.
+ * @return Entry for \p fname or nullptr if the file is not known and MsInterface is in ingest mode.
+ */
+ms2::MsInterface::FileEntryPtr ms2::MsInterface::getEntry(const std::string& fname)
+{
+    if(_ingesting) return findEntry(fname);
+
+    std::lock_guard<std::mutex> lock (mutex);
+    auto it = _ms2Map.find(fname);
+    if(it != _ms2Map.end()) return it->second;
+    return _ms2Map[fname] = makeEntry(fname);
+}
+
+/**
+ * Make a new entry for \p fname.
+ * @param fname MS file name.
+ * @return Entry which has not been read.
+ */
+ms2::MsInterface::FileEntryPtr ms2::MsInterface::makeEntry(const std::string& fname) const
+{
+    return std::make_shared<FileEntry>(fname, _useScanIndex ? ScanIndex::indexFname(fname, _scanIndexDir) : "");
+}
+
+/**
+ * Look up the entry for \p fname without adding it.
+ * In ingest mode the file map is never modified so no lock is needed.
+ * @param fname MS file name.
+ * @return Entry for \p fname or nullptr if it does not exist.
+ */
+ms2::MsInterface::FileEntryPtr ms2::MsInterface::findEntry(const std::string& fname) const
+{
+    if(_ingesting) {
+        auto it = _ms2Map.find(fname);
+        return it == _ms2Map.end() ? nullptr : it->second;
+    }
+
+    std::lock_guard<std::mutex> lock (mutex);
+    auto it = _ms2Map.find(fname);
+    return it == _ms2Map.end() ? nullptr : it->second;
+}
+
+/**
+ * Read the peak store for \p entry if there is one.
+ * If the store is corrupt or can not be read, a warning is printed, and the store is
+ * not used again for \p entry.
+ * @param entry Entry to read store for.
+ * @param scans Scans which are needed from the file.
+ * @param path Set to the path of the store if it was read.
+ * @return The store, or nullptr if the MS file should be read instead.
+ */
+ms2::MsInterface::MsFilePtr ms2::MsInterface::readStore(FileEntry& entry, const MsFile::ScanNumList& scans,
+                                                        std::string& path) const
+{
+    {
+        std::lock_guard<std::mutex> lock(entry.mutex);
+        if(entry.badStore) return nullptr;
+    }
+    std::string storeFname = PeakStore::findStore(entry.fname);
+    if(storeFname.empty()) return nullptr;
+
+    MsFilePtr store = std::make_shared<PeakStore>();
+    std::string error;
+    try {
+        if(!store->read(storeFname, entry.indexFname, scans))
+            error = "Could not open file.";
+    } catch(std::exception& e) {
+        error = e.what();
+    }
+    if(error.empty()) {
+        path = storeFname;
+        return store;
+    }
+
+    std::cerr << "\n\tWARN: Failed to read peak store: " << storeFname << NEW_LINE;
+    std::cerr << "\t\t" << error << NEW_LINE;
+    std::cerr << "\t\tReading " << entry.fname << " instead." << NEW_LINE;
+    std::lock_guard<std::mutex> lock(entry.mutex);
+    entry.badStore = true;
+    return nullptr;
+}
+
+/**
+ * Parse the file for \p entry if it is not already loaded. Threads which call load while
+ * another thread is parsing the file wait for it to finish. If the file was released by unload,
+ * it is parsed again. If parsing the file failed, it is not attempted again.
+ * If there is an up to date peak store for the file, the store is read instead.
+ * If the store can not be read, the MS file is read.
+ * After the file is loaded, the least recently used files are released if the memory limit is exceeded.
+ * @param entry Entry to load.
  * @return true if all file I/O was successful.
  */
-bool ms2::MsInterface::read(std::string fname)
+bool ms2::MsInterface::load(FileEntry& entry) const
 {
-    // Check if file already exists and exit if it does.
-    if(_ms2Map.find(fname) != _ms2Map.end()) return true;
+    {
+        std::unique_lock<std::mutex> lock(entry.mutex);
+        entry.loaded.wait(lock, [&entry](){ return entry.state != FileEntry::State::LOADING; });
+        if(entry.state == FileEntry::State::LOADED) return true;
+        if(entry.state == FileEntry::State::FAILED) return false;
+        entry.state = FileEntry::State::LOADING;
+    }
 
-    auto _file = std::shared_ptr<utils::msInterface::MsInterface>();
-    utils::msInterface::MsInterface::FileType fileType = utils::msInterface::MsInterface::getFileType(fname);
+    PROFILE_SCOPE("MsInterface::load");
+    bool success = false;
+    MsFilePtr _file;
+    size_t fileSize = 0;
+    try {
+        MsFile::ScanNumList scans;
+        {
+            std::lock_guard<std::mutex> lock(entry.mutex);
+            scans = entry.scans;
+        }
+
+        //use peak store written by convert subcommand if there is one
+        std::string path;
+        _file = readStore(entry, scans, path);
+        if(!_file) {
+            path = MsFile::findFile(entry.fname);
+            _file = makeFile(path);
+            if(!_file)
+                std::cerr << "Unknown file type for file " << entry.fname << NEW_LINE;
+            else if(!_file->read(path, entry.indexFname, scans)) {
+                std::cerr << "\n\tFailed to read: " << entry.fname << NEW_LINE;
+                std::cerr << "\t\tNo file found at: " << utils::absPath(entry.fname) << NEW_LINE;
+            }
+            else success = true;
+        }
+        else success = true;
+
+        if(success) {
+            std::ifstream inF(path, std::ios::binary | std::ios::ate);
+            if(inF) fileSize = size_t(inF.tellg());
+        }
+    } catch(std::exception& e) {
+        std::cerr << "\n\tFailed to read: " << entry.fname << NEW_LINE;
+        std::cerr << "\t\t" << e.what() << NEW_LINE;
+    }
+
+    size_t memory = success ? _file->getMemoryUsage() : 0;
+    {
+        std::lock_guard<std::mutex> lock(entry.mutex);
+        if(success) {
+            entry.file = _file;
+            entry.memory = memory;
+            entry.state = FileEntry::State::LOADED;
+        }
+        else entry.state = FileEntry::State::FAILED;
+    }
+    entry.loaded.notify_all();
+
+    if(success) {
+        entry.nBytes += fileSize;
+        entry.lastUsed = ++_clock;
+        _memoryUsed += memory;
+        enforceMemoryLimit(&entry);
+    }
+    return success;
+}
+
+/**
+ * Make a reader for the type of MS file \p fname is.
+ * @param fname Path of MS file.
+ * @return Reader which has not read \p fname, or nullptr if the file type is not known.
+ */
+ms2::MsInterface::MsFilePtr ms2::MsInterface::makeFile(const std::string& fname)
+{
+    utils::msInterface::MsInterface::FileType fileType = MsFile::getFileType(fname);
     if(fileType == utils::msInterface::MsInterface::FileType::MS2)
-        _file = std::make_shared<utils::msInterface::Ms2File>();
-    else if(fileType == utils::msInterface::MsInterface::FileType::MZXML)
-        _file = std::make_shared<utils::msInterface::MzXMLFile>();
-    else if(fileType == utils::msInterface::MsInterface::FileType::MZML)
-        _file = std::make_shared<utils::msInterface::MzMLFile>();
-    else {
-        std::cerr << "Unknown file type for file " << fname << NEW_LINE;
-        return false;
+        return std::make_shared<MappedMs2File>();
+    if(fileType == utils::msInterface::MsInterface::FileType::MZXML)
+        return std::make_shared<XmlMsFile>(XmlMsFile::Format::MZXML);
+    if(fileType == utils::msInterface::MsInterface::FileType::MZML)
+        return std::make_shared<XmlMsFile>(XmlMsFile::Format::MZML);
+    return nullptr;
+}
+
+/**
+ * Release the file for \p entry. Threads which are currently using the file keep it
+ * until they are finished.
+ * @param entry Entry to release.
+ * @param evict If true, the file is only released if no thread is using it and it has no outstanding scans.
+ * @return true if the file was released.
+ */
+bool ms2::MsInterface::unload(FileEntry& entry, bool evict) const
+{
+    {
+        std::lock_guard<std::mutex> lock(entry.mutex);
+        if(entry.state != FileEntry::State::LOADED) return false;
+        if(evict && (entry.users > 0 || entry.outstanding.load() > 0)) return false;
+        entry.file.reset();
+        entry.state = FileEntry::State::UNLOADED;
+        _memoryUsed -= entry.memory;
+        entry.memory = 0;
+    }
+    {
+        //reader threads check _memoryUsed while holding _memoryMutex, so they can not miss the notification
+        std::lock_guard<std::mutex> lock(_memoryMutex);
     }
-    if(!_file->read(fname)) {
-        std::cerr << "\n\tFailed to read: " << fname << NEW_LINE;
-        std::cerr << "\t\tNo file found at: " << utils::absPath(fname) << NEW_LINE;
+    _memoryFreed.notify_all();
+    return true;
+}
+
+/**
+ * Measure the memory used by the file for \p entry again.
+ * Mapped files use more memory as more of their pages are read.
+ * @param entry Entry to update.
+ */
+void ms2::MsInterface::updateMemory(FileEntry& entry) const
+{
+    std::lock_guard<std::mutex> lock(entry.mutex);
+    if(entry.state != FileEntry::State::LOADED) return;
+    size_t memory = entry.file->getMemoryUsage();
+    _memoryUsed += memory;
+    _memoryUsed -= entry.memory;
+    entry.memory = memory;
+}
+
+/**
+ * Release the least recently used files until the memory limit is no longer exceeded. <br>
+ * Files which are being used by a thread or have outstanding scans are not released,
+ * because releasing a file another thread holds does not free any memory, and a file
+ * with outstanding scans would have to be read again right away.
+ * @param keep Entry which should not be released.
+ */
+void ms2::MsInterface::enforceMemoryLimit(const FileEntry* keep) const
+{
+    if(_maxMemory == 0) return;
+    std::vector<FileEntryPtr> entries;
+    {
+        std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+        if(!_ingesting) lock.lock();
+        for(const auto& it: _ms2Map)
+            entries.push_back(it.second);
+    }
+    for(const auto& entry: entries)
+        updateMemory(*entry);
+
+    while(overMemoryLimit()) {
+        FileEntryPtr lru = nullptr;
+        for(const auto& entry: entries) {
+            if(entry.get() == keep) continue;
+            std::lock_guard<std::mutex> entryLock(entry->mutex);
+            if(entry->state != FileEntry::State::LOADED || entry->users > 0 ||
+               entry->outstanding.load() > 0) continue;
+            if(!lru || entry->lastUsed < lru->lastUsed)
+                lru = entry;
+        }
+        if(!lru) break;
+        unload(*lru, true);
+    }
+}
+
+/**
+ * Get the total size of all the files which have been read so far.
+ * This function is thread safe.
+ * @return Number of bytes.
+ */
+size_t ms2::MsInterface::getBytesRead() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t ret = 0;
+    for(const auto& entry: _ms2Map)
+        ret += entry.second->nBytes.load();
+    return ret;
+}
+
+/**
+ * Read an individual MS file. If the file has already been read, the file will simply return true.
+ * This function is thread safe.
+ * @param fname Path to file to read.
+ * @return true if all file I/O was successful.
+ */
+bool ms2::MsInterface::read(std::string fname)
+{
+    FileEntryPtr entry = getEntry(fname);
+    if(!entry) {
+        std::cerr << "\n\t" << fname << " was not included in ingested files!" << NEW_LINE;
         return false;
     }
+    return load(*entry);
+}
 
-    // lock mutex
-    std::lock_guard<std::mutex> lock (mutex);
-    _ms2Map[fname] = _file;
-    return true;
+/**
+ * Add the scans between \p begin and \p end to the list of scans needed from each file,
+ * and add the number of times each file occurs to the number of scans remaining for the file.
+ * When all the remaining scans for a file have been retrieved, the file is released.
+ * @param begin Starting iterator
+ * @param end Ending iterator
+ * @param request Should the scans also be counted as outstanding?
+ * If false, each scan must be requested with MsInterface::request before it is retrieved.
+ */
+void ms2::MsInterface::countScans(InputScanList::const_iterator begin, InputScanList::const_iterator end,
+                                  bool request)
+{
+    std::map<FileEntryPtr, MsFile::ScanNumList> newScans;
+    for(auto scan = begin; scan != end; scan++) {
+        FileEntryPtr entry = getEntry(scan->getPrecursor().getFile());
+        if(!entry) continue;
+        entry->remaining++;
+        if(request) entry->outstanding++;
+        newScans[entry].push_back(scan->getScanNum());
+    }
+    for(auto& it: newScans) {
+        FileEntry& entry = *it.first;
+        bool reload = false;
+        {
+            std::lock_guard<std::mutex> lock(entry.mutex);
+            entry.scans.insert(entry.scans.end(), it.second.begin(), it.second.end());
+            std::sort(entry.scans.begin(), entry.scans.end());
+            entry.scans.erase(std::unique(entry.scans.begin(), entry.scans.end()), entry.scans.end());
+            reload = entry.state == FileEntry::State::LOADED;
+        }
+        //a file which was loaded without the new scans has to be read again
+        if(reload) unload(entry);
+    }
 }
 
 /**
  * Read MS files from a range of Dtafilter::Scan iterators.
  * If a file name occurs more than once, it will only be read once.
+ * If the memory limit is reached, the rest of the files are only checked to exist,
+ * and are read when getScan needs them.
  * This function is thread safe.
  * @param begin Starting iterator
  * @param end Ending iterator
@@ -75,16 +395,21 @@ bool ms2::MsInterface::read(InputScanList::const_iterator begin, InputScanList::
     //first get unique names of ms2 files to read
     std::vector<std::string> fileNamesList;
     ms2::MsInterface::getUniqueFileList(fileNamesList, begin, end);
+    countScans(begin, end, true);
 
     //read ms2 files
     bool allSucess = true;
     size_t len = fileNamesList.size();
     for(size_t i = 0; i < len; i++) {
-        std::string _fname = fileNamesList[i];
-        bool fileRead = _ms2Map.find(_fname) == _ms2Map.end();
-        if(fileRead) {
-            if(!read(_fname)) allSucess = false;
+        if(_maxMemory > 0 && _memoryUsed.load() >= _maxMemory) {
+            if(!utils::fileExists(MsFile::findFile(fileNamesList[i])) &&
+               PeakStore::findStore(fileNamesList[i]).empty()) {
+                std::cerr << "\n\tFailed to read: " << fileNamesList[i] << NEW_LINE;
+                std::cerr << "\t\tNo file found at: " << utils::absPath(fileNamesList[i]) << NEW_LINE;
+                allSucess = false;
+            }
         }
+        else if(!read(fileNamesList[i])) allSucess = false;
     }
 
     if(!allSucess){
@@ -95,8 +420,129 @@ bool ms2::MsInterface::read(InputScanList::const_iterator begin, InputScanList::
     return true;
 }
 
+/**
+ * Start reading all the MS files between \p begin and \p end in the background. <br>
+ * Files are read concurrently by up to \p nThread threads, in the order
+ * they first occur between \p begin and \p end. This function returns as soon as the
+ * reader threads are started. getScan waits for the file it needs to finish reading,
+ * so scans from the first files can be processed while later files are still being read.
+ * If the memory limit is reached, reader threads wait for files to be released before
+ * reading the next file. <br>
+ * After ingest is called, files which were not between \p begin and \p end can not be read,
+ * and getScan does not need to lock the file map.
+ * @param begin Starting iterator
+ * @param end Ending iterator
+ * @param nThread Maximum number of files to read at once.
+ * @param readAhead If false, no reader threads are started. Instead each scan is requested with
+ * MsInterface::request shortly before it is needed, which reads its file if it is not loaded.
+ * @return false if ingest was already called.
+ */
+bool ms2::MsInterface::ingest(InputScanList::const_iterator begin, InputScanList::const_iterator end,
+                              unsigned int nThread, bool readAhead)
+{
+    std::vector<std::string> fileNamesList;
+    ms2::MsInterface::getUniqueFileList(fileNamesList, begin, end);
+
+    //add entries for all files before any readers are started
+    std::vector<FileEntryPtr> entries;
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        if(_ingesting) {
+            std::cerr << "MsInterface::ingest can only be called once!" << NEW_LINE;
+            return false;
+        }
+        for(const auto& fname: fileNamesList) {
+            auto it = _ms2Map.find(fname);
+            if(it == _ms2Map.end())
+                it = _ms2Map.emplace(fname, makeEntry(fname)).first;
+            entries.push_back(it->second);
+        }
+        _ingesting = true;
+    }
+    countScans(begin, end, readAhead);
+    if(!readAhead) return true;
+
+    //spawn reader threads which each take the next unread file
+    auto nextFile = std::make_shared<std::atomic<size_t> >(0);
+    size_t nReaders = std::min(size_t(nThread == 0 ? 1 : nThread), entries.size());
+    for(size_t i = 0; i < nReaders; i++) {
+        _readers.emplace_back([this, entries, nextFile, i](){
+            PROFILE_THREAD_NAME("ms reader " + std::to_string(i));
+            for(size_t j = (*nextFile)++; j < entries.size(); j = (*nextFile)++) {
+                //files which are being searched use more memory as their pages are read
+                enforceMemoryLimit(nullptr);
+                {
+                    std::unique_lock<std::mutex> lock(_memoryMutex);
+                    _memoryFreed.wait(lock, [this](){
+                        return _stopReaders || _maxMemory == 0 || _memoryUsed.load() < _maxMemory;
+                    });
+                    if(_stopReaders) return;
+                }
+                //skip files which were already finished by getScan
+                if(entries[j]->remaining.load() > 0)
+                    load(*entries[j]);
+            }
+        });
+    }
+
+    return true;
+}
+
+/**
+ * Mark a scan from \p fname as outstanding and read the file if it is not loaded. <br>
+ * Used when files are not read ahead by ingest. A file with outstanding scans is not released
+ * to stay under the memory limit until the scans are retrieved with getScan.
+ * This function is thread safe.
+ * @param fname MS file name.
+ * @return false if \p fname was not ingested or could not be read.
+ */
+bool ms2::MsInterface::request(const std::string& fname) const
+{
+    FileEntryPtr entry = findEntry(fname);
+    if(!entry) return false;
+    entry->outstanding++;
+    return load(*entry);
+}
+
+/**
+ * Retrieve a Scan from a file entry, reading the file if it is not loaded.
+ * While the scan is retrieved, the file can not be released to stay under the memory limit.
+ * After the last remaining scan for the file is retrieved, the file is released.
+ */
+bool ms2::MsInterface::getScan(FileEntry& entry, ms2::Spectrum& scan, size_t scanNum) const
+{
+    //the file could be released by another thread between load and getting the pointer
+    MsFilePtr file;
+    while(!file) {
+        if(!load(entry)) return false;
+        std::lock_guard<std::mutex> lock(entry.mutex);
+        file = entry.file;
+        if(file) entry.users++;
+    }
+    entry.lastUsed = ++_clock;
+
+    bool found = file->getScan(scanNum, scan);
+    {
+        std::lock_guard<std::mutex> lock(entry.mutex);
+        entry.users--;
+    }
+
+    size_t outstanding = entry.outstanding.load();
+    while(outstanding > 0 && !entry.outstanding.compare_exchange_weak(outstanding, outstanding - 1));
+    size_t remaining = entry.remaining.load();
+    while(remaining > 0 && !entry.remaining.compare_exchange_weak(remaining, remaining - 1));
+    if(remaining == 1) unload(entry);
+
+    if(!found){
+        std::cerr << NEW_LINE << "Error reading scan!" << NEW_LINE;
+        return false;
+    }
+    return true;
+}
+
 /**
  * Retrieve a Scan. If \p fname has not been read, the file will be read and stored before being parsed.
+ * If \p fname is being read by another thread, the function waits for it to finish.
  * Because this function is not const, if the file has to be read, the MsInterface object will be modified.
  * This function is thread save.
  * @param scan Empty Scan object to populate.
@@ -104,46 +550,65 @@ bool ms2::MsInterface::read(InputScanList::const_iterator begin, InputScanList::
  * @param scanNum Scan number to retrieve.
  * @return True if parsing scan was successful.
  */
-bool ms2::MsInterface::getScan(utils::msInterface::Scan& scan, std::string fname, size_t scanNum)
+bool ms2::MsInterface::getScan(ms2::Spectrum& scan, std::string fname, size_t scanNum)
 {
-    auto ms2FileIt = _ms2Map.find(fname);
-    if(ms2FileIt == _ms2Map.end()){
-        if(!read(fname)) return false;
-        ms2FileIt = _ms2Map.find(fname);
-    }
-    if(!ms2FileIt->second->getScan(scanNum, scan)){
-        std::cerr << NEW_LINE << "Error reading scan!" << NEW_LINE;
+    FileEntryPtr entry = getEntry(fname);
+    if(!entry) {
+        std::cerr << NEW_LINE << "Key error in Ms2Map!" << NEW_LINE;
         return false;
     }
-    return true;
+    return getScan(*entry, scan, scanNum);
 }
 
 /**
- * const qualified version of getScan. If \p fname has not been read, the function will return false.
+ * const qualified version of getScan. If \p fname has not been read or ingested, the function will return false.
+ * If the file was released to stay under the memory limit, it is read again.
  * @param scan Empty Scan object to populate.
  * @param fname MS file name.
  * @param scanNum Scan number to retrieve.
  * @return True if parsing scan was successful.
  */
-bool ms2::MsInterface::getScan(utils::msInterface::Scan& scan, std::string fname, size_t scanNum) const
+bool ms2::MsInterface::getScan(ms2::Spectrum& scan, std::string fname, size_t scanNum) const
 {
     //load spectrum
-    auto ms2FileIt = _ms2Map.find(fname);
-    if(ms2FileIt == _ms2Map.end()){
+    FileEntryPtr entry = findEntry(fname);
+    if(!entry){
         std::cerr << NEW_LINE << "Key error in Ms2Map!" << NEW_LINE;
         return false;
     }
-    if(!ms2FileIt->second->getScan(scanNum, scan)){
-        std::cerr << NEW_LINE << "Error reading scan!" << NEW_LINE;
-        return false;
-    }
-    return true;
+    return getScan(*entry, scan, scanNum);
+}
+
+/**
+ * Get the order to process scans between \p begin and \p end in. <br>
+ * Scans are grouped by precursor file, in the order each file first occurs,
+ * and sorted by scan number within each file.
+ * @param begin Starting iterator
+ * @param end Ending iterator
+ * @param order Populated with indices relative to \p begin.
+ */
+void ms2::MsInterface::groupScansByFile(InputScanList::const_iterator begin,
+                                        InputScanList::const_iterator end,
+                                        std::vector<size_t>& order)
+{
+    std::map<std::string, size_t> fileIndices;
+    std::vector<size_t> fileIndex;
+    for(auto scan = begin; scan != end; scan++)
+        fileIndex.push_back(fileIndices.emplace(scan->getPrecursor().getFile(), fileIndices.size()).first->second);
+
+    order.resize(fileIndex.size());
+    for(size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs){
+        if(fileIndex[lhs] != fileIndex[rhs]) return fileIndex[lhs] < fileIndex[rhs];
+        return (begin + lhs)->getScanNum() < (begin + rhs)->getScanNum();
+    });
 }
 
 //! Get a list of unique file names between \p begin and \p end
 void ms2::MsInterface::getUniqueFileList(std::vector<std::string> &fnames,
-                                         std::vector<Dtafilter::Scan>::const_iterator begin,
-                                         std::vector<Dtafilter::Scan>::const_iterator end) const
+                                         InputScanList::const_iterator begin,
+                                         InputScanList::const_iterator end)
 {
     fnames.clear();
     for(auto scan = begin; scan != end; scan++){
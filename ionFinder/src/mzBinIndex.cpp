@@ -0,0 +1,120 @@
+//
+// mzBinIndex.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <mzBinIndex.hpp>
+
+/**
+ * Build index of sorted m/z values.
+ * \param mzs m/z values sorted in ascending order.
+ * \param relative Match tolerance per unit m/z.
+ * \param absolute Constant match tolerance.
+ */
+ms2::MZBinIndex::MZBinIndex(const std::vector<double>& mzs, double relative, double absolute)
+{
+    _mzs = mzs.data();
+    _len = mzs.size();
+    _relative = relative;
+    _absolute = absolute;
+
+    double maxMZ = _len == 0 ? 0 : mzs.back();
+    _binWidth = 2 * (maxMZ * relative + absolute);
+    if(!(_binWidth > 0) || std::isinf(_binWidth))
+        _binWidth = 1;
+
+    _minBin = _len == 0 ? 0 : getBin(mzs.front());
+    _maxBin = _len == 0 ? -1 : getBin(mzs.back());
+    //the table is at most half full
+    size_t tableSize = 2;
+    while(tableSize < 2 * _len)
+        tableSize *= 2;
+    _table.assign(tableSize, Bin{0, 0, 0});
+
+    _nBins = 0;
+    for(size_t i = 0; i < _len;)
+    {
+        BinType bin = getBin(_mzs[i]);
+        size_t end = i + 1;
+        while(end < _len && getBin(_mzs[end]) == bin)
+            end++;
+
+        size_t slot = getSlot(bin);
+        while(_table[slot].end != 0)
+            slot = (slot + 1) & (tableSize - 1);
+        _table[slot] = Bin{bin, i, end};
+        _nBins++;
+        i = end;
+    }
+}
+
+//! Get bin \p bin or nullptr if it has no values.
+const ms2::MZBinIndex::Bin* ms2::MZBinIndex::findBin(BinType bin) const
+{
+    size_t mask = _table.size() - 1;
+    for(size_t slot = getSlot(bin); _table[slot].end != 0; slot = (slot + 1) & mask){
+        if(_table[slot].bin == bin)
+            return &_table[slot];
+    }
+    return nullptr;
+}
+
+/**
+ * Find the values in the match tolerance of \p mz. <br>
+ * Value i is in the window if mz - tolerance <= value <= mz + tolerance.
+ * Because the values are sorted, the values in the window are contiguous.
+ * \param mz m/z to search for.
+ * \param begin Set to index of the first value in the window.
+ * \param end Set to the index after the last value in the window. Equal to \p begin if the window is empty.
+ */
+void ms2::MZBinIndex::find(double mz, size_t& begin, size_t& end) const
+{
+    double tolerance = mz * _relative + _absolute;
+    double minMZ = mz - tolerance;
+    double maxMZ = mz + tolerance;
+    begin = 0;
+    end = 0;
+    if(_len == 0 || maxMZ < _mzs[0] || minMZ > _mzs[_len - 1])
+        return;
+
+    BinType firstBin = std::max(getBin(minMZ), _minBin);
+    BinType lastBin = std::min(getBin(maxMZ), _maxBin);
+    bool found = false;
+    for(BinType bin = firstBin; bin <= lastBin; bin++)
+    {
+        const Bin* values = findBin(bin);
+        if(values == nullptr) continue;
+        for(size_t i = values->begin; i < values->end; i++)
+        {
+            if(_mzs[i] < minMZ) continue;
+            if(_mzs[i] > maxMZ) return;
+            if(!found){
+                begin = i;
+                found = true;
+            }
+            end = i + 1;
+        }
+    }
+}
@@ -132,6 +132,30 @@ double base::ParamsBase::getMatchTolerance(double mz) const
 	}
 }
 
+/**
+ \brief Get coefficients to calculate fragment ion tolerances.
+ 
+ The tolerance for an ion with m/z x is x * \p relative + \p absolute,
+ which is the same value returned by ParamsBase::getMatchTolerance(double mz) const.
+ \pre ParamsBase::_matchType != MatchType::UNKNOWN
+ \param relative Set to tolerance per unit m/z.
+ \param absolute Set to constant tolerance.
+ */
+void base::ParamsBase::getMatchToleranceCoefficients(double& relative, double& absolute) const
+{
+	if(_matchType == MatchType::TH){
+		relative = 0;
+		absolute = matchTolerance;
+	}
+	else if(_matchType == MatchType::PPM){
+		relative = matchTolerance / 1e6;
+		absolute = 0;
+	}
+	else{
+		throw std::runtime_error("Unknown match type!");
+	}
+}
+
 /**
  Print git version and date and time of last commit to \p out
  \param out stream to print to
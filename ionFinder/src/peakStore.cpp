@@ -0,0 +1,245 @@
+//
+// peakStore.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <peakStore.hpp>
+
+//peak arrays after the directory have to be aligned
+static_assert(sizeof(ms2::PeakStore::Header) % sizeof(double) == 0, "Invalid peak store header size");
+static_assert(sizeof(ms2::PeakStore::DirEntry) % sizeof(double) == 0, "Invalid peak store directory entry size");
+
+//! Total size of a peak store file with \p header.
+size_t ms2::PeakStore::fileSize(const Header& header)
+{
+    return sizeof(Header) + size_t(header.nScans) * sizeof(DirEntry) +
+           size_t(header.nPeaks) * sizeof(double) * 2 + size_t(header.stringsSize);
+}
+
+/**
+ * Get the peak store file to read for \p fname.
+ * @param fname Path of MS file.
+ * @return Path of peak store file, or an empty string if there is no store for \p fname
+ * or the store was written from a different version of \p fname.
+ */
+std::string ms2::PeakStore::findStore(const std::string& fname)
+{
+    std::string storeFname = fname + PEAK_STORE_EXT;
+    std::ifstream inF(storeFname, std::ios::binary);
+    if(!inF) return "";
+    Header header;
+    if(!inF.read(reinterpret_cast<char*>(&header), sizeof(Header)) ||
+       std::memcmp(header.magic, PEAK_STORE_MAGIC, sizeof(PEAK_STORE_MAGIC)) != 0)
+        return "";
+
+    //the MS file can be deleted after it is converted
+    ScanIndex::FileKey key;
+    if(ScanIndex::getFileKey(MsFile::findFile(fname), key) &&
+       (key.size != header.sourceSize || key.mtime != header.sourceMtime))
+        return "";
+    return storeFname;
+}
+
+/**
+ * Map a peak store file into memory.
+ * @param fname Path of peak store file.
+ * @param indexFname Not used.
+ * @param scans Not used.
+ * @return false if the file could not be mapped.
+ * @throws std::runtime_error if the file is not a valid peak store.
+ */
+bool ms2::PeakStore::read(const std::string& fname, const std::string& indexFname, const ScanNumList& scans)
+{
+    _header = nullptr;
+    _fname = fname;
+    if(fname.size() > PEAK_STORE_EXT.size() &&
+       fname.compare(fname.size() - PEAK_STORE_EXT.size(), PEAK_STORE_EXT.size(), PEAK_STORE_EXT) == 0)
+        _fname = fname.substr(0, fname.size() - PEAK_STORE_EXT.size());
+    if(!_file.open(fname)) return false;
+
+    const Header* header = reinterpret_cast<const Header*>(_file.begin());
+    if(_file.size() < sizeof(Header) ||
+       std::memcmp(header->magic, PEAK_STORE_MAGIC, sizeof(PEAK_STORE_MAGIC)) != 0 ||
+       header->nScans > _file.size() || header->nPeaks > _file.size() || header->stringsSize > _file.size() ||
+       fileSize(*header) != _file.size())
+        throw std::runtime_error(fname + " is not a valid peak store file!");
+
+    _dir = reinterpret_cast<const DirEntry*>(_file.begin() + sizeof(Header));
+    _mz = reinterpret_cast<const double*>(_dir + header->nScans);
+    _intensity = _mz + header->nPeaks;
+    _strings = reinterpret_cast<const char*>(_intensity + header->nPeaks);
+
+    for(uint64_t i = 0; i < header->nScans; i++){
+        const DirEntry& entry = _dir[i];
+        if((i > 0 && entry.scanNum <= _dir[i - 1].scanNum) ||
+           entry.peakOffset > header->nPeaks || entry.nPeaks > header->nPeaks - entry.peakOffset ||
+           uint64_t(entry.mzOffset) + entry.mzLen > header->stringsSize ||
+           uint64_t(entry.scanOffset) + entry.scanLen > header->stringsSize)
+            throw std::runtime_error("Invalid directory entry for scan " + std::to_string(entry.scanNum) +
+                                     " in " + fname);
+    }
+    _header = header;
+
+    //scans are requested in scan order, but most are skipped
+    _file.advise(MappedFile::Advice::RANDOM);
+    return true;
+}
+
+/**
+ * Find directory entry for \p scanNum.
+ * @param scanNum Scan number to search for.
+ * @return Pointer to entry or nullptr if \p scanNum is not in the store.
+ */
+const ms2::PeakStore::DirEntry* ms2::PeakStore::find(size_t scanNum) const
+{
+    if(_header == nullptr) return nullptr;
+    const DirEntry* end = _dir + _header->nScans;
+    const DirEntry* it = std::lower_bound(_dir, end, scanNum,
+                                          [](const DirEntry& lhs, size_t rhs){ return lhs.scanNum < rhs; });
+    if(it == end || it->scanNum != scanNum)
+        return nullptr;
+    return it;
+}
+
+/**
+ * Copy a single scan from the mapped file. <br>
+ * This function is thread safe.
+ * @param scanNum Scan number to retrieve.
+ * @param scan Spectrum to populate.
+ * @return false if \p scanNum is not in the store.
+ */
+bool ms2::PeakStore::getScan(size_t scanNum, ms2::Spectrum& scan) const
+{
+    const DirEntry* entry = find(scanNum);
+    if(entry == nullptr) return false;
+
+    scan.clear();
+    scan.setScanNum(scanNum);
+    utils::msInterface::PrecursorScan& precursorScan = precursor(scan);
+    precursorScan.setFile(_fname);
+    precursorScan.setSample(getSampleName());
+    precursorScan.setMZ(std::string(_strings + entry->mzOffset, entry->mzLen));
+    precursorScan.setScan(std::string(_strings + entry->scanOffset, entry->scanLen));
+    precursorScan.setRT(entry->rt);
+    precursorScan.setIntensity(entry->precursorIntensity);
+    precursorScan.setCharge(entry->charge);
+
+    std::vector<utils::msInterface::ScanIon>& scanIons = ions(scan);
+    scanIons.reserve(size_t(entry->nPeaks));
+    const double* mz = _mz + entry->peakOffset;
+    const double* intensity = _intensity + entry->peakOffset;
+    for(uint64_t i = 0; i < entry->nPeaks; i++){
+        scanIons.emplace_back();
+        scanIons.back().setMZ(utils::msInterface::ScanMZ(mz[i]));
+        scanIons.back().setIntensity(utils::msInterface::ScanIntensity(intensity[i]));
+    }
+    scan.updateRanges();
+    return true;
+}
+
+/**
+ * Get the scan numbers of all the scans in the store.
+ * @param scanNums Populated with sorted scan numbers.
+ */
+void ms2::PeakStore::getScanNums(ScanNumList& scanNums) const
+{
+    scanNums.clear();
+    if(_header == nullptr) return;
+    scanNums.reserve(size_t(_header->nScans));
+    for(uint64_t i = 0; i < _header->nScans; i++)
+        scanNums.push_back(size_t(_dir[i].scanNum));
+}
+
+/**
+ * Write every scan in \p file to a peak store. The store is written to a temporary file which is
+ * then renamed, so concurrent processes never see a partly written store.
+ * @param ofname Path of peak store file.
+ * @param file MS file which has been read with an empty list of needed scans.
+ * @param key Key of the MS file \p file was read from.
+ * @return true if all file I/O was successful.
+ */
+bool ms2::PeakStore::write(const std::string& ofname, const MsFile& file, const ScanIndex::FileKey& key)
+{
+    ScanNumList scanNums;
+    file.getScanNums(scanNums);
+
+    std::vector<DirEntry> dir;
+    dir.reserve(scanNums.size());
+    std::vector<double> mzs, intensities;
+    std::string strings;
+    ms2::Spectrum scan;
+    for(size_t scanNum: scanNums){
+        if(!file.getScan(scanNum, scan)) return false;
+        const utils::msInterface::PrecursorScan& precursorScan = precursor(scan);
+        const std::vector<utils::msInterface::ScanIon>& scanIons = ions(scan);
+
+        DirEntry entry;
+        std::memset(&entry, 0, sizeof(DirEntry));
+        entry.scanNum = scanNum;
+        entry.peakOffset = mzs.size();
+        entry.nPeaks = scanIons.size();
+        entry.rt = precursorScan.getRT();
+        entry.precursorIntensity = precursorScan.getIntensity();
+        entry.charge = int32_t(precursorScan.getCharge());
+        std::string mz = precursorScan.getMZ();
+        std::string precursorScanNum = precursorScan.getScan();
+        if(strings.size() + mz.size() + precursorScanNum.size() > UINT32_MAX) return false;
+        entry.mzOffset = uint32_t(strings.size());
+        entry.mzLen = uint32_t(mz.size());
+        strings.append(mz);
+        entry.scanOffset = uint32_t(strings.size());
+        entry.scanLen = uint32_t(precursorScanNum.size());
+        strings.append(precursorScanNum);
+        for(const auto& ion: scanIons){
+            mzs.push_back(double(ion.getMZ()));
+            intensities.push_back(double(ion.getIntensity()));
+        }
+        dir.push_back(entry);
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.magic, PEAK_STORE_MAGIC, sizeof(PEAK_STORE_MAGIC));
+    header.sourceSize = key.size;
+    header.sourceMtime = key.mtime;
+    header.nScans = dir.size();
+    header.nPeaks = mzs.size();
+    header.stringsSize = strings.size();
+
+    std::string tempFname = ofname + ".tmp" + std::to_string(getpid());
+    std::ofstream outF(tempFname, std::ios::binary);
+    if(!outF) return false;
+    outF.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    outF.write(reinterpret_cast<const char*>(dir.data()), dir.size() * sizeof(DirEntry));
+    outF.write(reinterpret_cast<const char*>(mzs.data()), mzs.size() * sizeof(double));
+    outF.write(reinterpret_cast<const char*>(intensities.data()), intensities.size() * sizeof(double));
+    outF.write(strings.data(), strings.size());
+    outF.close();
+    if(!outF || std::rename(tempFname.c_str(), ofname.c_str()) != 0){
+        std::remove(tempFname.c_str());
+        return false;
+    }
+    return true;
+}
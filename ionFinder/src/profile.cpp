@@ -0,0 +1,112 @@
+//
+// profile.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <profile.hpp>
+
+profile::Profiler& profile::Profiler::instance()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+//! Start recording events. Times are relative to when this is called.
+void profile::Profiler::start()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_startTime = ClockType::now();
+	_enabled = true;
+}
+
+/**
+ Get the buffer for the calling thread, creating it the first time a thread records an event.
+ */
+profile::ThreadBuffer& profile::Profiler::threadBuffer()
+{
+	thread_local ThreadBufferPtr buffer;
+	if(!buffer){
+		std::lock_guard<std::mutex> lock(_mutex);
+		buffer = std::make_shared<ThreadBuffer>(uint32_t(_buffers.size() + 1));
+		_buffers.push_back(buffer);
+	}
+	return *buffer;
+}
+
+/**
+ Write all recorded events in Chrome trace-event JSON format. <br>
+ Should only be called after all threads which record events are finished.
+ \param fname path of output file
+ \return true if file I/O was successful.
+ */
+bool profile::Profiler::write(const std::string& fname)
+{
+	std::ofstream outF(fname);
+	if(!outF) return false;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	outF.precision(3);
+	outF << std::fixed;
+	outF << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	for(const auto& buffer: _buffers){
+		std::string name = buffer->name.empty() ? "thread_" + std::to_string(buffer->tid) : buffer->name;
+		outF << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+			 << buffer->tid << ",\"args\":{\"name\":\"" << name << "\"}}";
+		first = false;
+		for(const auto& event: buffer->events){
+			outF << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+				 << ",\"ts\":" << event.begin << ",\"dur\":" << event.duration << "}";
+		}
+	}
+	outF << "\n]}\n";
+	return bool(outF);
+}
+
+//! Set name of calling thread in trace.
+void profile::setThreadName(const std::string& name)
+{
+	if(!Profiler::instance().getEnabled()) return;
+	Profiler::instance().threadBuffer().name = name;
+}
+
+/**
+ \param fname path of trace file to write. If empty, nothing is recorded.
+ */
+profile::Session::Session(std::string fname) : _fname(std::move(fname))
+{
+	if(_fname.empty()) return;
+	Profiler::instance().start();
+	setThreadName("main");
+}
+
+profile::Session::~Session()
+{
+	if(_fname.empty()) return;
+	Profiler::instance().stop();
+	if(Profiler::instance().write(_fname))
+		std::cout << "\nProfile written to: " << _fname << NEW_LINE;
+	else std::cerr << "\nFailed to write profile to: " << _fname << NEW_LINE;
+}
@@ -0,0 +1,206 @@
+//
+// scanIndex.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <scanIndex.hpp>
+
+template<typename _Tp>
+static void writeValue(std::string& buffer, _Tp value){
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(_Tp));
+}
+
+template<typename _Tp>
+static bool readValue(const std::string& buffer, size_t& pos, _Tp& value){
+    if(buffer.size() - pos < sizeof(_Tp)) return false;
+    std::memcpy(&value, buffer.data() + pos, sizeof(_Tp));
+    pos += sizeof(_Tp);
+    return true;
+}
+
+/**
+ * Get the path, size and modification time of \p fname.
+ * The modification time has nanosecond resolution where the platform provides it.
+ * @param fname Path to MS file.
+ * @param key Populated with key for \p fname.
+ * @return false if \p fname could not be stat'ed.
+ */
+bool ms2::ScanIndex::getFileKey(const std::string& fname, FileKey& key)
+{
+    struct stat st;
+    if(stat(fname.c_str(), &st) != 0) return false;
+    key.path = utils::absPath(fname);
+    key.size = uint64_t(st.st_size);
+#ifdef __APPLE__
+    key.mtime = int64_t(st.st_mtimespec.tv_sec) * 1000000000 + int64_t(st.st_mtimespec.tv_nsec);
+#elif defined(_WIN32)
+    key.mtime = int64_t(st.st_mtime) * 1000000000;
+#else
+    key.mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + int64_t(st.st_mtim.tv_nsec);
+#endif
+    return true;
+}
+
+/**
+ * Get the name of the sidecar index file for \p fname.
+ * @param fname Path to MS file.
+ * @param indexDir Directory to store index files in. If empty, the index is stored next to \p fname.
+ * Index files in \p indexDir include a hash of the absolute path of \p fname, so files
+ * with the same name in different directories do not share an index.
+ * @return Path of index file.
+ */
+std::string ms2::ScanIndex::indexFname(const std::string& fname, const std::string& indexDir)
+{
+    if(indexDir.empty())
+        return fname + SCAN_INDEX_EXT;
+
+    std::string path = utils::absPath(fname);
+    char hash[17];
+    snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)fnv1a::hash(path));
+    return indexDir + "/" + utils::baseName(fname) + "." + hash + SCAN_INDEX_EXT;
+}
+
+/**
+ * Get the directory index files are stored in when no directory is given, which is
+ * SCAN_INDEX_CACHE_DIR in $XDG_CACHE_HOME, or in ~/.cache if XDG_CACHE_HOME is not set.
+ * @return Absolute path of directory, or an empty string if there is no home directory.
+ */
+std::string ms2::ScanIndex::defaultIndexDir()
+{
+    const char* cacheDir = std::getenv("XDG_CACHE_HOME");
+    if(cacheDir != nullptr && cacheDir[0] == '/')
+        return std::string(cacheDir) + "/" + SCAN_INDEX_CACHE_DIR;
+    const char* home = std::getenv("HOME");
+    if(home != nullptr && home[0] != '\0')
+        return std::string(home) + "/.cache/" + SCAN_INDEX_CACHE_DIR;
+    return "";
+}
+
+/**
+ * Read index file written by ScanIndex::write.
+ * @param indexFname Path to index file.
+ * @param key Key of the MS file the index is for.
+ * @return false if the file does not exist, is corrupt, or was built from a different version of the MS file.
+ */
+bool ms2::ScanIndex::read(const std::string& indexFname, const FileKey& key)
+{
+    _entries.clear();
+    std::ifstream inF(indexFname, std::ios::binary);
+    if(!inF) return false;
+    std::stringstream ss;
+    ss << inF.rdbuf();
+    std::string buffer = ss.str();
+
+    //last 8 bytes are hash of everything before them
+    uint64_t hash = 0;
+    size_t pos = buffer.size() - sizeof(hash);
+    if(buffer.size() < sizeof(SCAN_INDEX_MAGIC) + sizeof(hash) ||
+       !readValue(buffer, pos, hash) ||
+       hash != fnv1a::hash(buffer.data(), buffer.size() - sizeof(hash)) ||
+       buffer.compare(0, sizeof(SCAN_INDEX_MAGIC), SCAN_INDEX_MAGIC, sizeof(SCAN_INDEX_MAGIC)) != 0)
+        return false;
+    buffer.resize(buffer.size() - sizeof(hash));
+
+    pos = sizeof(SCAN_INDEX_MAGIC);
+    FileKey fileKey;
+    uint32_t pathLen = 0;
+    if(!readValue(buffer, pos, pathLen) || buffer.size() - pos < pathLen) return false;
+    fileKey.path = buffer.substr(pos, pathLen);
+    pos += pathLen;
+    uint64_t nEntries = 0;
+    if(!readValue(buffer, pos, fileKey.size) ||
+       !readValue(buffer, pos, fileKey.mtime) ||
+       !readValue(buffer, pos, nEntries))
+        return false;
+    if(fileKey != key) return false;
+
+    _entries.resize(size_t(nEntries));
+    for(auto& entry: _entries){
+        if(!readValue(buffer, pos, entry.scanNum) ||
+           !readValue(buffer, pos, entry.offset)){
+            _entries.clear();
+            return false;
+        }
+    }
+    return pos == buffer.size();
+}
+
+/**
+ * Write index to \p indexFname. The index is written to a temporary file which is
+ * then renamed, so concurrent processes never see a partly written index.
+ * @param indexFname Path to index file.
+ * @param key Key of the MS file the index is for.
+ * @return true if the file was written.
+ */
+bool ms2::ScanIndex::write(const std::string& indexFname, const FileKey& key) const
+{
+    std::string buffer(SCAN_INDEX_MAGIC, sizeof(SCAN_INDEX_MAGIC));
+    writeValue(buffer, uint32_t(key.path.size()));
+    buffer.append(key.path);
+    writeValue(buffer, key.size);
+    writeValue(buffer, key.mtime);
+    writeValue(buffer, uint64_t(_entries.size()));
+    for(const auto& entry: _entries){
+        writeValue(buffer, entry.scanNum);
+        writeValue(buffer, entry.offset);
+    }
+    writeValue(buffer, fnv1a::hash(buffer));
+
+    std::string tempFname = indexFname + ".tmp" + std::to_string(getpid());
+    std::ofstream outF(tempFname, std::ios::binary);
+    if(!outF) return false;
+    outF.write(buffer.data(), buffer.size());
+    outF.close();
+    if(!outF || std::rename(tempFname.c_str(), indexFname.c_str()) != 0){
+        std::remove(tempFname.c_str());
+        return false;
+    }
+    return true;
+}
+
+//! Sort entries by scan number.
+void ms2::ScanIndex::sort()
+{
+    if(std::is_sorted(_entries.begin(), _entries.end(), [](const Entry& lhs, const Entry& rhs){
+        return lhs.scanNum < rhs.scanNum;
+    })) return;
+    std::stable_sort(_entries.begin(), _entries.end(), [](const Entry& lhs, const Entry& rhs){
+        return lhs.scanNum < rhs.scanNum;
+    });
+}
+
+/**
+ * Find entry for \p scanNum. sort must be called before find.
+ * @param scanNum Scan number to search for.
+ * @return Pointer to entry or nullptr if \p scanNum is not in the index.
+ */
+const ms2::ScanIndex::Entry* ms2::ScanIndex::find(size_t scanNum) const
+{
+    auto it = std::lower_bound(_entries.begin(), _entries.end(), scanNum,
+                               [](const Entry& lhs, size_t rhs){ return lhs.scanNum < rhs; });
+    if(it == _entries.end() || it->scanNum != scanNum)
+        return nullptr;
+    return &(*it);
+}
@@ -0,0 +1,151 @@
+//
+// scanPrefetcher.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <scanPrefetcher.hpp>
+
+/**
+ * Start prefetch threads.
+ * @param msInterface MsInterface to retrieve scans from. Files must already be read or ingested.
+ * @param nThread Number of threads retrieving scans.
+ * @param depth Maximum number of scans each Queue can request ahead of the scan it is using.
+ */
+ms2::ScanPrefetcher::ScanPrefetcher(const MsInterface& msInterface, unsigned int nThread, size_t depth)
+        : _msInterface(msInterface)
+{
+    _depth = depth;
+    _stop = false;
+    for(unsigned int i = 0; i < (nThread == 0 ? 1 : nThread); i++)
+        _threads.emplace_back(&ScanPrefetcher::run, this, i);
+}
+
+ms2::ScanPrefetcher::~ScanPrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _requested.notify_all();
+    for(auto& thread: _threads)
+        if(thread.joinable()) thread.join();
+}
+
+//! Retrieve requested scans until the prefetcher is destroyed.
+void ms2::ScanPrefetcher::run(unsigned int threadIndex)
+{
+    PROFILE_THREAD_NAME("prefetch " + std::to_string(threadIndex));
+    while(true) {
+        Request* request = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _requested.wait(lock, [this](){ return _stop || !_requests.empty(); });
+            if(_requests.empty()) return;
+            request = _requests.front();
+            _requests.pop_front();
+        }
+
+        bool success = false;
+        try {
+            PROFILE_SCOPE("MsInterface::getScan");
+            success = _msInterface.getScan(request->spectrum, request->fname, request->scanNum);
+        } catch(std::exception& e) {
+            std::cerr << NEW_LINE << e.what() << NEW_LINE;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            request->success = success;
+            request->done = true;
+        }
+        _finished.notify_all();
+    }
+}
+
+/**
+ * Make an empty queue with room for the scan being used and ScanPrefetcher::getDepth scans ahead of it.
+ */
+ms2::ScanPrefetcher::Queue::Queue(ScanPrefetcher& prefetcher) : _prefetcher(prefetcher)
+{
+    _front = 0;
+    _size = 0;
+    for(size_t i = 0; i < prefetcher.getDepth() + 1; i++)
+        _slots.emplace_back(new Request());
+}
+
+//! Wait for any scans still being retrieved, because prefetch threads write to them.
+ms2::ScanPrefetcher::Queue::~Queue()
+{
+    std::unique_lock<std::mutex> lock(_prefetcher._mutex);
+    _prefetcher._finished.wait(lock, [this](){
+        for(const auto& slot: _slots)
+            if(!slot->done) return false;
+        return true;
+    });
+}
+
+/**
+ * Request a scan. Must not be called when the queue is full.
+ * @param fname MS file name.
+ * @param scanNum Scan number to retrieve.
+ */
+void ms2::ScanPrefetcher::Queue::push(const std::string& fname, size_t scanNum)
+{
+    Request* request = _slots[(_front + _size) % _slots.size()].get();
+    _size++;
+    request->fname = fname;
+    request->scanNum = scanNum;
+    request->success = false;
+    {
+        std::lock_guard<std::mutex> lock(_prefetcher._mutex);
+        request->done = false;
+        _prefetcher._requests.push_back(request);
+    }
+    _prefetcher._requested.notify_one();
+}
+
+/**
+ * Get the oldest requested scan, waiting for it to be retrieved.
+ * Must not be called when the queue is empty.
+ * @param success Set to false if the scan could not be retrieved.
+ * @return Spectrum which is valid until pop is called.
+ */
+ms2::Spectrum& ms2::ScanPrefetcher::Queue::front(bool& success)
+{
+    Request* request = _slots[_front].get();
+    {
+        std::unique_lock<std::mutex> lock(_prefetcher._mutex);
+        _prefetcher._finished.wait(lock, [request](){ return request->done; });
+    }
+    success = request->success;
+    return request->spectrum;
+}
+
+//! Remove the oldest scan, so its slot can be used by the next request.
+void ms2::ScanPrefetcher::Queue::pop()
+{
+    _front = (_front + 1) % _slots.size();
+    _size--;
+}
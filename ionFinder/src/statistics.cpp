@@ -45,9 +45,15 @@ double statistics::TDist::pdf(double x) const{
     return ret;
 }
 
-double statistics::TDist::pValue(double x) const{
-    auto fp = std::bind(&statistics::TDist::pdf, *this, std::placeholders::_1);
-    return  trapezium(0, x, fp) + 0.5;
+/**
+ * Cumulative distribution function of the student's t distribution.
+ * Calculated from the regularized incomplete beta function.
+ */
+double statistics::TDist::cdf(double x) const{
+    //_coeff is 1 / (sqrt(nu) * B(nu / 2, 1 / 2))
+    double lnBeta = -log(_coeff * sqrt(_nu));
+    double tail = 0.5 * regIncompleteBeta(_nu / (_nu + x * x), 0.5 * _nu, 0.5, lnBeta);
+    return x >= 0 ? 1.0 - tail : tail;
 }
 
 double statistics::NormDist::calcCoeff() const{
@@ -61,9 +67,101 @@ double statistics::NormDist::pdf(double x) const{
     return ret;
 }
 
-double statistics::NormDist::pValue(double x) const{
-    auto fp = std::bind(&statistics::NormDist::pdf, *this, std::placeholders::_1);
-    return trapezium(0, x, fp) + 0.5;
+//! Cumulative distribution function of the standard normal distribution
+double statistics::NormDist::cdf(double x) const{
+    return 0.5 * erfc(-x / sqrt(2.0));
+}
+
+/**
+ * Find the value with a cumulative probability of \p p by bisection.
+ * @param p Cumulative probability.
+ * @return quantile
+ */
+double statistics::ProbabilityDist::quantile(double p) const
+{
+    if(std::isnan(p)) return p;
+    if(p <= 0) return -std::numeric_limits<double>::infinity();
+    if(p >= 1) return std::numeric_limits<double>::infinity();
+    if(p < 0.5) return -quantile(1 - p);
+
+    double lo = 0;
+    double hi = 1;
+    while(cdf(hi) < p){
+        lo = hi;
+        hi *= 2;
+        if(hi > 1e300) return std::numeric_limits<double>::infinity();
+    }
+    for(int i = 0; i < 200; i++){
+        double mid = 0.5 * (lo + hi);
+        if(mid <= lo || mid >= hi) break;
+        if(cdf(mid) < p) lo = mid;
+        else hi = mid;
+    }
+    return hi;
+}
+
+/**
+ * Calculate critical values for a confidence level.
+ * @param conf Confidence level.
+ * @param maxDf Max degrees of freedom to calculate t distribution critical values for.
+ */
+statistics::CriticalValues::CriticalValues(double conf, size_t maxDf)
+{
+    _conf = conf;
+    _norm = NormDist().quantile(conf);
+    _t.resize(maxDf + 1, std::numeric_limits<double>::quiet_NaN());
+    for(size_t df = 1; df <= maxDf; df++)
+        _t[df] = TDist(double(df)).quantile(conf);
+}
+
+//! Critical value of the t distribution with \p df degrees of freedom
+double statistics::CriticalValues::t(size_t df) const
+{
+    if(df == 0) return std::numeric_limits<double>::quiet_NaN();
+    if(df < _t.size()) return _t[df];
+    return TDist(double(df)).quantile(_conf);
+}
+
+/**
+ * Regularized incomplete beta function I_x(a, b).
+ * The continued fraction is evaluated with the modified Lentz's method.
+ * @param x Upper limit of integration in [0, 1].
+ * @param a
+ * @param b
+ * @param lnBeta Natural log of the beta function B(a, b).
+ * @return I_x(a, b)
+ */
+double statistics::regIncompleteBeta(double x, double a, double b, double lnBeta)
+{
+    if(x <= 0) return 0;
+    if(x >= 1) return 1;
+
+    //the continued fraction converges quickly for x < (a + 1) / (a + b + 2)
+    if(x > (a + 1) / (a + b + 2))
+        return 1 - regIncompleteBeta(1 - x, b, a, lnBeta);
+
+    const double tiny = 1e-300;
+    const double eps = 1e-15;
+    double front = exp(a * log(x) + b * log(1 - x) - lnBeta) / a;
+
+    double f = 1, c = 1, d = 0;
+    for(int i = 0; i <= 300; i++){
+        int m = i / 2;
+        double num;
+        if(i == 0) num = 1;
+        else if(i % 2 == 0) num = (m * (b - m) * x) / ((a + 2.0 * m - 1) * (a + 2.0 * m));
+        else num = -((a + m) * (a + b + m) * x) / ((a + 2.0 * m) * (a + 2.0 * m + 1));
+
+        d = 1 + num * d;
+        if(fabs(d) < tiny) d = tiny;
+        d = 1 / d;
+        c = 1 + num / c;
+        if(fabs(c) < tiny) c = tiny;
+        double cd = c * d;
+        f *= cd;
+        if(fabs(1 - cd) < eps) break;
+    }
+    return front * (f - 1);
 }
 
 /**
@@ -82,3 +180,49 @@ double statistics::trapezium(double a, double b, std::function<double(double)> f
     integral *= dx / 2.0;
     return integral;
 }
+
+//! Add or remove the value at \p index in the window.
+void statistics::WindowQuantiles::update(size_t index, bool add)
+{
+    size_t len = _sorted.size();
+    for(size_t i = _rank[index] + 1; i <= len; i += i & (~i + 1)){
+        if(add) _tree[i]++;
+        else _tree[i]--;
+    }
+    if(add) _size++;
+    else _size--;
+}
+
+/**
+ * Get the kth smallest value in the window.
+ * @param k Zero based rank of value in window. Must be less than size().
+ * @return kth smallest value
+ */
+double statistics::WindowQuantiles::kth(size_t k) const
+{
+    size_t len = _sorted.size();
+    size_t pos = 0;
+    for(size_t step = _highBit; step > 0; step /= 2){
+        if(pos + step <= len && _tree[pos + step] <= k){
+            pos += step;
+            k -= _tree[pos];
+        }
+    }
+    return _sorted[pos];
+}
+
+/**
+ * Get quantile \p p of the values in the window.
+ * Values between ranks are linearly interpolated.
+ * @param p Probability in [0, 1].
+ * @return quantile, or NaN if the window is empty.
+ */
+double statistics::WindowQuantiles::quantile(double p) const
+{
+    if(_size == 0) return std::numeric_limits<double>::quiet_NaN();
+    double h = p * double(_size - 1);
+    auto lo = size_t(h);
+    if(lo + 1 >= _size) return kth(_size - 1);
+    double loValue = kth(lo);
+    return loValue + (h - double(lo)) * (kth(lo + 1) - loValue);
+}
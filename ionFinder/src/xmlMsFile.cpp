@@ -0,0 +1,685 @@
+//
+// xmlMsFile.cpp
+// ionFinder
+// -----------------------------------------------------------------------------
+// MIT License
+// Copyright 2020 Aaron Maurais
+// -----------------------------------------------------------------------------
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// -----------------------------------------------------------------------------
+//
+
+#include <xmlMsFile.hpp>
+
+//! Find \p str between \p begin and \p end. Returns nullptr if it is not found.
+static const char* findStr(const char* begin, const char* end, const char* str)
+{
+    if(begin == nullptr || begin >= end) return nullptr;
+    return static_cast<const char*>(memmem(begin, size_t(end - begin), str, strlen(str)));
+}
+
+//! Find the next start tag named \p name between \p begin and \p end.
+static const char* findTag(const char* begin, const char* end, const char* name)
+{
+    std::string str = std::string("<") + name;
+    for(const char* pos = findStr(begin, end, str.c_str()); pos != nullptr;
+        pos = findStr(pos + 1, end, str.c_str()))
+    {
+        const char* next = pos + str.size();
+        if(next < end && (*next == ' ' || *next == '\t' || *next == '\n' || *next == '\r' || *next == '>' || *next == '/'))
+            return pos;
+    }
+    return nullptr;
+}
+
+//! Find the end of a tag starting at \p begin.
+static const char* findTagEnd(const char* begin, const char* end)
+{
+    const char* ret = static_cast<const char*>(std::memchr(begin, '>', size_t(end - begin)));
+    if(ret == nullptr) throw std::runtime_error("Unterminated tag");
+    return ret;
+}
+
+/**
+ * Get the value of an attribute in a tag.
+ * @param begin Beginning of tag.
+ * @param end End of tag.
+ * @param name Attribute name.
+ * @param value Set to attribute value.
+ * @return false if the attribute was not found.
+ */
+static bool getAttribute(const char* begin, const char* end, const char* name, std::string& value)
+{
+    std::string str = std::string(" ") + name + "=\"";
+    const char* pos = findStr(begin, end, str.c_str());
+    if(pos == nullptr){
+        //attributes can also be separated by new lines
+        str[0] = '\n';
+        pos = findStr(begin, end, str.c_str());
+        if(pos == nullptr) return false;
+    }
+    pos += str.size();
+    const char* valueEnd = static_cast<const char*>(std::memchr(pos, '"', size_t(end - pos)));
+    if(valueEnd == nullptr) return false;
+    value.assign(pos, valueEnd);
+    return true;
+}
+
+//! Get the text between the end of the tag at \p begin and the next '<'.
+static std::string getText(const char* begin, const char* end)
+{
+    const char* textBegin = findTagEnd(begin, end) + 1;
+    const char* textEnd = static_cast<const char*>(std::memchr(textBegin, '<', size_t(end - textBegin)));
+    if(textEnd == nullptr) textEnd = end;
+    return utils::trim(std::string(textBegin, textEnd));
+}
+
+//! Is the processor little endian?
+static bool isLittleEndian()
+{
+    uint16_t value = 1;
+    unsigned char firstByte;
+    std::memcpy(&firstByte, &value, 1);
+    return firstByte == 1;
+}
+
+static uint32_t byteSwap(uint32_t value)
+{
+    return __builtin_bswap32(value);
+}
+static uint64_t byteSwap(uint64_t value)
+{
+    return __builtin_bswap64(value);
+}
+
+//! Call \p set with the index and value of \p n floating point numbers starting every \p stride bytes of \p data.
+template<typename _Float, typename _UInt, typename _Fn>
+static void readValues(const char* data, size_t n, size_t stride, bool swap, _Fn set)
+{
+    static_assert(sizeof(_Float) == sizeof(_UInt), "Float and integer types must be the same size!");
+    for(size_t i = 0; i < n; i++){
+        _UInt bits;
+        std::memcpy(&bits, data + i * stride, sizeof(bits));
+        if(swap) bits = byteSwap(bits);
+        _Float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        set(i, double(value));
+    }
+}
+
+/**
+ * Read \p n floating point numbers from decoded binary data.
+ * @param data Decoded data.
+ * @param n Number of values.
+ * @param width Size of each value in bytes. Either 4 or 8.
+ * @param stride Bytes between the beginning of each value.
+ * @param bigEndian Are values big endian?
+ * @param set Called with the index and value of each number.
+ */
+template<typename _Fn>
+static void readValues(const char* data, size_t n, size_t width, size_t stride, bool bigEndian, _Fn set)
+{
+    bool swap = bigEndian == isLittleEndian();
+    if(width == 8) readValues<double, uint64_t>(data, n, stride, swap, set);
+    else readValues<float, uint32_t>(data, n, stride, swap, set);
+}
+
+/**
+ * Decodes the binary data arrays of a file into buffers which are reused for each array,
+ * so arrays are decoded without allocating memory after the first few scans.
+ */
+class ms2::XmlMsFile::BinaryDecoder {
+private:
+    std::vector<char> _decoded;
+    std::vector<char> _inflated;
+#ifdef ENABLE_ZLIB
+    z_stream _stream;
+    bool _streamInit;
+#endif
+
+    const char* inflate(size_t size, size_t expectedSize, size_t& outSize);
+
+public:
+    BinaryDecoder() {
+#ifdef ENABLE_ZLIB
+        std::memset(&_stream, 0, sizeof(_stream));
+        _streamInit = false;
+#endif
+    }
+    BinaryDecoder(const BinaryDecoder&) = delete;
+    BinaryDecoder& operator = (const BinaryDecoder&) = delete;
+    ~BinaryDecoder() {
+#ifdef ENABLE_ZLIB
+        if(_streamInit) inflateEnd(&_stream);
+#endif
+    }
+
+    const char* decode(const char* begin, const char* end, bool compressed, size_t expectedSize, size_t& size);
+};
+
+/**
+ * Decode base64 text and decompress it if it is zlib compressed.
+ * @param begin Beginning of base64 text.
+ * @param end End of base64 text.
+ * @param compressed Is the data zlib compressed?
+ * @param expectedSize Expected size of decoded data.
+ * @param size Set to size of decoded data.
+ * @return Decoded data, which is valid until decode is called again.
+ */
+const char* ms2::XmlMsFile::BinaryDecoder::decode(const char* begin, const char* end, bool compressed, size_t expectedSize, size_t& size)
+{
+    size_t capacity = base64::decodedSize(size_t(end - begin)) + base64::DECODE_PADDING;
+    if(_decoded.size() < capacity) _decoded.resize(capacity);
+    size = base64::decode(begin, end, _decoded.data());
+    if(!compressed) return _decoded.data();
+    return inflate(size, expectedSize, size);
+}
+
+/**
+ * Decompress the first \p size bytes of the decoded buffer.
+ * @param size Size of compressed data.
+ * @param expectedSize Expected size of uncompressed data.
+ * @param outSize Set to size of uncompressed data.
+ * @return Uncompressed data.
+ */
+const char* ms2::XmlMsFile::BinaryDecoder::inflate(size_t size, size_t expectedSize, size_t& outSize)
+{
+#ifdef ENABLE_ZLIB
+    if(!_streamInit) {
+        if(inflateInit(&_stream) != Z_OK)
+            throw std::runtime_error("Failed to initialize zlib");
+        _streamInit = true;
+    }
+    else inflateReset(&_stream);
+
+    size_t capacity = std::max(expectedSize, size * 2);
+    if(_inflated.size() < capacity) _inflated.resize(capacity);
+    _stream.next_in = reinterpret_cast<Bytef*>(_decoded.data());
+    _stream.avail_in = uInt(size);
+    _stream.next_out = reinterpret_cast<Bytef*>(_inflated.data());
+    _stream.avail_out = uInt(_inflated.size());
+    for(;;){
+        int ret = ::inflate(&_stream, Z_FINISH);
+        if(ret == Z_STREAM_END) break;
+        if((ret != Z_OK && ret != Z_BUF_ERROR) || _stream.avail_out != 0 || _inflated.size() > (size_t(1) << 34))
+            throw std::runtime_error("Failed to decompress binary data");
+        size_t done = _inflated.size();
+        _inflated.resize(done * 2);
+        _stream.next_out = reinterpret_cast<Bytef*>(_inflated.data() + done);
+        _stream.avail_out = uInt(_inflated.size() - done);
+    }
+    outSize = size_t(_stream.total_out);
+    return _inflated.data();
+#else
+    throw std::runtime_error("Binary data is zlib compressed, but ionFinder was built without zlib");
+#endif
+}
+
+//! Number of seconds in a minute, the unit of retention times in .ms2 files.
+static double const SECONDS_PER_MINUTE = 60;
+
+/**
+ * Parse an xs:duration such as "PT1234.5S" into minutes.
+ */
+static double parseDuration(const std::string& str)
+{
+    double ret = 0;
+    const char* pos = str.c_str();
+    while(*pos != '\0' && (*pos == 'P' || *pos == 'T')) pos++;
+    while(*pos != '\0'){
+        char* next = nullptr;
+        double value = std::strtod(pos, &next);
+        if(next == pos) break;
+        if(*next == 'H') ret += value * 3600;
+        else if(*next == 'M') ret += value * 60;
+        else ret += value;
+        pos = *next == '\0' ? next : next + 1;
+    }
+    return ret / SECONDS_PER_MINUTE;
+}
+
+/**
+ * Convert an mzML time to minutes.
+ * @param value Time value.
+ * @param unitName Unit name of value. If empty, \p value is assumed to be in minutes.
+ * @return time in minutes
+ */
+static double timeToMinutes(double value, const std::string& unitName)
+{
+    if(unitName == "second")
+        return value / SECONDS_PER_MINUTE;
+    if(unitName == "hour")
+        return value * 60;
+    return value;
+}
+
+/**
+ * Read \p fname, only storing the scans in \p scans. <br>
+ * If \p scans is not empty and the file has a valid offset index, only the needed scans are read.
+ * @param fname Path of mzML or mzXML file, which can be gzip or BGZF compressed.
+ * @param indexFname Not used.
+ * @param scans Scans which will be requested from the file. If empty, every scan is stored.
+ * @return true if the file was successfully read.
+ */
+bool ms2::XmlMsFile::read(const std::string& fname, const std::string& indexFname, const ScanNumList& scans)
+{
+    _fname = fname;
+    _scans.clear();
+    _memoryUsage = 0;
+
+    DataFile file;
+    if(!file.open(fname)) return false;
+    bool indexed = false;
+    if(!scans.empty()){
+        file.advise(MappedFile::Advice::RANDOM);
+        indexed = readIndexed(file, scans);
+    }
+    if(!indexed){
+        _scans.clear();
+        file.advise(MappedFile::Advice::SEQUENTIAL);
+        std::string buffer;
+        const char* begin = file.begin();
+        const char* end = file.end();
+        if(!file.isContiguous()) {
+            //the whole file is parsed, so all the BGZF blocks are decompressed at once
+            file.readAll(buffer);
+            file.close();
+            begin = buffer.data();
+            end = buffer.data() + buffer.size();
+        }
+        if(_format == Format::MZML)
+            parseMzML(begin, end, scans);
+        else parseMzXML(begin, end, scans);
+    }
+
+    for(const auto& scan: _scans)
+        _memoryUsage += sizeof(StoredScan) + scan.second.ions.capacity() * sizeof(utils::msInterface::ScanIon);
+    return true;
+}
+
+/**
+ * Get the scan number of a spectrum or scan from its start tag. <br>
+ * For mzML, the scan number is read from the native id of the spectrum, or is the spectrum index + 1
+ * if the native id does not have a scan number.
+ * @param tagBegin Beginning of start tag.
+ * @param tagEnd End of start tag.
+ * @return Scan number or 0 if the tag has none.
+ */
+size_t ms2::XmlMsFile::getScanNum(const char* tagBegin, const char* tagEnd) const
+{
+    std::string value;
+    if(_format == Format::MZXML){
+        if(getAttribute(tagBegin, tagEnd, "num", value))
+            return std::strtoul(value.c_str(), nullptr, 10);
+        return 0;
+    }
+    if(getAttribute(tagBegin, tagEnd, "id", value) && value.find("scan=") != std::string::npos)
+        return std::strtoul(value.c_str() + value.find("scan=") + 5, nullptr, 10);
+    if(getAttribute(tagBegin, tagEnd, "index", value))
+        return std::strtoul(value.c_str(), nullptr, 10) + 1;
+    return 0;
+}
+
+/**
+ * Read the offset index at the end of an indexed mzML or mzXML file.
+ * @param file Open file.
+ * @param index Populated with the scan number and offset of each spectrum or scan, sorted by scan number.
+ * @param indexOffset Set to the offset of the index, which is where the last element ends.
+ * @return false if the file does not have an offset index.
+ */
+bool ms2::XmlMsFile::readOffsetIndex(const DataFile& file, std::vector<IndexEntry>& index, uint64_t& indexOffset) const
+{
+    index.clear();
+    const bool mzML = _format == Format::MZML;
+
+    //offset of index is at the end of the file
+    std::string buffer;
+    size_t tailSize = std::min(file.size(), size_t(4096));
+    const char* tail = file.read(file.size() - tailSize, tailSize, buffer);
+    const char* tailEnd = tail + tailSize;
+    const char* offsetTag = mzML ? "<indexListOffset>" : "<indexOffset>";
+    const char* pos = findStr(tail, tailEnd, offsetTag);
+    if(pos == nullptr) return false;
+    char* next = nullptr;
+    indexOffset = std::strtoull(pos + strlen(offsetTag), &next, 10);
+    if(next == pos + strlen(offsetTag) || indexOffset == 0 || indexOffset >= file.size()) return false;
+
+    size_t indexSize = file.size() - size_t(indexOffset);
+    const char* begin = file.read(size_t(indexOffset), indexSize, buffer);
+    const char* end = begin + indexSize;
+    //some writers point to the white space before the index
+    while(begin < end && std::isspace(static_cast<unsigned char>(*begin))) begin++;
+    if(findTag(begin, end, mzML ? "indexList" : "index") != begin) return false;
+
+    //only the index of spectra is used in mzML files
+    std::string value;
+    const char* list = nullptr;
+    for(const char* tag = findTag(begin, end, "index"); tag != nullptr; tag = findTag(tag + 1, end, "index")){
+        const char* tagEnd = static_cast<const char*>(std::memchr(tag, '>', size_t(end - tag)));
+        if(tagEnd == nullptr) return false;
+        if(getAttribute(tag, tagEnd, "name", value) && value == (mzML ? "spectrum" : "scan")){
+            list = tagEnd;
+            break;
+        }
+    }
+    if(list == nullptr) return false;
+    const char* listEnd = findStr(list, end, "</index>");
+    if(listEnd == nullptr) return false;
+
+    for(const char* offset = findTag(list, listEnd, "offset"); offset != nullptr;
+        offset = findTag(offset + 1, listEnd, "offset"))
+    {
+        const char* tagEnd = static_cast<const char*>(std::memchr(offset, '>', size_t(listEnd - offset)));
+        if(tagEnd == nullptr) return false;
+        IndexEntry entry;
+        if(mzML){
+            if(getAttribute(offset, tagEnd, "idRef", value) && value.find("scan=") != std::string::npos)
+                entry.scanNum = std::strtoul(value.c_str() + value.find("scan=") + 5, nullptr, 10);
+            else entry.scanNum = index.size() + 1;
+        }
+        else {
+            if(!getAttribute(offset, tagEnd, "id", value)) return false;
+            entry.scanNum = std::strtoul(value.c_str(), nullptr, 10);
+        }
+        entry.offset = std::strtoull(tagEnd + 1, nullptr, 10);
+        if(entry.offset >= indexOffset) return false;
+        index.push_back(entry);
+    }
+    if(index.empty()) return false;
+
+    //if a scan number is in the index more than once, the last one is used like when the whole file is parsed
+    std::stable_sort(index.begin(), index.end());
+    return true;
+}
+
+/**
+ * Read the needed scans using the offset index of \p file.
+ * @param file Open file.
+ * @param scans Sorted list of needed scans.
+ * @return false if the file has no offset index, the index does not match the file,
+ * or a needed scan is not in the index.
+ */
+bool ms2::XmlMsFile::readIndexed(const DataFile& file, const ScanNumList& scans)
+{
+    std::vector<IndexEntry> index;
+    uint64_t indexOffset = 0;
+    if(!readOffsetIndex(file, index, indexOffset)) return false;
+
+    //each element ends at the beginning of the next one
+    std::vector<uint64_t> offsets;
+    offsets.reserve(index.size());
+    for(const auto& entry: index)
+        offsets.push_back(entry.offset);
+    std::sort(offsets.begin(), offsets.end());
+
+    const char* name = elementName();
+    BinaryDecoder decoder;
+    std::string buffer;
+    for(size_t scanNum: scans){
+        IndexEntry key;
+        key.scanNum = scanNum;
+        auto it = std::upper_bound(index.begin(), index.end(), key);
+        //the index could be incomplete, so the whole file is parsed to look for the scan
+        if(it == index.begin() || (it - 1)->scanNum != scanNum) return false;
+        uint64_t offset = (it - 1)->offset;
+        auto next = std::upper_bound(offsets.begin(), offsets.end(), offset);
+        size_t size = size_t((next == offsets.end() ? indexOffset : *next) - offset);
+
+        const char* begin = file.read(size_t(offset), size, buffer);
+        const char* end = begin + size;
+        if(findTag(begin, end, name) != begin) return false;
+        const char* tagEnd = static_cast<const char*>(std::memchr(begin, '>', size));
+        if(tagEnd == nullptr || getScanNum(begin, tagEnd) != scanNum) return false;
+
+        if(_format == Format::MZML){
+            const char* spectrumEnd = findStr(tagEnd, end, "</spectrum>");
+            parseSpectrum(scanNum, begin, tagEnd, spectrumEnd == nullptr ? end : spectrumEnd, decoder);
+        }
+        else {
+            const char* next = findTag(tagEnd, end, "scan");
+            const char* scanEnd = findStr(tagEnd, next == nullptr ? end : next, "</scan>");
+            if(scanEnd == nullptr) scanEnd = next == nullptr ? end : next;
+            parseScan(scanNum, begin, tagEnd, scanEnd, decoder);
+        }
+    }
+    return true;
+}
+
+void ms2::XmlMsFile::parseMzML(const char* begin, const char* end, const ScanNumList& scans)
+{
+    BinaryDecoder decoder;
+    for(const char* pos = findTag(begin, end, "spectrum"); pos != nullptr; pos = findTag(pos, end, "spectrum"))
+    {
+        const char* tagEnd = findTagEnd(pos, end);
+        const char* spectrumEnd = findStr(tagEnd, end, "</spectrum>");
+        if(spectrumEnd == nullptr) spectrumEnd = end;
+
+        size_t scanNum = getScanNum(pos, tagEnd);
+        if(isNeeded(scans, scanNum))
+            parseSpectrum(scanNum, pos, tagEnd, spectrumEnd, decoder);
+        pos = spectrumEnd;
+    }
+}
+
+/**
+ * Parse an mzML spectrum and store it.
+ * @param scanNum Scan number of spectrum.
+ * @param pos Beginning of spectrum start tag.
+ * @param tagEnd End of spectrum start tag.
+ * @param spectrumEnd End of spectrum.
+ * @param decoder Decoder for binary data arrays.
+ */
+void ms2::XmlMsFile::parseSpectrum(size_t scanNum, const char* pos, const char* tagEnd, const char* spectrumEnd, BinaryDecoder& decoder)
+{
+    std::string value;
+    size_t arrayLength = 0;
+    if(getAttribute(pos, tagEnd, "defaultArrayLength", value))
+        arrayLength = std::strtoul(value.c_str(), nullptr, 10);
+
+    StoredScan& scan = _scans[scanNum];
+    scan = StoredScan();
+    scan.precursor.setFile(_fname);
+    scan.precursor.setSample(getSampleName());
+
+    //spectrum parameters
+    const char* arraysBegin = findTag(tagEnd, spectrumEnd, "binaryDataArrayList");
+    if(arraysBegin == nullptr) arraysBegin = spectrumEnd;
+    for(const char* param = findTag(tagEnd, arraysBegin, "cvParam"); param != nullptr;
+        param = findTag(param + 1, arraysBegin, "cvParam"))
+    {
+        const char* paramEnd = findTagEnd(param, arraysBegin);
+        std::string accession;
+        if(!getAttribute(param, paramEnd, "accession", accession) ||
+           !getAttribute(param, paramEnd, "value", value)) continue;
+        if(accession == "MS:1000016"){
+            std::string unitName;
+            getAttribute(param, paramEnd, "unitName", unitName);
+            scan.precursor.setRT(timeToMinutes(std::atof(value.c_str()), unitName));
+        }
+        else if(accession == "MS:1000744")
+            scan.precursor.setMZ(value);
+        else if(accession == "MS:1000041")
+            scan.precursor.setCharge(std::atoi(value.c_str()));
+        else if(accession == "MS:1000042")
+            scan.precursor.setIntensity(std::atof(value.c_str()));
+    }
+
+    //precursor scan number from reference to precursor spectrum
+    const char* precursor = findTag(tagEnd, arraysBegin, "precursor");
+    if(precursor != nullptr && getAttribute(precursor, findTagEnd(precursor, arraysBegin), "spectrumRef", value)){
+        size_t scanPos = value.find("scan=");
+        if(scanPos != std::string::npos)
+            scan.precursor.setScan(std::to_string(std::strtoul(value.c_str() + scanPos + 5, nullptr, 10)));
+    }
+
+    //binary data arrays are decoded directly into the ions of the scan
+    size_t nMZ = 0, nIntensity = 0;
+    for(const char* array = findTag(arraysBegin, spectrumEnd, "binaryDataArray"); array != nullptr;)
+    {
+        const char* arrayEnd = findStr(array, spectrumEnd, "</binaryDataArray>");
+        if(arrayEnd == nullptr) arrayEnd = spectrumEnd;
+        const char* binaryBegin = findTag(array, arrayEnd, "binary");
+        const char* paramsEnd = binaryBegin == nullptr ? arrayEnd : binaryBegin;
+
+        size_t length = arrayLength;
+        if(getAttribute(array, findTagEnd(array, arrayEnd), "arrayLength", value))
+            length = std::strtoul(value.c_str(), nullptr, 10);
+        size_t width = findStr(array, paramsEnd, "MS:1000523") != nullptr ? 8 : 4;
+        bool compressed = findStr(array, paramsEnd, "MS:1000574") != nullptr;
+        bool isMZ = findStr(array, paramsEnd, "MS:1000514") != nullptr;
+        bool isIntensity = !isMZ && findStr(array, paramsEnd, "MS:1000515") != nullptr;
+
+        if((isMZ || isIntensity) && binaryBegin != nullptr){
+            const char* textBegin = findTagEnd(binaryBegin, arrayEnd) + 1;
+            const char* textEnd = findStr(textBegin, arrayEnd, "</binary>");
+            if(textEnd == nullptr || *(textBegin - 2) == '/') textEnd = textBegin;
+            size_t size = 0;
+            const char* data = decoder.decode(textBegin, textEnd, compressed, length * width, size);
+            size_t n = size / width;
+            if(scan.ions.size() < n) scan.ions.resize(n);
+            std::vector<utils::msInterface::ScanIon>& ions = scan.ions;
+            if(isMZ){
+                nMZ = n;
+                readValues(data, n, width, width, false, [&ions](size_t i, double value){
+                    ions[i].setMZ(utils::msInterface::ScanMZ(value));
+                });
+            }
+            else{
+                nIntensity = n;
+                readValues(data, n, width, width, false, [&ions](size_t i, double value){
+                    ions[i].setIntensity(utils::msInterface::ScanIntensity(value));
+                });
+            }
+        }
+        array = findTag(arrayEnd, spectrumEnd, "binaryDataArray");
+    }
+    if(nMZ != nIntensity)
+        throw std::runtime_error("m/z and intensity arrays have different lengths for scan " + std::to_string(scanNum));
+    scan.ions.resize(nMZ);
+}
+
+void ms2::XmlMsFile::parseMzXML(const char* begin, const char* end, const ScanNumList& scans)
+{
+    BinaryDecoder decoder;
+    //MSn scans can be nested inside the scan of their precursor, so the search for
+    //the next scan always starts from the end of the current start tag
+    for(const char* pos = findTag(begin, end, "scan"); pos != nullptr; )
+    {
+        const char* tagEnd = findTagEnd(pos, end);
+        const char* next = findTag(tagEnd, end, "scan");
+        const char* scanEnd = findStr(tagEnd, next == nullptr ? end : next, "</scan>");
+        if(scanEnd == nullptr) scanEnd = next == nullptr ? end : next;
+
+        size_t scanNum = getScanNum(pos, tagEnd);
+        if(isNeeded(scans, scanNum))
+            parseScan(scanNum, pos, tagEnd, scanEnd, decoder);
+        pos = next;
+    }
+}
+
+/**
+ * Parse an mzXML scan and store it. Nested scans are not included.
+ * @param scanNum Scan number of scan.
+ * @param pos Beginning of scan start tag.
+ * @param tagEnd End of scan start tag.
+ * @param scanEnd End of scan, or the beginning of the first nested scan.
+ * @param decoder Decoder for peaks.
+ */
+void ms2::XmlMsFile::parseScan(size_t scanNum, const char* pos, const char* tagEnd, const char* scanEnd, BinaryDecoder& decoder)
+{
+    std::string value;
+    StoredScan& scan = _scans[scanNum];
+    scan = StoredScan();
+    scan.precursor.setFile(_fname);
+    scan.precursor.setSample(getSampleName());
+    if(getAttribute(pos, tagEnd, "retentionTime", value))
+        scan.precursor.setRT(parseDuration(value));
+
+    const char* precursor = findTag(tagEnd, scanEnd, "precursorMz");
+    if(precursor != nullptr){
+        const char* precursorTagEnd = findTagEnd(precursor, scanEnd);
+        if(getAttribute(precursor, precursorTagEnd, "precursorIntensity", value))
+            scan.precursor.setIntensity(std::atof(value.c_str()));
+        if(getAttribute(precursor, precursorTagEnd, "precursorCharge", value))
+            scan.precursor.setCharge(std::atoi(value.c_str()));
+        if(getAttribute(precursor, precursorTagEnd, "precursorScanNum", value))
+            scan.precursor.setScan(value);
+        scan.precursor.setMZ(getText(precursor, scanEnd));
+    }
+
+    const char* peaks = findTag(tagEnd, scanEnd, "peaks");
+    if(peaks != nullptr){
+        const char* peaksTagEnd = findTagEnd(peaks, scanEnd);
+        size_t width = getAttribute(peaks, peaksTagEnd, "precision", value) && value == "64" ? 8 : 4;
+        bool bigEndian = !getAttribute(peaks, peaksTagEnd, "byteOrder", value) || value == "network";
+        bool compressed = getAttribute(peaks, peaksTagEnd, "compressionType", value) && value == "zlib";
+        size_t peaksCount = 0;
+        if(getAttribute(pos, tagEnd, "peaksCount", value))
+            peaksCount = std::strtoul(value.c_str(), nullptr, 10);
+
+        const char* textBegin = peaksTagEnd + 1;
+        const char* textEnd = *(peaksTagEnd - 1) == '/' ? textBegin : findStr(textBegin, scanEnd, "</peaks>");
+        if(textEnd == nullptr) textEnd = textBegin;
+        size_t size = 0;
+        const char* data = decoder.decode(textBegin, textEnd, compressed, peaksCount * width * 2, size);
+
+        //m/z and intensity pairs
+        size_t n = size / (width * 2);
+        scan.ions.resize(n);
+        std::vector<utils::msInterface::ScanIon>& ions = scan.ions;
+        readValues(data, n, width, width * 2, bigEndian, [&ions](size_t i, double value){
+            ions[i].setMZ(utils::msInterface::ScanMZ(value));
+        });
+        readValues(data + width, n, width, width * 2, bigEndian, [&ions](size_t i, double value){
+            ions[i].setIntensity(utils::msInterface::ScanIntensity(value));
+        });
+    }
+}
+
+/**
+ * Get a scan which was stored by read.
+ * This function is thread safe.
+ * @param scanNum Scan number to retrieve.
+ * @param scan Spectrum to populate.
+ * @return false if \p scanNum was not in the file or was not in the list of needed scans.
+ */
+bool ms2::XmlMsFile::getScan(size_t scanNum, ms2::Spectrum& scan) const
+{
+    auto it = _scans.find(scanNum);
+    if(it == _scans.end()) return false;
+
+    scan.clear();
+    scan.setScanNum(scanNum);
+    precursor(scan) = it->second.precursor;
+    ions(scan) = it->second.ions;
+    scan.updateRanges();
+    return true;
+}
+
+/**
+ * Get the scan numbers of all the scans which were stored by read.
+ * @param scanNums Populated with sorted scan numbers.
+ */
+void ms2::XmlMsFile::getScanNums(ScanNumList& scanNums) const
+{
+    scanNums.clear();
+    scanNums.reserve(_scans.size());
+    for(const auto& it: _scans)
+        scanNums.push_back(it.first);
+}